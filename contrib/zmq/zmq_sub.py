@@ -15,6 +15,7 @@ zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtxlock")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawblock")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtx")
 zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"rawtxlock")
+zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"txlocklatency")
 zmqSubSocket.connect("tcp://127.0.0.1:%i" % port)
 
 try:
@@ -46,6 +47,10 @@ try:
         elif topic == "rawtxlock":
             print('- RAW TX LOCK ('+sequence+') -')
             print(binascii.hexlify(body).decode("utf-8"))
+        elif topic == "txlocklatency":
+            print('- TX LOCK LATENCY ('+sequence+') -')
+            print(binascii.hexlify(body[:32]).decode("utf-8"))
+            print('first vote %dus, ready %dus, locked %dus' % struct.unpack('<qqq', body[32:56]))
 
 except KeyboardInterrupt:
     zmqContext.destroy()
@@ -103,6 +103,7 @@ testScripts = [
     'mempool_limit.py',
     'httpbasics.py',
     'multi_rpc.py',
+    'rpcbatch.py',
     'zapwallettxes.py',
     'proxy_test.py',
     'merkle_blocks.py',
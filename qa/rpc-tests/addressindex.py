@@ -105,6 +105,18 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(multitxids[4], txid2)
         assert_equal(multitxids[5], txidb2)
 
+        # Check that pages of several addresses stay in block order
+        multipage = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB", "yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4"], "limit": 4})
+        assert_equal(multipage["txids"], multitxids[0:4])
+        multipage = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB", "yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4"], "limit": 4, "cursor": multipage["cursor"]})
+        assert_equal(multipage["txids"], multitxids[4:])
+
+        # Check that a repeated address is read once when paging
+        multipage = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB", "yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4", "93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 4})
+        assert_equal(multipage["txids"], multitxids[0:4])
+        multipage = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB", "yMNJePdcKvXtWWQnFYHNeJ5u8TF2v1dfK4", "93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 4, "cursor": multipage["cursor"]})
+        assert_equal(multipage["txids"], multitxids[4:])
+
         # Check that balances are correct
         balance0 = self.nodes[1].getaddressbalance("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
         assert_equal(balance0["balance"], 45 * 100000000)
@@ -129,6 +141,14 @@ class AddressIndexTest(BitcoinTestFramework):
         assert_equal(len(txidsmany), 4)
         assert_equal(txidsmany[3], sent_txid)
 
+        # Check that txids can be paged through with a cursor
+        print "Testing txids pagination..."
+        page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 3})
+        assert_equal(page["txids"], txidsmany[0:3])
+        page = self.nodes[1].getaddresstxids({"addresses": ["93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB"], "limit": 3, "cursor": page["cursor"]})
+        assert_equal(page["txids"], txidsmany[3:])
+        assert("cursor" not in page)
+
         # Check that balances are correct
         print "Testing balances..."
         balance0 = self.nodes[1].getaddressbalance("93bVhahvUKmQu8gu9g3QnPPa2cxFK98pMB")
@@ -183,6 +203,13 @@ class AddressIndexTest(BitcoinTestFramework):
         deltasAll = self.nodes[1].getaddressdeltas({"addresses": [address2]})
         assert_equal(len(deltasAll), len(deltas))
 
+        # Check that deltas can be paged through with a cursor
+        deltasPage = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": 1})
+        assert_equal(deltasPage["deltas"], deltasAll[0:1])
+        deltasPage = self.nodes[1].getaddressdeltas({"addresses": [address2], "limit": len(deltasAll), "cursor": deltasPage["cursor"]})
+        assert_equal(deltasPage["deltas"], deltasAll[1:])
+        assert("cursor" not in deltasPage)
+
         # Check that deltas can be returned from range of block heights
         deltas = self.nodes[1].getaddressdeltas({"addresses": [address2], "start": 113, "end": 113})
         assert_equal(len(deltas), 1)
@@ -0,0 +1,134 @@
+#!/usr/bin/env python2
+# Copyright (c) 2017 The Sibcoin developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# InstantSend lock benchmark.
+#
+# Spins up a local quorum of masternodes on regtest, sends a burst of
+# InstantSend transactions from a wallet node and reports lock throughput
+# and the per-stage latencies collected by getinstantsendinfo.
+#
+
+import time
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+
+MASTERNODE_COLLATERAL = 1000
+INSTANTSEND_CONFIRMATIONS = 6
+MASTERNODE_MIN_MNP_SECONDS = 10 * 60
+
+class InstantSendBench(BitcoinTestFramework):
+
+    def add_options(self, parser):
+        parser.add_option("--masternodes", dest="masternodes", default=10, type="int",
+                          help="Number of masternodes in the quorum (default: %default)")
+        parser.add_option("--locks", dest="locks", default=100, type="int",
+                          help="Number of InstantSend transactions to send (default: %default)")
+        parser.add_option("--timeout", dest="timeout", default=300, type="int",
+                          help="Seconds to wait for all locks (default: %default)")
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        self.num_nodes = self.options.masternodes + 1
+        initialize_chain_clean(self.options.tmpdir, self.num_nodes)
+
+    def setup_network(self):
+        # Node 0 is the wallet and masternode controller, the others are hot masternodes
+        enable_mocktime()
+        self.mocktime = get_mocktime()
+        self.nodes = [start_node(0, self.options.tmpdir, ["-debug=instantsend"])]
+        self.is_network_split = False
+
+        print "Funding masternode collaterals..."
+        self.nodes[0].generate(200)
+        self.masternodes = []
+        for i in range(self.options.masternodes):
+            key = self.nodes[0].masternode("genkey")
+            address = self.nodes[0].getnewaddress()
+            txid = self.nodes[0].sendtoaddress(address, MASTERNODE_COLLATERAL)
+            self.masternodes.append({"alias": "mn%d" % (i + 1), "key": key, "txid": txid})
+        self.nodes[0].generate(1)
+        for mn in self.masternodes:
+            raw = self.nodes[0].getrawtransaction(mn["txid"], 1)
+            mn["vout"] = [out["n"] for out in raw["vout"] if out["value"] == MASTERNODE_COLLATERAL][0]
+
+        stop_node(self.nodes[0], 0)
+        wait_bitcoinds()
+        with open(os.path.join(self.options.tmpdir, "node0", "regtest", "masternode.conf"), 'w') as f:
+            for i, mn in enumerate(self.masternodes):
+                f.write("%s 127.0.0.1:%d %s %s %d\n" % (mn["alias"], p2p_port(i + 1), mn["key"], mn["txid"], mn["vout"]))
+
+        self.nodes[0] = start_node(0, self.options.tmpdir, ["-debug=instantsend"])
+        for i, mn in enumerate(self.masternodes):
+            args = ["-debug=instantsend", "-masternode=1", "-masternodeprivkey=" + mn["key"],
+                    "-externalip=127.0.0.1", "-listen=1"]
+            self.nodes.append(start_node(i + 1, self.options.tmpdir, args))
+            connect_nodes_bi(self.nodes, 0, i + 1)
+            if i > 0:
+                connect_nodes(self.nodes[i + 1], i)
+        self.sync_all()
+
+        print "Starting masternodes..."
+        sync_masternodes(self.nodes)
+        for mn in self.masternodes:
+            result = self.nodes[0].masternode("start-alias", mn["alias"])
+            assert_equal(result["result"], "successful")
+        self.wait_for_masternodes("ENABLED")
+
+    def bump_mocktime(self, seconds):
+        self.mocktime += seconds
+        set_node_times(self.nodes, self.mocktime)
+
+    def wait_for_masternodes(self, status):
+        # masternodes are only enabled once they have pinged for MASTERNODE_MIN_MNP_SECONDS
+        for attempt in range(30):
+            statuses = [node.masternodelist("status").values() for node in self.nodes]
+            if all(len(s) == self.options.masternodes and all(x == status for x in s) for s in statuses):
+                return
+            self.bump_mocktime(MASTERNODE_MIN_MNP_SECONDS / 5)
+            time.sleep(2)
+        raise AssertionError("masternodes are not %s: %s" % (status, statuses))
+
+    def run_test(self):
+        wallet = self.nodes[0]
+
+        print "Preparing %d inputs..." % self.options.locks
+        outputs = {}
+        for i in range(self.options.locks):
+            outputs[wallet.getnewaddress()] = 1
+        wallet.sendmany("", outputs)
+        wallet.generate(INSTANTSEND_CONFIRMATIONS)
+        self.sync_all()
+
+        for node in self.nodes:
+            node.getinstantsendinfo(True)
+
+        print "Sending %d InstantSend transactions..." % self.options.locks
+        address = wallet.getnewaddress()
+        time_start = time.time()
+        for i in range(self.options.locks):
+            wallet.instantsendtoaddress(address, 0.5)
+        time_sent = time.time()
+
+        locked = 0
+        while time.time() - time_start < self.options.timeout:
+            locked = wallet.getinstantsendinfo()["locked"]["count"]
+            if locked >= self.options.locks:
+                break
+            time.sleep(0.1)
+        time_locked = time.time()
+
+        info = wallet.getinstantsendinfo()
+        print "%d/%d locks in %.2fs (sending took %.2fs), %.2f locks/s" % (
+            locked, self.options.locks, time_locked - time_start, time_sent - time_start,
+            locked / (time_locked - time_start))
+        for stage in ["first_vote", "ready", "locked"]:
+            s = info[stage]
+            print "%-10s count=%-6d avg=%8.2fms p50<=%6dms p99<=%6dms max=%8.2fms" % (
+                stage, s["count"], s["avg_ms"], s["p50_ms"], s["p99_ms"], s["max_ms"])
+        assert_equal(locked, self.options.locks)
+
+if __name__ == '__main__':
+    InstantSendBench().main()
@@ -280,6 +280,46 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(response_header_json_str)
         assert_equal(len(json_obj), 5) #now we should have 5 header objects
 
+        #####################
+        # /rest/blockrange/ #
+        #####################
+
+        # the range holds the same blocks as /rest/block/, concatenated
+        range_hashes = [bb_hash]
+        while len(range_hashes) < 6:
+            range_hashes.append(self.nodes[0].getblock(range_hashes[-1])['nextblockhash'])
+
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/6/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True)
+        assert_equal(response.status, 200)
+        expected = b''.join([http_get_call(url.hostname, url.port, '/rest/block/'+h+self.FORMAT_SEPARATOR+"bin", True).read() for h in range_hashes])
+        assert_equal(response.read(), expected)
+
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/6/'+bb_hash+self.FORMAT_SEPARATOR+"hex", True)
+        assert_equal(response.status, 200)
+        expected = ''.join([http_get_call(url.hostname, url.port, '/rest/block/'+h+self.FORMAT_SEPARATOR+"hex").strip() for h in range_hashes])
+        assert_equal(response.read().decode('utf-8').strip(), expected)
+
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/6/'+bb_hash+self.FORMAT_SEPARATOR+"json", True)
+        assert_equal(response.status, 200)
+        json_obj = json.loads(response.read().decode('utf-8'))
+        expected = [json.loads(http_get_call(url.hostname, url.port, '/rest/block/'+h+self.FORMAT_SEPARATOR+"json")) for h in range_hashes]
+        assert_equal(json_obj, expected)
+
+        # the range ends at the tip
+        tip_hash = self.nodes[0].getbestblockhash()
+        prev_hash = self.nodes[0].getblock(tip_hash)['previousblockhash']
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/1000/'+prev_hash+self.FORMAT_SEPARATOR+"json", True)
+        assert_equal(response.status, 200)
+        json_obj = json.loads(response.read().decode('utf-8'))
+        assert_equal([block['hash'] for block in json_obj], [prev_hash, tip_hash])
+
+        # count limits
+        for count in ['0', '1001', '-1', '10abc', 'abc', '']:
+            response = http_get_call(url.hostname, url.port, '/rest/blockrange/'+count+'/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True)
+            assert_equal(response.status, 400)
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/1/'+'0'*64+self.FORMAT_SEPARATOR+"bin", True)
+        assert_equal(response.status, 404)
+
         # do tx test
         tx_hash = block_json_obj['tx'][0]['txid']
         json_string = http_get_call(url.hostname, url.port, '/rest/tx/'+tx_hash+self.FORMAT_SEPARATOR+"json")
@@ -0,0 +1,116 @@
+#!/usr/bin/env python2
+# Copyright (c) 2015 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test JSON-RPC batch requests: replies come back in request order, an error
+# in one call does not affect the others, and concurrent batches give the
+# same replies as serial ones.
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+import json
+import threading
+
+try:
+    import http.client as httplib
+except ImportError:
+    import httplib
+try:
+    import urllib.parse as urlparse
+except ImportError:
+    import urlparse
+
+NUM_BLOCKS = 50
+
+class RPCBatchTest (BitcoinTestFramework):
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 1)
+
+    def setup_network(self, split=False):
+        self.nodes = start_nodes(1, self.options.tmpdir, [["-rpcthreads=4", "-rpcbatchthreads=3"]])
+        self.is_network_split = False
+
+    def post_batch(self, batch):
+        url = urlparse.urlparse(self.nodes[0].url)
+        headers = {"Authorization": "Basic " + str_to_b64str(url.username + ':' + url.password)}
+        conn = httplib.HTTPConnection(url.hostname, url.port)
+        conn.request('POST', '/', json.dumps(batch), headers)
+        resp = conn.getresponse()
+        assert_equal(resp.status, 200)
+        replies = json.loads(resp.read().decode('utf-8'))
+        conn.close()
+        return replies
+
+    def make_batch(self, seed):
+        # Successful calls with distinct results, interleaved with calls that
+        # fail in different ways
+        batch = []
+        for height in range(NUM_BLOCKS + 1):
+            batch.append({"method": "getblockhash", "params": [height], "id": "%d-%d" % (seed, height)})
+            if height % 7 == 3:
+                batch.append({"method": "nosuchmethod", "params": [], "id": "%d-%d-unknown" % (seed, height)})
+            if height % 11 == 5:
+                batch.append({"method": "getblockhash", "params": [NUM_BLOCKS + 1 + height], "id": "%d-%d-range" % (seed, height)})
+            if height % 13 == 7:
+                batch.append({"params": [], "id": "%d-%d-nomethod" % (seed, height)})
+        return batch
+
+    def check_replies(self, batch, replies):
+        assert_equal(len(replies), len(batch))
+        for call, reply in zip(batch, replies):
+            assert_equal(reply["id"], call["id"])
+            if call["id"].endswith("-unknown"):
+                assert_equal(reply["result"], None)
+                assert_equal(reply["error"]["code"], -32601)
+            elif call["id"].endswith("-range"):
+                assert_equal(reply["result"], None)
+                assert_equal(reply["error"]["code"], -8)
+            elif call["id"].endswith("-nomethod"):
+                assert_equal(reply["result"], None)
+                assert_equal(reply["error"]["code"], -32600)
+            else:
+                assert_equal(reply["error"], None)
+                assert_equal(reply["result"], self.hashes[call["params"][0]])
+
+    def run_test(self):
+        self.nodes[0].generate(NUM_BLOCKS)
+        self.hashes = [self.nodes[0].getblockhash(height) for height in range(NUM_BLOCKS + 1)]
+
+        # Ordering and error isolation within one batch
+        batch = self.make_batch(0)
+        self.check_replies(batch, self.post_batch(batch))
+
+        # A batch of one call and an empty batch
+        replies = self.post_batch([{"method": "getblockcount", "params": [], "id": 1}])
+        assert_equal(replies, [{"result": NUM_BLOCKS, "error": None, "id": 1}])
+        assert_equal(self.post_batch([]), [])
+
+        # Concurrent batches share the batch threads, each gets its own replies
+        errors = []
+        def run_batches(seed):
+            try:
+                for i in range(5):
+                    batch = self.make_batch(seed * 10 + i)
+                    self.check_replies(batch, self.post_batch(batch))
+            except Exception as e:
+                errors.append(e)
+        threads = [threading.Thread(target=run_batches, args=(seed,)) for seed in range(1, 5)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        assert_equal(errors, [])
+
+        # Running the calls one after another gives the same replies
+        batch = self.make_batch(0)
+        replies = self.post_batch(batch)
+        stop_node(self.nodes[0], 0)
+        self.nodes[0] = start_node(0, self.options.tmpdir, ["-rpcbatchthreads=1"])
+        assert_equal(self.post_batch(batch), replies)
+
+if __name__ == '__main__':
+    RPCBatchTest ().main ()
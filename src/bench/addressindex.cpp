@@ -0,0 +1,113 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <set>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+
+// A wallet backend asking for the history of many HD addresses at once:
+// NUM_ADDRESSES addresses with ENTRIES_PER_ADDRESS index entries each,
+// spread over NUM_BLOCKS blocks. Every fourth transaction pays to two of
+// the addresses, so txids have to be deduplicated.
+static const int NUM_ADDRESSES = 200;
+static const int ENTRIES_PER_ADDRESS = 50;
+static const int NUM_BLOCKS = 100000;
+
+struct AddressIndexBenchSetup
+{
+    boost::filesystem::path pathTemp;
+    boost::scoped_ptr<CBlockTreeDB> pdb;
+    std::vector<std::pair<uint160, int> > addresses;
+
+    AddressIndexBenchSetup()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        pathTemp = GetTempPath() / strprintf("bench_dash_addressindex_%lu", (unsigned long)GetTime());
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+        pdb.reset(new CBlockTreeDB(1 << 20, true));
+
+        seed_insecure_rand(true);
+        for (int i = 0; i < NUM_ADDRESSES; i++) {
+            uint160 hashBytes;
+            for (unsigned int j = 0; j < hashBytes.size(); j++)
+                *(hashBytes.begin() + j) = insecure_rand() & 0xff;
+            addresses.push_back(std::make_pair(hashBytes, 1));
+        }
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vIndex;
+        for (int i = 0; i < NUM_ADDRESSES * ENTRIES_PER_ADDRESS; i++) {
+            // (height, tx index) identifies a transaction, as in a real chain
+            int nHeight = insecure_rand() % NUM_BLOCKS + 1;
+            unsigned int nTxIndex = i;
+            uint256 txhash = GetRandHash();
+            const std::pair<uint160, int>& address = addresses[i % NUM_ADDRESSES];
+            vIndex.push_back(std::make_pair(CAddressIndexKey(address.second, address.first, nHeight, nTxIndex, txhash, 0, false), 1000));
+            if (i % 4 == 0) {
+                const std::pair<uint160, int>& other = addresses[(i + 1) % NUM_ADDRESSES];
+                vIndex.push_back(std::make_pair(CAddressIndexKey(other.second, other.first, nHeight, nTxIndex, txhash, 1, false), 1000));
+            }
+        }
+        pdb->WriteAddressIndex(vIndex);
+    }
+
+    ~AddressIndexBenchSetup()
+    {
+        pdb.reset();
+        boost::filesystem::remove_all(pathTemp);
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+    }
+};
+
+static AddressIndexBenchSetup& GetSetup()
+{
+    static AddressIndexBenchSetup setup;
+    return setup;
+}
+
+// What getaddresstxids did before: read every address, then sort and
+// dedupe all entries in one set.
+static void AddressIndexTxidsPerAddress(benchmark::State& state)
+{
+    AddressIndexBenchSetup& setup = GetSetup();
+    while (state.KeepRunning()) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        for (std::vector<std::pair<uint160, int> >::iterator it = setup.addresses.begin(); it != setup.addresses.end(); it++)
+            setup.pdb->ReadAddressIndex(it->first, it->second, addressIndex);
+
+        std::set<std::pair<int, std::string> > txids;
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = addressIndex.begin(); it != addressIndex.end(); it++)
+            txids.insert(std::make_pair(it->first.blockHeight, it->first.txhash.GetHex()));
+        assert(txids.size() == (size_t)NUM_ADDRESSES * ENTRIES_PER_ADDRESS);
+    }
+}
+
+static void AddressIndexTxidsMerged(benchmark::State& state)
+{
+    AddressIndexBenchSetup& setup = GetSetup();
+    while (state.KeepRunning()) {
+        std::vector<std::string> txids;
+        uint256 lastTxid;
+        for (CAddressIndexMergeCursor cursor(*setup.pdb, setup.addresses); cursor.Valid(); cursor.Next()) {
+            if (txids.empty() || cursor.GetKey().txhash != lastTxid) {
+                lastTxid = cursor.GetKey().txhash;
+                txids.push_back(lastTxid.GetHex());
+            }
+        }
+        assert(txids.size() == (size_t)NUM_ADDRESSES * ENTRIES_PER_ADDRESS);
+    }
+}
+
+BENCHMARK(AddressIndexTxidsPerAddress);
+BENCHMARK(AddressIndexTxidsMerged);
@@ -4,6 +4,10 @@
 
 #include "bench.h"
 
+#include "main.h"
+#include "util.h"
+
+#include <algorithm>
 #include <iostream>
 #include <sys/time.h>
 
@@ -36,6 +40,15 @@ BenchRunner::RunAll(double elapsedTimeForOne)
     }
 }
 
+int benchmark::GetThreadCount()
+{
+    // -par=0 means autodetect, negative values leave that many cores free
+    int nThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+    if (nThreads <= 0)
+        nThreads += GetNumCores();
+    return std::max(1, std::min(nThreads, MAX_SCRIPTCHECK_THREADS));
+}
+
 bool State::KeepRunning()
 {
     double now;
@@ -63,6 +63,9 @@ namespace benchmark {
 
         static void RunAll(double elapsedTimeForOne=1.0);
     };
+
+    //! Number of threads for multi-threaded benchmarks, from -par as for script checks
+    int GetThreadCount();
 }
 
 // BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
@@ -13,6 +13,7 @@ main(int argc, char** argv)
 {
     ECC_Start();
     SetupEnvironment();
+    ParseParameters(argc, argv);
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
     benchmark::BenchRunner::RunAll();
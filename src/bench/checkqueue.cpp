@@ -0,0 +1,123 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "checkqueue.h"
+#include "hash.h"
+#include "key.h"
+#include "pubkey.h"
+#include "random.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// Verifying the inputs of a block on -par threads, like ConnectBlock does
+// through scriptcheckqueue: NUM_INPUTS signature checks per block, added one
+// transaction at a time. Each check is a real ECDSA verification, so batches
+// are sized from the cost of actual script checks.
+static const int NUM_INPUTS = 4000;
+static const int NUM_KEYS = 64;
+static const unsigned int SCRIPT_CHECK_BATCH_SIZE = 128;
+
+struct CheckQueueBenchSetup
+{
+    ECCVerifyHandle verifyHandle;
+    std::vector<CPubKey> vPubKeys;
+    std::vector<uint256> vHashes;
+    std::vector<std::vector<unsigned char> > vSigs;
+
+    CheckQueueBenchSetup()
+    {
+        for (int i = 0; i < NUM_KEYS; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            uint256 hash = GetRandHash();
+            std::vector<unsigned char> vchSig;
+            key.Sign(hash, vchSig);
+            vPubKeys.push_back(key.GetPubKey());
+            vHashes.push_back(hash);
+            vSigs.push_back(vchSig);
+        }
+    }
+};
+
+static CheckQueueBenchSetup& GetSetup()
+{
+    static CheckQueueBenchSetup setup;
+    return setup;
+}
+
+// Stand-in for CScriptCheck, verifying one of the setup's signatures
+class CBenchSigCheck
+{
+private:
+    int nKey;
+
+public:
+    CBenchSigCheck() : nKey(0) {}
+    CBenchSigCheck(int nKeyIn) : nKey(nKeyIn) {}
+
+    bool operator()()
+    {
+        CheckQueueBenchSetup& setup = GetSetup();
+        return setup.vPubKeys[nKey].Verify(setup.vHashes[nKey], setup.vSigs[nKey]);
+    }
+
+    void swap(CBenchSigCheck& check)
+    {
+        std::swap(nKey, check.nKey);
+    }
+};
+
+// Verify a block whose transactions have the given numbers of inputs
+static void VerifyBlocks(benchmark::State& state, const std::vector<int>& vTxInputs)
+{
+    GetSetup();
+    CCheckQueue<CBenchSigCheck> queue(SCRIPT_CHECK_BATCH_SIZE);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < benchmark::GetThreadCount() - 1; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CBenchSigCheck>::Thread, &queue));
+
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CBenchSigCheck> control(&queue);
+        int nInput = 0;
+        for (std::vector<int>::const_iterator it = vTxInputs.begin(); it != vTxInputs.end(); it++) {
+            std::vector<CBenchSigCheck> vChecks;
+            for (int i = 0; i < *it; i++)
+                vChecks.push_back(CBenchSigCheck(nInput++ % NUM_KEYS));
+            control.Add(vChecks);
+        }
+        bool fOk = control.Wait();
+        assert(fOk);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+// A consolidation: one transaction spending all inputs
+static void CheckQueueOneLargeTx(benchmark::State& state)
+{
+    VerifyBlocks(state, std::vector<int>(1, NUM_INPUTS));
+}
+
+// Payments: many transactions with two inputs each
+static void CheckQueueManySmallTxs(benchmark::State& state)
+{
+    VerifyBlocks(state, std::vector<int>(NUM_INPUTS / 2, 2));
+}
+
+// A mix of both, with the large transactions at the end of the block
+static void CheckQueueMixedTxs(benchmark::State& state)
+{
+    std::vector<int> vTxInputs(NUM_INPUTS / 4, 2);
+    vTxInputs.push_back(NUM_INPUTS / 4);
+    vTxInputs.push_back(NUM_INPUTS / 4);
+    VerifyBlocks(state, vTxInputs);
+}
+
+BENCHMARK(CheckQueueOneLargeTx);
+BENCHMARK(CheckQueueManySmallTxs);
+BENCHMARK(CheckQueueMixedTxs);
@@ -0,0 +1,94 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "random.h"
+#include "script/sigcache.h"
+#include "uint256.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// Script check threads validating a block: every -par thread looks up
+// LOOKUPS_PER_THREAD entries of a cache holding NUM_ENTRIES signatures.
+// Lookups hit for three entries out of four. In the second case a miss is
+// stored, as it would be after verifying a new transaction, so writers race
+// with readers and, once the cache fills up, with eviction.
+static const size_t CACHE_SIZE = 4 << 20;
+static const int NUM_ENTRIES = 50000;
+static const int LOOKUPS_PER_THREAD = 100000;
+
+struct SigCacheBenchSetup
+{
+    int nThreads;
+    std::vector<uint256> vStored;
+    std::vector<std::vector<uint256> > vLookups;
+
+    SigCacheBenchSetup()
+    {
+        nThreads = benchmark::GetThreadCount();
+        seed_insecure_rand(true);
+        for (int i = 0; i < NUM_ENTRIES; i++)
+            vStored.push_back(GetRandHash());
+
+        vLookups.resize(nThreads);
+        for (int i = 0; i < nThreads; i++) {
+            for (int j = 0; j < LOOKUPS_PER_THREAD; j++)
+                vLookups[i].push_back(insecure_rand() % 4 ? vStored[insecure_rand() % NUM_ENTRIES] : GetRandHash());
+        }
+    }
+};
+
+static SigCacheBenchSetup& GetSetup()
+{
+    static SigCacheBenchSetup setup;
+    return setup;
+}
+
+static void LookupEntries(CSignatureCache* cache, const std::vector<uint256>* vEntries, bool fStore)
+{
+    for (std::vector<uint256>::const_iterator it = vEntries->begin(); it != vEntries->end(); it++) {
+        if (!cache->Get(*it) && fStore)
+            cache->Set(*it);
+    }
+}
+
+static void RunThreads(CSignatureCache& cache, bool fStore)
+{
+    SigCacheBenchSetup& setup = GetSetup();
+    boost::thread_group threadGroup;
+    for (int i = 0; i < setup.nThreads; i++)
+        threadGroup.create_thread(boost::bind(&LookupEntries, &cache, &setup.vLookups[i], fStore));
+    threadGroup.join_all();
+}
+
+static void SigCacheLookup(benchmark::State& state)
+{
+    SigCacheBenchSetup& setup = GetSetup();
+    CSignatureCache cache(CACHE_SIZE);
+    for (std::vector<uint256>::const_iterator it = setup.vStored.begin(); it != setup.vStored.end(); it++)
+        cache.Set(*it);
+
+    while (state.KeepRunning()) {
+        RunThreads(cache, false);
+    }
+    assert(cache.GetStats().nHits > 0);
+}
+
+static void SigCacheLookupAndStore(benchmark::State& state)
+{
+    SigCacheBenchSetup& setup = GetSetup();
+    CSignatureCache cache(CACHE_SIZE);
+    for (std::vector<uint256>::const_iterator it = setup.vStored.begin(); it != setup.vStored.end(); it++)
+        cache.Set(*it);
+
+    while (state.KeepRunning()) {
+        RunThreads(cache, true);
+    }
+    assert(cache.GetStats().nInserts > 0);
+}
+
+BENCHMARK(SigCacheLookup);
+BENCHMARK(SigCacheLookupAndStore);
@@ -0,0 +1,124 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "core_memusage.h"
+#include "memusage.h"
+
+CBlockCache::CBlockCache(size_t nMaxUsageIn) : nUsage(0), nMaxUsage(nMaxUsageIn), nHits(0), nMisses(0)
+{
+}
+
+size_t CBlockCache::BlockUsage(const CBlock& block)
+{
+    // the block itself, its list entry and its map entry
+    return memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(block) +
+           memusage::MallocUsage(sizeof(list_type::value_type) + 2 * sizeof(void*)) +
+           memusage::MallocUsage(sizeof(std::map<uint256, list_type::iterator>::value_type) + 3 * sizeof(void*));
+}
+
+void CBlockCache::Trim()
+{
+    while (nUsage > nMaxUsage && !listBlocks.empty()) {
+        const list_type::value_type& entry = listBlocks.back();
+        nUsage -= BlockUsage(*entry.second);
+        mapBlocks.erase(entry.first);
+        listBlocks.pop_back();
+    }
+}
+
+void CBlockCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
+boost::shared_ptr<const CBlock> CBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    std::map<uint256, list_type::iterator>::iterator it = mapBlocks.find(hash);
+    if (it == mapBlocks.end()) {
+        nMisses++;
+        return boost::shared_ptr<const CBlock>();
+    }
+    nHits++;
+    listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+    return it->second->second;
+}
+
+void CBlockCache::Insert(const uint256& hash, const CBlock& block)
+{
+    {
+        LOCK(cs);
+        if (nMaxUsage == 0)
+            return;
+        std::map<uint256, list_type::iterator>::iterator it = mapBlocks.find(hash);
+        if (it != mapBlocks.end()) {
+            listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+            return;
+        }
+    }
+
+    // Readers must see the block as it was read from disk, so the cached
+    // copy is never marked as checked.
+    boost::shared_ptr<CBlock> pblock(new CBlock(block));
+    pblock->fChecked = false;
+    Insert(hash, pblock);
+}
+
+void CBlockCache::Insert(const uint256& hash, const boost::shared_ptr<const CBlock>& pblock)
+{
+    assert(!pblock->fChecked);
+
+    LOCK(cs);
+    if (nMaxUsage == 0)
+        return;
+    std::map<uint256, list_type::iterator>::iterator it = mapBlocks.find(hash);
+    if (it != mapBlocks.end()) {
+        listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+        return;
+    }
+
+    size_t nBlockUsage = BlockUsage(*pblock);
+    if (nBlockUsage > nMaxUsage)
+        return;
+    listBlocks.push_front(std::make_pair(hash, pblock));
+    mapBlocks.insert(std::make_pair(hash, listBlocks.begin()));
+    nUsage += nBlockUsage;
+    Trim();
+}
+
+void CBlockCache::Clear()
+{
+    LOCK(cs);
+    listBlocks.clear();
+    mapBlocks.clear();
+    nUsage = 0;
+}
+
+size_t CBlockCache::Size() const
+{
+    LOCK(cs);
+    return listBlocks.size();
+}
+
+size_t CBlockCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return nUsage;
+}
+
+uint64_t CBlockCache::Hits() const
+{
+    LOCK(cs);
+    return nHits;
+}
+
+uint64_t CBlockCache::Misses() const
+{
+    LOCK(cs);
+    return nMisses;
+}
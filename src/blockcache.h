@@ -0,0 +1,76 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include "primitives/block.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+
+#include <boost/shared_ptr.hpp>
+
+/** Default for -blockcachesize, memory used for recently read or connected blocks (in MiB) */
+static const unsigned int DEFAULT_BLOCK_CACHE_SIZE = 16;
+
+/**
+ * A memory bounded, least recently used cache of parsed blocks, keyed by
+ * block hash.
+ *
+ * Many internal readers (masternode payment checks, GetTransaction with
+ * -txindex, the wallet, zmq notifications and RPC) read the same blocks near
+ * the tip over and over. Serving them from here avoids opening the block
+ * file, deserializing the block and computing its X11 hash again.
+ *
+ * Cached blocks are immutable and shared; a block which is still in use
+ * by a caller stays valid after it has been evicted.
+ */
+class CBlockCache
+{
+private:
+    typedef std::list<std::pair<uint256, boost::shared_ptr<const CBlock> > > list_type;
+
+    mutable CCriticalSection cs;
+
+    //! cached blocks, most recently used first
+    list_type listBlocks;
+    std::map<uint256, list_type::iterator> mapBlocks;
+
+    //! memory used by the cached blocks, and the configured limit
+    size_t nUsage;
+    size_t nMaxUsage;
+
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    static size_t BlockUsage(const CBlock& block);
+    void Trim();
+
+public:
+    CBlockCache(size_t nMaxUsageIn = (size_t)DEFAULT_BLOCK_CACHE_SIZE << 20);
+
+    //! Change the memory limit, evicting blocks if needed. 0 disables the cache.
+    void SetMaxUsage(size_t nMaxUsageIn);
+
+    //! Return the block with the given hash, or an empty pointer
+    boost::shared_ptr<const CBlock> Get(const uint256& hash);
+
+    //! Copy a block into the cache. The caller guarantees that hash is the hash of the block.
+    void Insert(const uint256& hash, const CBlock& block);
+
+    //! Share a block with the cache, without copying it. The block must not be marked as checked.
+    void Insert(const uint256& hash, const boost::shared_ptr<const CBlock>& pblock);
+
+    void Clear();
+
+    size_t Size() const;
+    size_t DynamicMemoryUsage() const;
+    uint64_t Hits() const;
+    uint64_t Misses() const;
+};
+
+#endif // BITCOIN_BLOCKCACHE_H
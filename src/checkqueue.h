@@ -5,7 +5,11 @@
 #ifndef BITCOIN_CHECKQUEUE_H
 #define BITCOIN_CHECKQUEUE_H
 
+#include "utiltime.h"
+
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -13,6 +17,11 @@
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
+//! Number of per-worker queues, the master always uses the first one
+static const unsigned int MAX_CHECKQUEUE_WORKERS = 32;
+//! Batches are sized to take about this long, given the measured cost of one check
+static const int64_t CHECKQUEUE_BATCH_TARGET_MICROS = 250;
+
 template <typename T>
 class CCheckQueueControl;
 
@@ -25,12 +34,28 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every worker has its own queue, which Add() fills in turn. A worker takes
+  * checks from the back of its own queue and, once that is empty, steals from
+  * the front of the others, so a transaction with thousands of inputs is
+  * spread over all workers without them contending on a single lock.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    /** Checks waiting for one worker, other workers steal from the front */
+    struct CWorkerQueue
+    {
+        boost::mutex mutex;
+        std::deque<T> queue;
+        //! queue.size(), readable without taking the lock
+        std::atomic<unsigned int> nSize;
+
+        CWorkerQueue() : nSize(0) {}
+    };
+
+    //! Mutex to protect the idle and total worker counts
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,9 +64,17 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The per-worker queues. As the order of booleans doesn't matter, they are used as stacks by their owners
+    CWorkerQueue vQueues[MAX_CHECKQUEUE_WORKERS];
+
+    //! The number of worker threads that joined the queue.
+    std::atomic<unsigned int> nWorkers;
+
+    //! The queue the next Add() puts its checks on, only used by the master.
+    unsigned int nAddPos;
+
+    //! The number of elements waiting in the per-worker queues.
+    std::atomic<unsigned int> nQueued;
 
     //! The number of workers (including the master) that are idle.
     int nIdle;
@@ -50,14 +83,14 @@ private:
     int nTotal;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
     //! Whether we're shutting down.
     bool fQuit;
@@ -65,31 +98,95 @@ private:
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! Moving average of the time one check takes in nanoseconds, 0 until measured
+    std::atomic<int64_t> nCheckCost;
+
+    unsigned int GetQueueCount() const
+    {
+        return std::min(MAX_CHECKQUEUE_WORKERS, 1 + nWorkers.load());
+    }
+
+    //! Enough checks for about CHECKQUEUE_BATCH_TARGET_MICROS of work, at most nBatchSize
+    unsigned int GetBatchSize() const
+    {
+        int64_t nCost = nCheckCost.load(std::memory_order_relaxed);
+        if (nCost == 0)
+            return 1;
+        return std::max<int64_t>(1, std::min<int64_t>(nBatchSize, CHECKQUEUE_BATCH_TARGET_MICROS * 1000 / nCost));
+    }
+
+    void UpdateCheckCost(int64_t nMicros, unsigned int nChecks)
+    {
+        // Racing updates may lose a sample, which doesn't matter for an estimate
+        int64_t nSample = std::max<int64_t>(1, nMicros * 1000 / nChecks);
+        int64_t nCost = nCheckCost.load(std::memory_order_relaxed);
+        nCheckCost.store(nCost ? (nCost * 7 + nSample) / 8 : nSample, std::memory_order_relaxed);
+    }
+
+    /**
+     * Move a batch of checks from one of the per-worker queues into vChecks.
+     * The owner leaves at least half of its queue for others to steal, a
+     * thief takes at most half of the victim's queue.
+     */
+    unsigned int TakeChecks(CWorkerQueue& q, std::vector<T>& vChecks, bool fSteal)
+    {
+        if (q.nSize.load(std::memory_order_relaxed) == 0)
+            return 0;
+        boost::unique_lock<boost::mutex> lock(q.mutex);
+        unsigned int nSize = q.queue.size();
+        if (nSize == 0)
+            return 0;
+        unsigned int nNow = std::max(1U, std::min(GetBatchSize(), fSteal ? (nSize + 1) / 2 : nSize / 2));
+        vChecks.resize(nNow);
+        for (unsigned int i = 0; i < nNow; i++) {
+            // We want the lock on the mutex to be as short as possible, so swap jobs from the
+            // queue to the local batch vector instead of copying.
+            if (fSteal) {
+                vChecks[i].swap(q.queue.front());
+                q.queue.pop_front();
+            } else {
+                vChecks[i].swap(q.queue.back());
+                q.queue.pop_back();
+            }
+        }
+        q.nSize.store(q.queue.size(), std::memory_order_relaxed);
+        nQueued -= nNow;
+        return nNow;
+    }
+
+    //! Get a batch from our own queue or, failing that, steal one
+    unsigned int GetWork(unsigned int nPos, std::vector<T>& vChecks)
+    {
+        unsigned int nNow = TakeChecks(vQueues[nPos], vChecks, false);
+        if (nNow)
+            return nNow;
+        unsigned int nQueues = GetQueueCount();
+        for (unsigned int i = 1; i < nQueues && !nNow; i++)
+            nNow = TakeChecks(vQueues[(nPos + i) % nQueues], vChecks, true);
+        return nNow;
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(unsigned int nPos, bool fMaster = false)
     {
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
+        bool fFirst = true;
         do {
-            {
+            unsigned int nNow = fFirst ? 0 : GetWork(nPos, vChecks);
+            if (nNow == 0) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
+                if (fFirst) {
+                    // A new worker with nothing to do is counted and goes idle in the same
+                    // critical section, so that IsIdle() does not fail while workers start
                     nTotal++;
+                    fFirst = false;
                 }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
+                while (nQueued == 0) {
+                    // The master leaves once the other workers are idle as well,
+                    // so that the queue is idle again when Wait() returns
+                    if (nTodo == 0 && (fMaster ? nIdle == nTotal - 1 : fQuit)) {
                         nTotal--;
                         bool fRet = fAllOk;
                         // reset the status for new work later
@@ -99,61 +196,73 @@ private:
                         return fRet;
                     }
                     nIdle++;
+                    if (!fMaster && nTodo == 0)
+                        condMaster.notify_one();
                     cond.wait(lock); // wait
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+                continue;
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
+            // Check whether we need to do work at all, and time it to size the next batches
+            bool fOk = fAllOk;
+            if (fOk) {
+                int64_t nTimeStart = GetTimeMicros();
+                BOOST_FOREACH (T& check, vChecks)
+                    if (fOk)
+                        fOk = check();
                 if (fOk)
-                    fOk = check();
+                    UpdateCheckCost(GetTimeMicros() - nTimeStart, nNow);
+                else
+                    fAllOk = false;
+            }
             vChecks.clear();
+            if (nTodo.fetch_sub(nNow) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
 public:
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nAddPos(0), nQueued(0), nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn), nCheckCost(0) {}
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        Loop(1 + nWorkers++ % (MAX_CHECKQUEUE_WORKERS - 1));
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // Count the checks before they can be completed, so nTodo never drops below zero
         nTodo += vChecks.size();
+        CWorkerQueue& q = vQueues[nAddPos++ % GetQueueCount()];
+        {
+            boost::unique_lock<boost::mutex> lock(q.mutex);
+            BOOST_FOREACH (T& check, vChecks) {
+                q.queue.push_back(T());
+                check.swap(q.queue.back());
+            }
+            q.nSize.store(q.queue.size(), std::memory_order_relaxed);
+            // Only count them as queued once they can be taken, but before the
+            // lock is released so that taking them cannot drop nQueued below zero
+            nQueued += vChecks.size();
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
         if (vChecks.size() == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
     }
 
@@ -10,6 +10,7 @@
 #include "core_memusage.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -264,6 +265,48 @@ public:
     }
 };
 
+/**
+ * A single unspent transaction output, together with the metadata of the
+ * transaction that created it. This is what most callers outside of block
+ * validation actually need, and it is much cheaper to copy than a whole CCoins.
+ *
+ * Coin is a copy taken out of a CCoins record, not a storage format: the
+ * chainstate database and CCoinsViewCache are still keyed by txid, so
+ * spending one output still loads, modifies and flushes the whole record.
+ */
+class Coin
+{
+public:
+    //! the unspent output itself; IsNull() if spent or not found
+    CTxOut out;
+
+    //! at which height the creating transaction was included in the active block chain
+    int nHeight;
+
+    //! whether the creating transaction is a coinbase
+    bool fCoinBase;
+
+    Coin() : out(), nHeight(0), fCoinBase(false) { }
+
+    Coin(const CCoins &coins, uint32_t nPos) : out(coins.vout[nPos]), nHeight(coins.nHeight), fCoinBase(coins.fCoinBase) {
+        assert(coins.IsAvailable(nPos));
+    }
+
+    void Clear() {
+        out.SetNull();
+        nHeight = 0;
+        fCoinBase = false;
+    }
+
+    bool IsSpent() const {
+        return out.IsNull();
+    }
+
+    size_t DynamicMemoryUsage() const {
+        return RecursiveDynamicUsage(out.scriptPubKey);
+    }
+};
+
 class CCoinsKeyHasher
 {
 private:
@@ -295,7 +338,17 @@ struct CCoinsCacheEntry
     CCoinsCacheEntry() : coins(), flags(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+/**
+ * All nodes of a CCoinsMap have the same size, so they are carved out of a
+ * CPoolResource instead of being allocated one by one. This avoids one heap
+ * allocation per cached transaction, keeps nodes close together in memory and
+ * lets CCoinsViewCache::Flush() hand all of it back in one go.
+ */
+static const size_t COINS_MAP_POOL_BLOCK_SIZE = sizeof(std::pair<const uint256, CCoinsCacheEntry>) + 4 * sizeof(void*);
+typedef CPoolAllocator<std::pair<const uint256, CCoinsCacheEntry>, COINS_MAP_POOL_BLOCK_SIZE, sizeof(void*)> CCoinsMapAllocator;
+typedef CCoinsMapAllocator::ResourceType CCoinsMapMemoryResource;
+
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>, CCoinsMapAllocator> CCoinsMap;
 
 struct CCoinsStats
 {
@@ -318,6 +371,12 @@ public:
     //! Retrieve the CCoins (unspent transaction outputs) for a given txid
     virtual bool GetCoins(const uint256 &txid, CCoins &coins) const;
 
+    //! Retrieve a single unspent output. Returns false if the outpoint is
+    //! unknown or already spent. The default implementation goes through
+    //! GetCoins, so views which override GetCoins get a correct result for
+    //! free; it reads the whole per-txid record from the view.
+    virtual bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+
     //! Just check whether we have data for a given txid.
     //! This may (but cannot always) return true for fully spent transactions
     virtual bool HaveCoins(const uint256 &txid) const;
@@ -349,6 +408,7 @@ public:
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
     void SetBackend(CCoinsView &viewIn);
+    CCoinsView* GetBackend() const { return base; }
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     bool GetStats(CCoinsStats &stats) const;
 };
@@ -389,6 +449,8 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    /* Backing memory for the nodes of cacheCoins; must be declared before it. */
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner CCoins objects. */
@@ -400,6 +462,7 @@ public:
 
     // Standard CCoinsView methods
     bool GetCoins(const uint256 &txid, CCoins &coins) const;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
     bool HaveCoins(const uint256 &txid) const;
     uint256 GetBestBlock() const;
     void SetBestBlock(const uint256 &hashBlock);
@@ -412,6 +475,19 @@ public:
      */
     bool HaveCoinsInCache(const uint256 &txid) const;
 
+    /**
+     * Check whether a single output is unspent. Unlike HaveCoins(), this is
+     * exact: a tx with all other outputs spent does not count.
+     */
+    bool HaveCoin(const COutPoint &outpoint) const;
+
+    /**
+     * Add coins that were read from the backing view outside of this cache
+     * (e.g. in parallel by a prefetcher) as an unmodified entry. Does nothing
+     * if the txid is already cached. The passed coins are swapped out.
+     */
+    void AddPrefetchedCoins(const uint256 &txid, CCoins &coins);
+
     /**
      * Return a pointer to CCoins in the cache, or NULL if not found. This is
      * more efficient than GetCoins. Modifications to other cache entries are
@@ -484,6 +560,9 @@ private:
     CCoinsMap::iterator FetchCoins(const uint256 &txid);
     CCoinsMap::const_iterator FetchCoins(const uint256 &txid) const;
 
+    //! Release all memory held by the (empty) cacheCoins back to the system.
+    void ReallocateCache();
+
     /**
      * By making the copy constructor private, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "activemasternode.h"
+#include "checkqueue.h"
 #include "coincontrol.h"
 #include "consensus/validation.h"
 #include "darksend.h"
@@ -12,6 +13,7 @@
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
+#include "script/sigcache.h"
 #include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
@@ -49,13 +51,6 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             return;
         }
 
-        if(IsSessionReady()) {
-            // too many users in this session already, reject new ones
-            LogPrintf("DSACCEPT -- queue is already full!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, ERR_QUEUE_FULL);
-            return;
-        }
-
         int nDenom;
         CTransaction txCollateral;
         vRecv >> nDenom >> txCollateral;
@@ -68,21 +63,47 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             return;
         }
 
-        if(vecSessionCollaterals.size() == 0 && pmn->nLastDsq != 0 &&
-            pmn->nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5 > mnodeman.nDsqCount)
-        {
-            LogPrintf("DSACCEPT -- last dsq too recent, must wait: addr=%s\n", pfrom->addr.ToString());
-            PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT);
+        LOCK(cs_darksend);
+
+        if(GetSessionByPeer(pfrom->id)) {
+            LogPrintf("DSACCEPT -- peer is already in a session: addr=%s\n", pfrom->addr.ToString());
+            PushStatus(pfrom, STATUS_REJECTED, ERR_MODE);
             return;
         }
 
+        // join the first queued session with the same denom which still has room
+        CDarksendSession* psession = NULL;
+        for(std::map<int, CDarksendSession>::iterator it = mapSessions.begin(); it != mapSessions.end(); ++it) {
+            if(it->second.nState == POOL_STATE_QUEUE && it->second.nSessionDenom == nDenom && !IsSessionReady(it->second)) {
+                psession = &it->second;
+                break;
+            }
+        }
+
+        if(psession == NULL) {
+            if((int)mapSessions.size() >= PRIVATESEND_MAX_SESSIONS) {
+                // too many sessions running already, reject new ones
+                LogPrintf("DSACCEPT -- all %d sessions are busy!\n", (int)mapSessions.size());
+                PushStatus(pfrom, STATUS_REJECTED, ERR_QUEUE_FULL);
+                return;
+            }
+
+            if(pmn->nLastDsq != 0 &&
+                pmn->nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5 > mnodeman.nDsqCount)
+            {
+                LogPrintf("DSACCEPT -- last dsq too recent, must wait: addr=%s\n", pfrom->addr.ToString());
+                PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT);
+                return;
+            }
+        }
+
         PoolMessage nMessageID = MSG_NOERR;
 
-        bool fResult = nSessionID == 0  ? CreateNewSession(nDenom, txCollateral, nMessageID)
-                                        : AddUserToExistingSession(nDenom, txCollateral, nMessageID);
+        bool fResult = psession == NULL ? CreateNewSession(nDenom, txCollateral, pfrom->id, nMessageID)
+                                        : AddUserToExistingSession(*psession, nDenom, txCollateral, pfrom->id, nMessageID);
         if(fResult) {
             LogPrintf("DSACCEPT -- is compatible, please submit!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID);
+            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, GetSessionByPeer(pfrom->id));
             return;
         } else {
             LogPrintf("DSACCEPT -- not compatible with existing transactions!\n");
@@ -177,22 +198,26 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             return;
         }
 
-        //do we have enough users in the current session?
-        if(!IsSessionReady()) {
+        LOCK(cs_darksend);
+
+        //do we have enough users in the session this peer joined?
+        CDarksendSession* psession = GetSessionByPeer(pfrom->id);
+        if(psession == NULL || !IsSessionReady(*psession)) {
             LogPrintf("DSVIN -- session not complete!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_SESSION);
+            PushStatus(pfrom, STATUS_REJECTED, ERR_SESSION, psession);
             return;
         }
+        CDarksendSession& session = *psession;
 
         CDarkSendEntry entry;
         vRecv >> entry;
 
-        LogPrint("privatesend", "DSVIN -- txCollateral %s", entry.txCollateral.ToString());
+        LogPrint("privatesend", "DSVIN -- nSessionID %d  txCollateral %s", session.nSessionID, entry.txCollateral.ToString());
 
         //do we have the same denominations as the current session?
-        if(!IsOutputsCompatibleWithSessionDenom(entry.vecTxDSOut)) {
+        if(!IsOutputsCompatibleWithSessionDenom(session, entry.vecTxDSOut)) {
             LogPrintf("DSVIN -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_EXISTING_TX);
+            PushStatus(pfrom, STATUS_REJECTED, ERR_EXISTING_TX, psession);
             return;
         }
 
@@ -209,12 +234,12 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
                 if(txout.scriptPubKey.size() != 25) {
                     LogPrintf("DSVIN -- non-standard pubkey detected! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY);
+                    PushStatus(pfrom, STATUS_REJECTED, ERR_NON_STANDARD_PUBKEY, psession);
                     return;
                 }
                 if(!txout.scriptPubKey.IsNormalPaymentScript()) {
                     LogPrintf("DSVIN -- invalid script! scriptPubKey=%s\n", ScriptToAsmStr(txout.scriptPubKey));
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT);
+                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_SCRIPT, psession);
                     return;
                 }
             }
@@ -231,14 +256,14 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
                         nValueIn += txPrev.vout[txin.prevout.n].nValue;
                 } else {
                     LogPrintf("DSVIN -- missing input! tx=%s", tx.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX);
+                    PushStatus(pfrom, STATUS_REJECTED, ERR_MISSING_TX, psession);
                     return;
                 }
             }
 
             if(nValueIn > PRIVATESEND_POOL_MAX) {
                 LogPrintf("DSVIN -- more than PrivateSend pool max! nValueIn: %lld, tx=%s", nValueIn, tx.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM);
+                PushStatus(pfrom, STATUS_REJECTED, ERR_MAXIMUM, psession);
                 return;
             }
 
@@ -246,7 +271,7 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             // TODO: Or do not allow fees at all?
             if(nValueIn - nValueOut > vecPrivateSendDenominations.back()) {
                 LogPrintf("DSVIN -- fees are too high! fees: %lld, tx=%s", nValueIn - nValueOut, tx.ToString());
-                PushStatus(pfrom, STATUS_REJECTED, ERR_FEES);
+                PushStatus(pfrom, STATUS_REJECTED, ERR_FEES, psession);
                 return;
             }
 
@@ -256,7 +281,7 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
                 mempool.PrioritiseTransaction(tx.GetHash(), tx.GetHash().ToString(), 1000, 0.1*COIN);
                 if(!AcceptToMemoryPool(mempool, validationState, CTransaction(tx), false, NULL, false, true, true)) {
                     LogPrintf("DSVIN -- transaction not valid! tx=%s", tx.ToString());
-                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_TX);
+                    PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_TX, psession);
                     return;
                 }
             }
@@ -264,15 +289,17 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         PoolMessage nMessageID = MSG_NOERR;
 
-        if(AddEntry(entry, nMessageID)) {
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID);
-            CheckPool();
-            RelayStatus(STATUS_ACCEPTED);
+        if(AddEntry(session, entry, nMessageID)) {
+            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, psession);
+            CheckPool(session);
+            RelayStatus(session, STATUS_ACCEPTED);
         } else {
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID);
-            SetNull();
+            PushStatus(pfrom, STATUS_REJECTED, nMessageID, psession);
+            session.nState = POOL_STATE_IDLE;
         }
 
+        if(session.nState == POOL_STATE_IDLE) RemoveSession(session.nSessionID);
+
     } else if(strCommand == NetMsgType::DSSTATUSUPDATE) {
 
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
@@ -340,20 +367,38 @@ void CDarksendPool::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         LogPrint("privatesend", "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
+        LOCK(cs_darksend);
+
+        CDarksendSession* psession = GetSessionByPeer(pfrom->id);
+        if(psession == NULL || psession->nState != POOL_STATE_SIGNING) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- peer is not signing in any session: addr=%s\n", pfrom->addr.ToString());
+            return;
+        }
+        CDarksendSession& session = *psession;
+
+        // verify all signatures of this participant at once
+        if(!IsInputScriptSigsValid(session, vecTxIn)) {
+            LogPrint("privatesend", "DSSIGNFINALTX -- IsInputScriptSigsValid() failed, session: %d\n", session.nSessionID);
+            RelayStatus(session, STATUS_REJECTED);
+            return;
+        }
+
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
         BOOST_FOREACH(const CTxIn txin, vecTxIn) {
             nTxInIndex++;
-            if(!AddScriptSig(txin)) {
-                LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED);
+            if(!AddScriptSig(session, txin)) {
+                LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, session.nSessionID);
+                RelayStatus(session, STATUS_REJECTED);
                 return;
             }
             LogPrint("privatesend", "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
         }
         // all is good
-        CheckPool();
+        CheckPool(session);
+
+        if(session.nState == POOL_STATE_IDLE) RemoveSession(session.nSessionID);
 
     } else if(strCommand == NetMsgType::DSFINALTX) {
 
@@ -458,9 +503,6 @@ void CDarksendPool::ResetPool()
 
 void CDarksendPool::SetNull()
 {
-    // MN side
-    vecSessionCollaterals.clear();
-
     // Client side
     nEntriesCount = 0;
     fLastEntryAccepted = false;
@@ -559,24 +601,6 @@ std::string CDarksendPool::GetStatus()
 //
 void CDarksendPool::CheckPool()
 {
-    if(fMasterNode) {
-        LogPrint("privatesend", "CDarksendPool::CheckPool -- entries count %lu\n", GetEntriesCount());
-
-        // If entries are full, create finalized transaction
-        if(nState == POOL_STATE_ACCEPTING_ENTRIES && GetEntriesCount() >= GetMaxPoolTransactions()) {
-            LogPrint("privatesend", "CDarksendPool::CheckPool -- FINALIZE TRANSACTIONS\n");
-            CreateFinalTransaction();
-            return;
-        }
-
-        // If we have all of the signatures, try to compile the transaction
-        if(nState == POOL_STATE_SIGNING && IsSignaturesComplete()) {
-            LogPrint("privatesend", "CDarksendPool::CheckPool -- SIGNING\n");
-            CommitFinalTransaction();
-            return;
-        }
-    }
-
     // reset if we're here for 10 seconds
     if((nState == POOL_STATE_ERROR || nState == POOL_STATE_SUCCESS) && GetTimeMillis() - nTimeLastSuccessfulStep >= 10000) {
         LogPrint("privatesend", "CDarksendPool::CheckPool -- timeout, RESETTING\n");
@@ -585,18 +609,42 @@ void CDarksendPool::CheckPool()
     }
 }
 
-void CDarksendPool::CreateFinalTransaction()
+//
+// Check the mixing progress of a session and send client updates, Masternode only
+//
+void CDarksendPool::CheckPool(CDarksendSession& session)
+{
+    if(!fMasterNode) return;
+
+    LogPrint("privatesend", "CDarksendPool::CheckPool -- nSessionID %d  entries count %lu\n", session.nSessionID, session.vecEntries.size());
+
+    // If entries are full, create finalized transaction
+    if(session.nState == POOL_STATE_ACCEPTING_ENTRIES && (int)session.vecEntries.size() >= GetMaxPoolTransactions()) {
+        LogPrint("privatesend", "CDarksendPool::CheckPool -- FINALIZE TRANSACTIONS\n");
+        CreateFinalTransaction(session);
+        return;
+    }
+
+    // If we have all of the signatures, try to compile the transaction
+    if(session.nState == POOL_STATE_SIGNING && IsSignaturesComplete(session)) {
+        LogPrint("privatesend", "CDarksendPool::CheckPool -- SIGNING\n");
+        CommitFinalTransaction(session);
+        return;
+    }
+}
+
+void CDarksendPool::CreateFinalTransaction(CDarksendSession& session)
 {
     LogPrint("privatesend", "CDarksendPool::CreateFinalTransaction -- FINALIZE TRANSACTIONS\n");
 
     CMutableTransaction txNew;
 
     // make our new transaction
-    for(int i = 0; i < GetEntriesCount(); i++) {
-        BOOST_FOREACH(const CTxDSOut& txdsout, vecEntries[i].vecTxDSOut)
+    BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries) {
+        BOOST_FOREACH(const CTxDSOut& txdsout, entry.vecTxDSOut)
             txNew.vout.push_back(txdsout);
 
-        BOOST_FOREACH(const CTxDSIn& txdsin, vecEntries[i].vecTxDSIn)
+        BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn)
             txNew.vin.push_back(txdsin);
     }
 
@@ -604,19 +652,20 @@ void CDarksendPool::CreateFinalTransaction()
     sort(txNew.vin.begin(), txNew.vin.end());
     sort(txNew.vout.begin(), txNew.vout.end());
 
-    finalMutableTransaction = txNew;
-    LogPrint("privatesend", "CDarksendPool::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString());
+    session.finalMutableTransaction = txNew;
+    LogPrint("privatesend", "CDarksendPool::CreateFinalTransaction -- nSessionID %d  finalMutableTransaction=%s", session.nSessionID, txNew.ToString());
 
     // request signatures from clients
-    RelayFinalTransaction(finalMutableTransaction);
-    SetState(POOL_STATE_SIGNING);
+    RelayFinalTransaction(session, session.finalMutableTransaction);
+    session.nState = POOL_STATE_SIGNING;
+    session.nTimeLastSuccessfulStep = GetTimeMillis();
 }
 
-void CDarksendPool::CommitFinalTransaction()
+void CDarksendPool::CommitFinalTransaction(CDarksendSession& session)
 {
     if(!fMasterNode) return; // check and relay final tx only on masternode
 
-    CTransaction finalTransaction = CTransaction(finalMutableTransaction);
+    CTransaction finalTransaction = CTransaction(session.finalMutableTransaction);
     uint256 hashTx = finalTransaction.GetHash();
 
     LogPrint("privatesend", "CDarksendPool::CommitFinalTransaction -- finalTransaction=%s", finalTransaction.ToString());
@@ -629,9 +678,9 @@ void CDarksendPool::CommitFinalTransaction()
         if(!lockMain || !AcceptToMemoryPool(mempool, validationState, finalTransaction, false, NULL, false, true, true))
         {
             LogPrintf("CDarksendPool::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
-            SetNull();
             // not much we can do in this case, just notify clients
-            RelayCompletedTransaction(ERR_INVALID_TX);
+            RelayCompletedTransaction(session, ERR_INVALID_TX);
+            session.nState = POOL_STATE_IDLE;
             return;
         }
     }
@@ -651,14 +700,14 @@ void CDarksendPool::CommitFinalTransaction()
     RelayInv(inv);
 
     // Tell the clients it was successful
-    RelayCompletedTransaction(MSG_SUCCESS);
+    RelayCompletedTransaction(session, MSG_SUCCESS);
 
     // Randomly charge clients
-    ChargeRandomFees();
+    ChargeRandomFees(session);
 
     // Reset
-    LogPrint("privatesend", "CDarksendPool::CommitFinalTransaction -- COMPLETED -- RESETTING\n");
-    SetNull();
+    LogPrint("privatesend", "CDarksendPool::CommitFinalTransaction -- COMPLETED -- RESETTING, nSessionID %d\n", session.nSessionID);
+    session.nState = POOL_STATE_IDLE;
 }
 
 //
@@ -673,7 +722,7 @@ void CDarksendPool::CommitFinalTransaction()
 // transaction for the client to be able to enter the pool. This transaction is kept by the Masternode
 // until the transaction is either complete or fails.
 //
-void CDarksendPool::ChargeFees()
+void CDarksendPool::ChargeFees(const CDarksendSession& session)
 {
     if(!fMasterNode) return;
 
@@ -682,10 +731,10 @@ void CDarksendPool::ChargeFees()
 
     std::vector<CTransaction> vecOffendersCollaterals;
 
-    if(nState == POOL_STATE_ACCEPTING_ENTRIES) {
-        BOOST_FOREACH(const CTransaction& txCollateral, vecSessionCollaterals) {
+    if(session.nState == POOL_STATE_ACCEPTING_ENTRIES) {
+        BOOST_FOREACH(const CTransaction& txCollateral, session.vecSessionCollaterals) {
             bool fFound = false;
-            BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries)
+            BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries)
                 if(entry.txCollateral == txCollateral)
                     fFound = true;
 
@@ -697,9 +746,9 @@ void CDarksendPool::ChargeFees()
         }
     }
 
-    if(nState == POOL_STATE_SIGNING) {
+    if(session.nState == POOL_STATE_SIGNING) {
         // who didn't sign?
-        BOOST_FOREACH(const CDarkSendEntry entry, vecEntries) {
+        BOOST_FOREACH(const CDarkSendEntry entry, session.vecEntries) {
             BOOST_FOREACH(const CTxDSIn txdsin, entry.vecTxDSIn) {
                 if(!txdsin.fHasSig) {
                     LogPrintf("CDarksendPool::ChargeFees -- found uncooperative node (didn't sign), found offence\n");
@@ -721,9 +770,9 @@ void CDarksendPool::ChargeFees()
     //charge one of the offenders randomly
     std::random_shuffle(vecOffendersCollaterals.begin(), vecOffendersCollaterals.end());
 
-    if(nState == POOL_STATE_ACCEPTING_ENTRIES || nState == POOL_STATE_SIGNING) {
+    if(session.nState == POOL_STATE_ACCEPTING_ENTRIES || session.nState == POOL_STATE_SIGNING) {
         LogPrintf("CDarksendPool::ChargeFees -- found uncooperative node (didn't %s transaction), charging fees: %s\n",
-                (nState == POOL_STATE_SIGNING) ? "sign" : "send", vecOffendersCollaterals[0].ToString());
+                (session.nState == POOL_STATE_SIGNING) ? "sign" : "send", vecOffendersCollaterals[0].ToString());
 
         LOCK(cs_main);
 
@@ -750,13 +799,13 @@ void CDarksendPool::ChargeFees()
     stop these kinds of attacks 1 in 10 successful transactions are charged. This
     adds up to a cost of 0.001DRK per transaction on average.
 */
-void CDarksendPool::ChargeRandomFees()
+void CDarksendPool::ChargeRandomFees(const CDarksendSession& session)
 {
     if(!fMasterNode) return;
 
     LOCK(cs_main);
 
-    BOOST_FOREACH(const CTransaction& txCollateral, vecSessionCollaterals) {
+    BOOST_FOREACH(const CTransaction& txCollateral, session.vecSessionCollaterals) {
 
         if(GetRandInt(100) > 10) return;
 
@@ -790,34 +839,48 @@ void CDarksendPool::CheckTimeout()
                 it = vecDarksendQueue.erase(it);
             } else ++it;
         }
+
+        if(fMasterNode) {
+            // check every session we run for timeouts
+            std::vector<int> vecSessionsTimedOut;
+            for(std::map<int, CDarksendSession>::iterator itSession = mapSessions.begin(); itSession != mapSessions.end(); ++itSession) {
+                CDarksendSession& session = itSession->second;
+                int nTimeout = (session.nState == POOL_STATE_SIGNING) ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT;
+                if(GetTimeMillis() - session.nTimeLastSuccessfulStep >= nTimeout*1000) {
+                    LogPrint("privatesend", "CDarksendPool::CheckTimeout -- %s timed out (%ds) -- removing session %d\n",
+                            (session.nState == POOL_STATE_SIGNING) ? "Signing" : "Session", nTimeout, session.nSessionID);
+                    ChargeFees(session);
+                    vecSessionsTimedOut.push_back(session.nSessionID);
+                }
+            }
+            BOOST_FOREACH(int nSessionIDTimedOut, vecSessionsTimedOut)
+                RemoveSession(nSessionIDTimedOut);
+        }
     }
 
-    if(!fEnablePrivateSend && !fMasterNode) return;
+    if(!fEnablePrivateSend || fMasterNode) return;
 
     // catching hanging sessions
-    if(!fMasterNode) {
-        switch(nState) {
-            case POOL_STATE_ERROR:
-                LogPrint("privatesend", "CDarksendPool::CheckTimeout -- Pool error -- Running CheckPool\n");
-                CheckPool();
-                break;
-            case POOL_STATE_SUCCESS:
-                LogPrint("privatesend", "CDarksendPool::CheckTimeout -- Pool success -- Running CheckPool\n");
-                CheckPool();
-                break;
-            default:
-                break;
-        }
+    switch(nState) {
+        case POOL_STATE_ERROR:
+            LogPrint("privatesend", "CDarksendPool::CheckTimeout -- Pool error -- Running CheckPool\n");
+            CheckPool();
+            break;
+        case POOL_STATE_SUCCESS:
+            LogPrint("privatesend", "CDarksendPool::CheckTimeout -- Pool success -- Running CheckPool\n");
+            CheckPool();
+            break;
+        default:
+            break;
     }
 
-    int nLagTime = fMasterNode ? 0 : 10000; // if we're the client, give the server a few extra seconds before resetting.
+    int nLagTime = 10000; // give the server a few extra seconds before resetting.
     int nTimeout = (nState == POOL_STATE_SIGNING) ? PRIVATESEND_SIGNING_TIMEOUT : PRIVATESEND_QUEUE_TIMEOUT;
     bool fTimeout = GetTimeMillis() - nTimeLastSuccessfulStep >= nTimeout*1000 + nLagTime;
 
     if(nState != POOL_STATE_IDLE && fTimeout) {
         LogPrint("privatesend", "CDarksendPool::CheckTimeout -- %s timed out (%ds) -- restting\n",
                 (nState == POOL_STATE_SIGNING) ? "Signing" : "Session", nTimeout);
-        ChargeFees();
         UnlockCoins();
         SetNull();
         SetState(POOL_STATE_ERROR);
@@ -832,58 +895,139 @@ void CDarksendPool::CheckTimeout()
 */
 void CDarksendPool::CheckForCompleteQueue()
 {
-    if(!fEnablePrivateSend && !fMasterNode) return;
+    if(!fMasterNode) return;
+
+    TRY_LOCK(cs_darksend, lockDS);
+    if(!lockDS) return; // it's ok to fail here, we run this quite frequently
 
-    if(nState == POOL_STATE_QUEUE && IsSessionReady()) {
-        SetState(POOL_STATE_ACCEPTING_ENTRIES);
+    for(std::map<int, CDarksendSession>::iterator it = mapSessions.begin(); it != mapSessions.end(); ++it) {
+        CDarksendSession& session = it->second;
+        if(session.nState != POOL_STATE_QUEUE || !IsSessionReady(session)) continue;
 
-        CDarksendQueue dsq(nSessionDenom, activeMasternode.vin, GetTime(), true);
-        LogPrint("privatesend", "CDarksendPool::CheckForCompleteQueue -- queue is ready, signing and relaying (%s)\n", dsq.ToString());
+        session.nState = POOL_STATE_ACCEPTING_ENTRIES;
+        session.nTimeLastSuccessfulStep = GetTimeMillis();
+
+        // only participants of this session should submit, other sessions on this masternode might still be queueing
+        CDarksendQueue dsq(session.nSessionDenom, activeMasternode.vin, GetTime(), true);
+        LogPrint("privatesend", "CDarksendPool::CheckForCompleteQueue -- queue is ready, signing and relaying to session %d (%s)\n", session.nSessionID, dsq.ToString());
         dsq.Sign();
-        dsq.Relay();
+
+        LOCK(cs_vNodes);
+        BOOST_FOREACH(CNode* pnode, vNodes)
+            if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION && session.setPeers.count(pnode->id))
+                pnode->PushMessage(NetMsgType::DSQUEUE, dsq);
     }
 }
 
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CDarksendPool::IsInputScriptSigValid(const CTxIn& txin)
+/**
+ * Closure verifying the scriptSig of one input of a mixing final transaction.
+ * Valid signatures are stored in the signature cache, so that committing the
+ * final transaction to the mempool does not have to verify them again.
+ */
+class CDarksendSigCheck
 {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
+private:
+    CScript scriptPubKey;
+    const CTransaction *ptxTo;
+    unsigned int nIn;
+
+public:
+    CDarksendSigCheck() : ptxTo(NULL), nIn(0) {}
+    CDarksendSigCheck(const CScript& scriptPubKeyIn, const CTransaction& txToIn, unsigned int nInIn) :
+        scriptPubKey(scriptPubKeyIn), ptxTo(&txToIn), nIn(nInIn) {}
+
+    bool operator()() {
+        if(!VerifyScript(ptxTo->vin[nIn].scriptSig, scriptPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, CachingTransactionSignatureChecker(ptxTo, nIn, true))) {
+            LogPrint("privatesend", "CDarksendSigCheck -- VerifyScript() failed on input %d\n", nIn);
+            return false;
+        }
+        return true;
+    }
 
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
+    void swap(CDarksendSigCheck &check) {
+        scriptPubKey.swap(check.scriptPubKey);
+        std::swap(ptxTo, check.ptxTo);
+        std::swap(nIn, check.nIn);
+    }
+};
 
-    BOOST_FOREACH(CDarkSendEntry& entry, vecEntries) {
+static CCheckQueue<CDarksendSigCheck> dssigcheckqueue(16);
 
-        BOOST_FOREACH(const CTxDSOut& txdsout, entry.vecTxDSOut)
-            txNew.vout.push_back(txdsout);
+void ThreadDarksendSigCheck()
+{
+    RenameThread("sibcoin-pssigchk");
+    dssigcheckqueue.Thread();
+}
 
-        BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
+// Check to make sure given inputs match inputs in the session and their scriptSigs are valid
+bool CDarksendPool::IsInputScriptSigsValid(const CDarksendSession& session, const std::vector<CTxIn>& vecTxIn)
+{
+    // all new signatures go into one copy of the final transaction, inputs are signed
+    // with SIGHASH_ANYONECANPAY so the other inputs' scriptSigs do not affect the sighash
+    CMutableTransaction txNew = session.finalMutableTransaction;
+    std::vector<std::pair<unsigned int, CScript> > vecInputs;
+    std::set<COutPoint> setPrevouts;
+
+    BOOST_FOREACH(const CTxIn& txin, vecTxIn) {
+        // every scriptSig of the batch must be the one that gets verified, a repeated
+        // prevout would overwrite an earlier scriptSig and leave it unchecked
+        if(!setPrevouts.insert(txin.prevout).second) {
+            LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- Duplicate input %s\n", txin.prevout.ToStringShort());
+            return false;
+        }
 
-            if(txdsin.prevout == txin.prevout) {
+        int nTxInIndex = -1;
+        for(unsigned int i = 0; i < txNew.vin.size(); i++) {
+            if(txNew.vin[i].prevout == txin.prevout && txNew.vin[i].nSequence == txin.nSequence) {
                 nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
+                break;
             }
-            i++;
         }
-    }
 
-    if(nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0,24));
-        if(!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex))) {
-            LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
+        CScript sigPubKey = CScript();
+        bool fFound = false;
+        BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries) {
+            BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
+                if(txdsin.prevout == txin.prevout) {
+                    sigPubKey = txdsin.prevPubKey;
+                    fFound = true;
+                }
+            }
+        }
+
+        if(nTxInIndex < 0 || !fFound) {
+            LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- Failed to find matching input in pool, %s\n", txin.ToString());
             return false;
         }
+
+        LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0,24));
+        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
+        vecInputs.push_back(std::make_pair((unsigned int)nTxInIndex, sigPubKey));
+    }
+
+    const CTransaction txToCheck(txNew);
+    std::vector<CDarksendSigCheck> vChecks;
+    vChecks.reserve(vecInputs.size());
+    for(unsigned int i = 0; i < vecInputs.size(); i++)
+        vChecks.push_back(CDarksendSigCheck(vecInputs[i].second, txToCheck, vecInputs[i].first));
+
+    bool fValid = true;
+    if(nScriptCheckThreads && vChecks.size() > 1) {
+        CCheckQueueControl<CDarksendSigCheck> control(&dssigcheckqueue);
+        control.Add(vChecks);
+        fValid = control.Wait();
     } else {
-        LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
-        return false;
+        BOOST_FOREACH(CDarksendSigCheck& check, vChecks) {
+            if(!check()) {
+                fValid = false;
+                break;
+            }
+        }
     }
 
-    LogPrint("privatesend", "CDarksendPool::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    if(!fValid) return false;
+
+    LogPrint("privatesend", "CDarksendPool::IsInputScriptSigsValid -- Successfully validated %d inputs and scriptSigs\n", (int)vecInputs.size());
     return true;
 }
 
@@ -946,7 +1090,7 @@ bool CDarksendPool::IsCollateralValid(const CTransaction& txCollateral)
 //
 // Add a clients transaction to the pool
 //
-bool CDarksendPool::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet)
+bool CDarksendPool::AddEntry(CDarksendSession& session, const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet)
 {
     if(!fMasterNode) return false;
 
@@ -964,7 +1108,7 @@ bool CDarksendPool::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessa
         return false;
     }
 
-    if(GetEntriesCount() >= GetMaxPoolTransactions()) {
+    if((int)session.vecEntries.size() >= GetMaxPoolTransactions()) {
         LogPrint("privatesend", "CDarksendPool::AddEntry -- entries is full!\n");
         nMessageIDRet = ERR_ENTRIES_FULL;
         return false;
@@ -972,7 +1116,7 @@ bool CDarksendPool::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessa
 
     BOOST_FOREACH(CTxIn txin, entryNew.vecTxDSIn) {
         LogPrint("privatesend", "looking for txin -- %s\n", txin.ToString());
-        BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries) {
+        BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries) {
             BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
                 if(txdsin.prevout == txin.prevout) {
                     LogPrint("privatesend", "CDarksendPool::AddEntry -- found in txin\n");
@@ -983,20 +1127,20 @@ bool CDarksendPool::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessa
         }
     }
 
-    vecEntries.push_back(entryNew);
+    session.vecEntries.push_back(entryNew);
 
-    LogPrint("privatesend", "CDarksendPool::AddEntry -- adding entry\n");
+    LogPrint("privatesend", "CDarksendPool::AddEntry -- adding entry to session %d\n", session.nSessionID);
     nMessageIDRet = MSG_ENTRIES_ADDED;
-    nTimeLastSuccessfulStep = GetTimeMillis();
+    session.nTimeLastSuccessfulStep = GetTimeMillis();
 
     return true;
 }
 
-bool CDarksendPool::AddScriptSig(const CTxIn& txinNew)
+bool CDarksendPool::AddScriptSig(CDarksendSession& session, const CTxIn& txinNew)
 {
     LogPrint("privatesend", "CDarksendPool::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
 
-    BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries) {
+    BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries) {
         BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn) {
             if(txdsin.scriptSig == txinNew.scriptSig) {
                 LogPrint("privatesend", "CDarksendPool::AddScriptSig -- already exists\n");
@@ -1005,22 +1149,17 @@ bool CDarksendPool::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if(!IsInputScriptSigValid(txinNew)) {
-        LogPrint("privatesend", "CDarksendPool::AddScriptSig -- Invalid scriptSig\n");
-        return false;
-    }
-
     LogPrint("privatesend", "CDarksendPool::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
 
-    BOOST_FOREACH(CTxIn& txin, finalMutableTransaction.vin) {
+    BOOST_FOREACH(CTxIn& txin, session.finalMutableTransaction.vin) {
         if(txinNew.prevout == txin.prevout && txin.nSequence == txinNew.nSequence) {
             txin.scriptSig = txinNew.scriptSig;
             txin.prevPubKey = txinNew.prevPubKey;
             LogPrint("privatesend", "CDarksendPool::AddScriptSig -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
         }
     }
-    for(int i = 0; i < GetEntriesCount(); i++) {
-        if(vecEntries[i].AddScriptSig(txinNew)) {
+    for(unsigned int i = 0; i < session.vecEntries.size(); i++) {
+        if(session.vecEntries[i].AddScriptSig(txinNew)) {
             LogPrint("privatesend", "CDarksendPool::AddScriptSig -- adding to entries, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
             return true;
         }
@@ -1031,9 +1170,9 @@ bool CDarksendPool::AddScriptSig(const CTxIn& txinNew)
 }
 
 // Check to make sure everything is signed
-bool CDarksendPool::IsSignaturesComplete()
+bool CDarksendPool::IsSignaturesComplete(const CDarksendSession& session)
 {
-    BOOST_FOREACH(const CDarkSendEntry& entry, vecEntries)
+    BOOST_FOREACH(const CDarkSendEntry& entry, session.vecEntries)
         BOOST_FOREACH(const CTxDSIn& txdsin, entry.vecTxDSIn)
             if(!txdsin.fHasSig) return false;
 
@@ -2002,11 +2141,11 @@ bool CDarksendPool::CreateDenominated(const CompactTallyItem& tallyItem, bool fC
     return true;
 }
 
-bool CDarksendPool::IsOutputsCompatibleWithSessionDenom(const std::vector<CTxDSOut>& vecTxDSOut)
+bool CDarksendPool::IsOutputsCompatibleWithSessionDenom(const CDarksendSession& session, const std::vector<CTxDSOut>& vecTxDSOut)
 {
     if(GetDenominations(vecTxDSOut) == 0) return false;
 
-    BOOST_FOREACH(const CDarkSendEntry entry, vecEntries) {
+    BOOST_FOREACH(const CDarkSendEntry entry, session.vecEntries) {
         LogPrintf("CDarksendPool::IsOutputsCompatibleWithSessionDenom -- vecTxDSOut denom %d, entry.vecTxDSOut denom %d\n", GetDenominations(vecTxDSOut), GetDenominations(entry.vecTxDSOut));
         if(GetDenominations(vecTxDSOut) != GetDenominations(entry.vecTxDSOut)) return false;
     }
@@ -2036,14 +2175,13 @@ bool CDarksendPool::IsAcceptableDenomAndCollateral(int nDenom, CTransaction txCo
     return true;
 }
 
-bool CDarksendPool::CreateNewSession(int nDenom, CTransaction txCollateral, PoolMessage& nMessageIDRet)
+bool CDarksendPool::CreateNewSession(int nDenom, CTransaction txCollateral, NodeId nodeId, PoolMessage& nMessageIDRet)
 {
-    if(!fMasterNode || nSessionID != 0) return false;
+    if(!fMasterNode) return false;
 
-    // new session can only be started in idle mode
-    if(nState != POOL_STATE_IDLE) {
-        nMessageIDRet = ERR_MODE;
-        LogPrintf("CDarksendPool::CreateNewSession -- incompatible mode: nState=%d\n", nState);
+    if((int)mapSessions.size() >= PRIVATESEND_MAX_SESSIONS) {
+        nMessageIDRet = ERR_QUEUE_FULL;
+        LogPrintf("CDarksendPool::CreateNewSession -- too many sessions: %d\n", (int)mapSessions.size());
         return false;
     }
 
@@ -2052,47 +2190,60 @@ bool CDarksendPool::CreateNewSession(int nDenom, CTransaction txCollateral, Pool
     }
 
     // start new session
-    nMessageIDRet = MSG_NOERR;
-    nSessionID = GetRandInt(999999)+1;
-    nSessionDenom = nDenom;
+    int nSessionIDNew = 0;
+    while(nSessionIDNew == 0 || mapSessions.count(nSessionIDNew))
+        nSessionIDNew = GetRandInt(999999)+1;
 
-    SetState(POOL_STATE_QUEUE);
-    nTimeLastSuccessfulStep = GetTimeMillis();
+    CDarksendSession& session = mapSessions.insert(std::make_pair(nSessionIDNew, CDarksendSession(nSessionIDNew, nDenom))).first->second;
+    nMessageIDRet = MSG_NOERR;
 
     if(!fUnitTest) {
-        //broadcast that I'm accepting entries, only if it's the first entry through
-        CDarksendQueue dsq(nDenom, activeMasternode.vin, GetTime(), false);
-        LogPrint("privatesend", "CDarksendPool::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
-        dsq.Sign();
-        dsq.Relay();
-        vecDarksendQueue.push_back(dsq);
+        // peers drop a second "not yet ready" dsq from us while the previous one is alive,
+        // so only announce this session if no other queue of ours is pending
+        bool fQueuePending = false;
+        BOOST_FOREACH(CDarksendQueue& q, vecDarksendQueue) {
+            if(q.vin == activeMasternode.vin && !q.fReady && !q.IsExpired()) {
+                fQueuePending = true;
+                break;
+            }
+        }
+        if(!fQueuePending) {
+            //broadcast that I'm accepting entries, only if it's the first entry through
+            CDarksendQueue dsq(nDenom, activeMasternode.vin, GetTime(), false);
+            LogPrint("privatesend", "CDarksendPool::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
+            dsq.Sign();
+            dsq.Relay();
+            vecDarksendQueue.push_back(dsq);
+        }
     }
 
-    vecSessionCollaterals.push_back(txCollateral);
-    LogPrintf("CDarksendPool::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
-            nSessionID, nSessionDenom, GetDenominationsToString(nSessionDenom), vecSessionCollaterals.size());
+    session.vecSessionCollaterals.push_back(txCollateral);
+    session.setPeers.insert(nodeId);
+    mapSessionPeers[nodeId] = session.nSessionID;
+    LogPrintf("CDarksendPool::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d  sessions: %d\n",
+            session.nSessionID, session.nSessionDenom, GetDenominationsToString(session.nSessionDenom), session.vecSessionCollaterals.size(), (int)mapSessions.size());
 
     return true;
 }
 
-bool CDarksendPool::AddUserToExistingSession(int nDenom, CTransaction txCollateral, PoolMessage& nMessageIDRet)
+bool CDarksendPool::AddUserToExistingSession(CDarksendSession& session, int nDenom, CTransaction txCollateral, NodeId nodeId, PoolMessage& nMessageIDRet)
 {
-    if(!fMasterNode || nSessionID == 0 || IsSessionReady()) return false;
+    if(!fMasterNode || IsSessionReady(session)) return false;
 
     if(!IsAcceptableDenomAndCollateral(nDenom, txCollateral, nMessageIDRet)) {
         return false;
     }
 
     // we only add new users to an existing session when we are in queue mode
-    if(nState != POOL_STATE_QUEUE) {
+    if(session.nState != POOL_STATE_QUEUE) {
         nMessageIDRet = ERR_MODE;
-        LogPrintf("CDarksendPool::AddUserToExistingSession -- incompatible mode: nState=%d\n", nState);
+        LogPrintf("CDarksendPool::AddUserToExistingSession -- incompatible mode: nState=%d\n", session.nState);
         return false;
     }
 
-    if(nDenom != nSessionDenom) {
+    if(nDenom != session.nSessionDenom) {
         LogPrintf("CDarksendPool::AddUserToExistingSession -- incompatible denom %d (%s) != nSessionDenom %d (%s)\n",
-                    nDenom, GetDenominationsToString(nDenom), nSessionDenom, GetDenominationsToString(nSessionDenom));
+                    nDenom, GetDenominationsToString(nDenom), session.nSessionDenom, GetDenominationsToString(session.nSessionDenom));
         nMessageIDRet = ERR_DENOM;
         return false;
     }
@@ -2100,15 +2251,43 @@ bool CDarksendPool::AddUserToExistingSession(int nDenom, CTransaction txCollater
     // count new user as accepted to an existing session
 
     nMessageIDRet = MSG_NOERR;
-    nTimeLastSuccessfulStep = GetTimeMillis();
-    vecSessionCollaterals.push_back(txCollateral);
+    session.nTimeLastSuccessfulStep = GetTimeMillis();
+    session.vecSessionCollaterals.push_back(txCollateral);
+    session.setPeers.insert(nodeId);
+    mapSessionPeers[nodeId] = session.nSessionID;
 
     LogPrintf("CDarksendPool::AddUserToExistingSession -- new user accepted, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d\n",
-            nSessionID, nSessionDenom, GetDenominationsToString(nSessionDenom), vecSessionCollaterals.size());
+            session.nSessionID, session.nSessionDenom, GetDenominationsToString(session.nSessionDenom), session.vecSessionCollaterals.size());
 
     return true;
 }
 
+CDarksendPool::CDarksendSession* CDarksendPool::GetSessionByPeer(NodeId nodeId)
+{
+    std::map<NodeId, int>::iterator itPeer = mapSessionPeers.find(nodeId);
+    if(itPeer == mapSessionPeers.end()) return NULL;
+
+    std::map<int, CDarksendSession>::iterator it = mapSessions.find(itPeer->second);
+    if(it == mapSessions.end()) return NULL;
+
+    return &it->second;
+}
+
+void CDarksendPool::RemoveSession(int nSessionIDToRemove)
+{
+    std::map<int, CDarksendSession>::iterator it = mapSessions.find(nSessionIDToRemove);
+    if(it == mapSessions.end()) return;
+
+    BOOST_FOREACH(NodeId nodeId, it->second.setPeers) {
+        std::map<NodeId, int>::iterator itPeer = mapSessionPeers.find(nodeId);
+        if(itPeer != mapSessionPeers.end() && itPeer->second == nSessionIDToRemove)
+            mapSessionPeers.erase(itPeer);
+    }
+
+    mapSessions.erase(it);
+    LogPrint("privatesend", "CDarksendPool::RemoveSession -- nSessionID: %d  sessions left: %d\n", nSessionIDToRemove, (int)mapSessions.size());
+}
+
 /*  Create a nice string to show the denominations
     Function returns as follows (for 4 denominations):
         ( bit on if present )
@@ -2397,12 +2576,12 @@ bool CDarksendBroadcastTx::CheckSignature(const CPubKey& pubKeyMasternode)
     return true;
 }
 
-void CDarksendPool::RelayFinalTransaction(const CTransaction& txFinal)
+void CDarksendPool::RelayFinalTransaction(const CDarksendSession& session, const CTransaction& txFinal)
 {
     LOCK(cs_vNodes);
     BOOST_FOREACH(CNode* pnode, vNodes)
-        if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION)
-            pnode->PushMessage(NetMsgType::DSFINALTX, nSessionID, txFinal);
+        if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION && session.setPeers.count(pnode->id))
+            pnode->PushMessage(NetMsgType::DSFINALTX, session.nSessionID, txFinal);
 }
 
 void CDarksendPool::RelayIn(const CDarkSendEntry& entry)
@@ -2416,26 +2595,29 @@ void CDarksendPool::RelayIn(const CDarkSendEntry& entry)
     }
 }
 
-void CDarksendPool::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID)
+void CDarksendPool::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, const CDarksendSession* psession)
 {
     if(!pnode) return;
-    pnode->PushMessage(NetMsgType::DSSTATUSUPDATE, nSessionID, (int)nState, (int)vecEntries.size(), (int)nStatusUpdate, (int)nMessageID);
+    if(psession)
+        pnode->PushMessage(NetMsgType::DSSTATUSUPDATE, psession->nSessionID, (int)psession->nState, (int)psession->vecEntries.size(), (int)nStatusUpdate, (int)nMessageID);
+    else
+        pnode->PushMessage(NetMsgType::DSSTATUSUPDATE, nSessionID, (int)nState, (int)vecEntries.size(), (int)nStatusUpdate, (int)nMessageID);
 }
 
-void CDarksendPool::RelayStatus(PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID)
+void CDarksendPool::RelayStatus(const CDarksendSession& session, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID)
 {
     LOCK(cs_vNodes);
     BOOST_FOREACH(CNode* pnode, vNodes)
-        if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION)
-            PushStatus(pnode, nStatusUpdate, nMessageID);
+        if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION && session.setPeers.count(pnode->id))
+            PushStatus(pnode, nStatusUpdate, nMessageID, &session);
 }
 
-void CDarksendPool::RelayCompletedTransaction(PoolMessage nMessageID)
+void CDarksendPool::RelayCompletedTransaction(const CDarksendSession& session, PoolMessage nMessageID)
 {
     LOCK(cs_vNodes);
     BOOST_FOREACH(CNode* pnode, vNodes)
-        if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION)
-            pnode->PushMessage(NetMsgType::DSCOMPLETE, nSessionID, (int)nMessageID);
+        if(pnode->nVersion >= MIN_PRIVATESEND_PEER_PROTO_VERSION && session.setPeers.count(pnode->id))
+            pnode->PushMessage(NetMsgType::DSCOMPLETE, session.nSessionID, (int)nMessageID);
 }
 
 void CDarksendPool::SetState(PoolState nStateNew)
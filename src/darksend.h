@@ -18,6 +18,9 @@ static const int PRIVATESEND_AUTO_TIMEOUT_MAX       = 15;
 static const int PRIVATESEND_QUEUE_TIMEOUT          = 30;
 static const int PRIVATESEND_SIGNING_TIMEOUT        = 15;
 
+//! maximum number of mixing sessions a masternode runs at the same time
+static const int PRIVATESEND_MAX_SESSIONS           = 8;
+
 //! minimum peer version accepted by mixing pool
 static const int MIN_PRIVATESEND_PEER_PROTO_VERSION = 70206;
 
@@ -300,6 +303,36 @@ private:
         STATUS_ACCEPTED
     };
 
+    /** Masternode side state of a single mixing session.
+     *  Masternodes can run several sessions at once, each with its own denom,
+     *  participants and timeout. Participants are identified by their peer
+     *  since dsi/dss messages do not carry a session id.
+     */
+    struct CDarksendSession {
+        int nSessionID;
+        int nSessionDenom;
+        PoolState nState;
+        int64_t nTimeLastSuccessfulStep; // in UTC milliseconds
+        // Mixing uses collateral transactions to trust parties entering the pool
+        // to behave honestly. If they don't it takes their money.
+        std::vector<CTransaction> vecSessionCollaterals;
+        std::vector<CDarkSendEntry> vecEntries;
+        CMutableTransaction finalMutableTransaction;
+        std::set<NodeId> setPeers;
+
+        CDarksendSession(int nSessionIDIn, int nSessionDenomIn) :
+            nSessionID(nSessionIDIn),
+            nSessionDenom(nSessionDenomIn),
+            nState(POOL_STATE_QUEUE),
+            nTimeLastSuccessfulStep(GetTimeMillis()),
+            vecSessionCollaterals(),
+            vecEntries(),
+            finalMutableTransaction(),
+            setPeers()
+            {}
+    };
+
+    // protects vecDarksendQueue and masternode sessions
     mutable CCriticalSection cs_darksend;
 
     // The current mixing sessions in progress on the network
@@ -309,10 +342,11 @@ private:
 
     std::vector<CAmount> vecDenominationsSkipped;
     std::vector<COutPoint> vecOutPointLocked;
-    // Mixing uses collateral transactions to trust parties entering the pool
-    // to behave honestly. If they don't it takes their money.
-    std::vector<CTransaction> vecSessionCollaterals;
-    std::vector<CDarkSendEntry> vecEntries; // Masternode/clients entries
+    std::vector<CDarkSendEntry> vecEntries; // client entries
+
+    // Masternode side: sessions by id and the session every participant belongs to
+    std::map<int, CDarksendSession> mapSessions;
+    std::map<NodeId, int> mapSessionPeers;
 
     PoolState nState; // should be one of the POOL_STATE_XXX values
     int64_t nTimeLastSuccessfulStep; // the time when last successful mixing step was performed, in UTC milliseconds
@@ -334,21 +368,22 @@ private:
     CMutableTransaction txMyCollateral; // client side collateral
     CMutableTransaction finalMutableTransaction; // the finalized transaction ready for signing
 
-    /// Add a clients entry to the pool
-    bool AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
+    /// Add a clients entry to the session
+    bool AddEntry(CDarksendSession& session, const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
     /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
+    bool AddScriptSig(CDarksendSession& session, const CTxIn& txin);
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
-    void ChargeFees();
+    void ChargeFees(const CDarksendSession& session);
     /// Rarely charge fees to pay miners
-    void ChargeRandomFees();
+    void ChargeRandomFees(const CDarksendSession& session);
 
     /// Check for process
     void CheckPool();
+    void CheckPool(CDarksendSession& session);
 
-    void CreateFinalTransaction();
-    void CommitFinalTransaction();
+    void CreateFinalTransaction(CDarksendSession& session);
+    void CommitFinalTransaction(CDarksendSession& session);
 
     void CompletedTransaction(PoolMessage nMessageID);
 
@@ -362,19 +397,23 @@ private:
 
     /// Is this nDenom and txCollateral acceptable?
     bool IsAcceptableDenomAndCollateral(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
-    bool CreateNewSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
-    bool AddUserToExistingSession(int nDenom, CTransaction txCollateral, PoolMessage &nMessageIDRet);
+    bool CreateNewSession(int nDenom, CTransaction txCollateral, NodeId nodeId, PoolMessage &nMessageIDRet);
+    bool AddUserToExistingSession(CDarksendSession& session, int nDenom, CTransaction txCollateral, NodeId nodeId, PoolMessage &nMessageIDRet);
     /// Do we have enough users to take entries?
-    bool IsSessionReady() { return (int)vecSessionCollaterals.size() >= GetMaxPoolTransactions(); }
+    bool IsSessionReady(const CDarksendSession& session) { return (int)session.vecSessionCollaterals.size() >= GetMaxPoolTransactions(); }
+    /// Find the session a participant joined, NULL if none
+    CDarksendSession* GetSessionByPeer(NodeId nodeId);
+    /// Forget the session and its participants
+    void RemoveSession(int nSessionIDToRemove);
 
     /// If the collateral is valid given by a client
     bool IsCollateralValid(const CTransaction& txCollateral);
     /// Check that all inputs are signed. (Are all inputs signed?)
-    bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
-    /// Are these outputs compatible with other client in the pool?
-    bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxDSOut>& vecTxDSOut);
+    bool IsSignaturesComplete(const CDarksendSession& session);
+    /// Check to make sure given inputs match inputs in the session and their scriptSigs are valid, verified in parallel
+    bool IsInputScriptSigsValid(const CDarksendSession& session, const std::vector<CTxIn>& vecTxIn);
+    /// Are these outputs compatible with other client in the session?
+    bool IsOutputsCompatibleWithSessionDenom(const CDarksendSession& session, const std::vector<CTxDSOut>& vecTxDSOut);
 
     bool IsDenomSkipped(CAmount nDenomValue) {
         return std::find(vecDenominationsSkipped.begin(), vecDenominationsSkipped.end(), nDenomValue) != vecDenominationsSkipped.end();
@@ -404,13 +443,13 @@ private:
     bool SignFinalTransaction(const CTransaction& finalTransactionNew, CNode* pnode);
 
     /// Relay mixing Messages
-    void RelayFinalTransaction(const CTransaction& txFinal);
+    void RelayFinalTransaction(const CDarksendSession& session, const CTransaction& txFinal);
     void RelaySignaturesAnon(std::vector<CTxIn>& vin);
     void RelayInAnon(std::vector<CTxIn>& vin, std::vector<CTxOut>& vout);
     void RelayIn(const CDarkSendEntry& entry);
-    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID);
-    void RelayStatus(PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID = MSG_NOERR);
-    void RelayCompletedTransaction(PoolMessage nMessageID);
+    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, const CDarksendSession* psession = NULL);
+    void RelayStatus(const CDarksendSession& session, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID = MSG_NOERR);
+    void RelayCompletedTransaction(const CDarksendSession& session, PoolMessage nMessageID);
 
     void SetNull();
 
@@ -465,6 +504,7 @@ public:
     std::string GetStatus();
 
     int GetEntriesCount() const { return vecEntries.size(); }
+    int GetSessionsCount() const { LOCK(cs_darksend); return mapSessions.size(); }
 
     /// Passively run mixing in the background according to the configuration in settings
     bool DoAutomaticDenominating(bool fDryRun=false);
@@ -479,5 +519,7 @@ public:
 };
 
 void ThreadCheckDarkSendPool();
+/** Run an instance of the mixing signature verification thread */
+void ThreadDarksendSigCheck();
 
 #endif
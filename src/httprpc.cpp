@@ -20,6 +20,22 @@
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
+/** Calls cheap enough for the priority lane of the HTTP work queue */
+static const char* LIGHTWEIGHT_RPC_METHODS[] = {
+    "getbestblockhash",
+    "getblockcount",
+    "getconnectioncount",
+    "getdifficulty",
+    "gethttpqueueinfo",
+    "getinfo",
+    "getmempoolinfo",
+    "getnetworkinfo",
+    "ping",
+};
+
+/** Requests with a larger body are never lightweight, e.g. batches */
+static const size_t MAX_LIGHTWEIGHT_REQUEST_SIZE = 512;
+
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wellet.
  */
@@ -180,10 +196,30 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Stream the reply, so that large results are sent while they are
+            // written and never held as a whole. Same layout as JSONRPCReply.
+            req->WriteHeader("Content-Type", "application/json");
+            HTTPReplyStreamWriter writer(req);
+            writer.beginObject();
+            writer.key("result");
+            try {
+                tableRPC.executeStream(jreq.strMethod, jreq.params, writer);
+            } catch (...) {
+                if (!req->DiscardReplyChunks()) {
+                    // Part of the result is sent already with status 200,
+                    // close the connection so the client sees it is incomplete
+                    LogPrintf("ThreadRPCServer method=%s failed after its reply was started\n", SanitizeString(jreq.strMethod));
+                    req->AbortReply();
+                    return false;
+                }
+                throw;
+            }
+            writer.pushKV("error", NullUniValue);
+            writer.pushKV("id", jreq.id);
+            writer.endObject();
+            writer.flush();
+            req->WriteReply(HTTP_OK, "\n");
+            return true;
 
         // array of requests
         } else if (valRequest.isArray())
@@ -203,6 +239,30 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Send single lightweight calls to the priority lane. The body of a request
+ * is only looked at once its credentials are valid. */
+static bool HTTPReq_JSONRPCPriority(HTTPRequest* req)
+{
+    if (req->GetRequestMethod() != HTTPRequest::POST)
+        return false;
+    std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
+    if (!authHeader.first || !RPCAuthorized(authHeader.second))
+        return false;
+    std::string strBody;
+    if (!req->PeekBody(strBody, MAX_LIGHTWEIGHT_REQUEST_SIZE))
+        return false;
+    UniValue valRequest;
+    if (!valRequest.read(strBody) || !valRequest.isObject())
+        return false;
+    const UniValue& method = find_value(valRequest, "method");
+    if (!method.isStr())
+        return false;
+    for (unsigned int i = 0; i < ARRAYLEN(LIGHTWEIGHT_RPC_METHODS); i++)
+        if (method.get_str() == LIGHTWEIGHT_RPC_METHODS[i])
+            return true;
+    return false;
+}
+
 static bool InitRPCAuthentication()
 {
     if (mapArgs["-rpcpassword"] == "")
@@ -227,7 +287,7 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPCPriority);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
@@ -41,41 +41,147 @@
 /** Maximum size of http request (request line + headers) */
 static const size_t MAX_HEADERS_SIZE = 8192;
 
+/** Reply bodies from WriteReplyChunk are sent chunked once they reach this size */
+static const size_t HTTP_CHUNKED_REPLY_MIN_SIZE = 64 * 1024;
+
+/** WriteReplyChunk waits while more than this much of a reply is not sent to the client yet */
+static const size_t HTTP_REPLY_MAX_UNSENT = 1024 * 1024;
+
 /** HTTP request work item */
 class HTTPWorkItem : public HTTPClosure
 {
 public:
-    HTTPWorkItem(HTTPRequest* req, const std::string &path, const HTTPRequestHandler& func):
-        req(req), path(path), func(func)
+    HTTPWorkItem(HTTPRequest* req, const std::string &path, const HTTPRequestHandler& func, const HTTPRequestPriority& priority):
+        req(req), path(path), func(func), priority(priority)
     {
     }
     void operator()()
     {
         func(req.get(), path);
     }
+    /** Whether the lane of the request has to be decided by the work queue */
+    bool NeedsTriage() const
+    {
+        return !priority.empty();
+    }
+    bool IsPriority()
+    {
+        return priority(req.get());
+    }
+    /** Answer the request if its lane is full */
+    void Reject()
+    {
+        req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
+    }
 
     boost::scoped_ptr<HTTPRequest> req;
 
 private:
     std::string path;
     HTTPRequestHandler func;
+    HTTPRequestPriority priority;
 };
 
-/** Simple work queue for distributing work over multiple threads.
+/** Bucket of a depth or wait time histogram: 0, 1, 2-3, 4-7, ... */
+static int HistogramBucket(uint64_t n)
+{
+    int nBucket = 0;
+    while (n && nBucket < HTTPWorkQueueStats::HISTOGRAM_BUCKETS - 1) {
+        n >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+/** Work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
+ *
+ * Normal work items are spread over one deque per worker thread. A worker
+ * takes items from the front of its own deque and, when that is empty,
+ * steals the oldest item of the others. Every deque has its own lock, the
+ * queue lock only guards the counters, so that workers do not contend while
+ * moving items.
+ *
+ * Items whose lane is decided by the request (see HTTPRequestPriority) are
+ * first triaged off the event loop thread. With more than one worker, the
+ * first one is reserved for triage and the priority lane, which the other
+ * workers serve before any normal item, so that priority items never wait
+ * for a normal item to finish.
+ *
+ * The -rpcworkqueue depth is split between the lanes, a quarter of it is
+ * kept for the priority lane.
  */
 template <typename WorkItem>
 class WorkQueue
 {
 private:
-    /** Mutex protects entire object */
+    struct Entry
+    {
+        WorkItem* item;
+        int64_t nTimeQueued;
+    };
+
+    /** Deque with its own lock */
+    class EntryDeque
+    {
+    public:
+        void Push(const Entry& entry)
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            entries.push_back(entry);
+        }
+        bool Pop(Entry& entry)
+        {
+            boost::lock_guard<boost::mutex> lock(cs);
+            if (entries.empty())
+                return false;
+            entry = entries.front();
+            entries.pop_front();
+            return true;
+        }
+        /** Precondition: no other thread uses the deque */
+        void Clear()
+        {
+            BOOST_FOREACH(const Entry& entry, entries)
+                delete entry.item;
+            entries.clear();
+        }
+
+    private:
+        boost::mutex cs;
+        std::deque<Entry> entries;
+    };
+
+    /** Where a pushed item waits for a worker */
+    enum Stage
+    {
+        STAGE_PRIORITY,
+        STAGE_TRIAGE,
+        STAGE_NORMAL,
+        STAGE_COUNT
+    };
+
+    /** Mutex protects the counters below, the deques have their own */
     CWaitableCriticalSection cs;
     CConditionVariable cond;
+    /** Wakes the reserved worker */
+    CConditionVariable condReserved;
     /* XXX in C++11 we can use std::unique_ptr here and avoid manual cleanup */
-    std::deque<WorkItem*> queue;
+    std::vector<EntryDeque*> workerQueues;
+    EntryDeque priorityQueue;
+    EntryDeque triageQueue;
+    /** Queued items per lane, and items waiting for triage */
+    size_t nPending[HTTP_LANE_COUNT];
+    size_t nTriage;
+    /** Pushed items per stage that no worker has claimed yet */
+    size_t nReady[STAGE_COUNT];
+    size_t maxDepth[HTTP_LANE_COUNT];
+    unsigned int nNextWorker;
     bool running;
-    size_t maxDepth;
     int numThreads;
+    /** Whether worker 0 is reserved for triage and the priority lane */
+    const bool fReserveWorker;
+    HTTPWorkQueueStats stats;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
@@ -95,50 +201,170 @@ private:
         }
     };
 
+    /** Count an item into lane and pick its deque. Caller holds cs. */
+    EntryDeque& Admit(int lane)
+    {
+        HTTPWorkQueueStats::Lane& laneStats = stats.lanes[lane];
+        laneStats.vDepthHistogram[HistogramBucket(nPending[lane])]++;
+        nPending[lane]++;
+        laneStats.nQueued++;
+        laneStats.nMaxDepth = std::max(laneStats.nMaxDepth, nPending[lane]);
+        return lane == HTTP_LANE_PRIORITY ? priorityQueue : *workerQueues[nNextWorker++ % workerQueues.size()];
+    }
+
+    /** Hand an admitted item to the workers that serve stage */
+    void Push(EntryDeque& q, const Entry& entry, int stage)
+    {
+        q.Push(entry);
+        boost::unique_lock<boost::mutex> lock(cs);
+        nReady[stage]++;
+        if (fReserveWorker && stage != STAGE_NORMAL)
+            condReserved.notify_one();
+        if (!fReserveWorker || stage != STAGE_TRIAGE)
+            cond.notify_one();
+    }
+
+    /** Claim a pushed item for a worker, STAGE_COUNT if there is none. Caller holds cs. */
+    int Claim(bool fReserved)
+    {
+        int stage;
+        if (nReady[STAGE_PRIORITY])
+            stage = STAGE_PRIORITY;
+        else if (nReady[STAGE_TRIAGE] && (fReserved || !fReserveWorker))
+            stage = STAGE_TRIAGE;
+        else if (nReady[STAGE_NORMAL] && !fReserved)
+            stage = STAGE_NORMAL;
+        else
+            return STAGE_COUNT;
+        nReady[stage]--;
+        return stage;
+    }
+
+    /** Take a claimed normal item, from the worker's own deque or else stolen */
+    void TakeNormal(size_t nOwn, Entry& entry)
+    {
+        // The claimed item is in some deque, but it may have been pushed to
+        // one that was looked at already
+        for (size_t i = 0; !workerQueues[(nOwn + i) % workerQueues.size()]->Pop(entry); i++) {}
+    }
+
+    /** Queue a triaged item in its lane, or reject it if the lane is full */
+    void Triage(const Entry& entry)
+    {
+        int lane = entry.item->IsPriority() ? HTTP_LANE_PRIORITY : HTTP_LANE_NORMAL;
+        EntryDeque* q = NULL;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            nTriage--;
+            if (nPending[lane] < maxDepth[lane])
+                q = &Admit(lane);
+            else
+                stats.lanes[lane].nRejected++;
+        }
+        if (q) {
+            Push(*q, entry, lane == HTTP_LANE_PRIORITY ? STAGE_PRIORITY : STAGE_NORMAL);
+        } else {
+            entry.item->Reject();
+            delete entry.item;
+        }
+    }
+
 public:
-    WorkQueue(size_t maxDepth) : running(true),
-                                 maxDepth(maxDepth),
-                                 numThreads(0)
+    WorkQueue(size_t nDepth, int nWorkers) : nTriage(0),
+                                             nNextWorker(0),
+                                             running(true),
+                                             numThreads(0),
+                                             fReserveWorker(nWorkers > 1)
     {
+        for (int i = fReserveWorker ? 1 : 0; i < nWorkers; i++)
+            workerQueues.push_back(new EntryDeque());
+        for (int lane = 0; lane < HTTP_LANE_COUNT; lane++)
+            nPending[lane] = 0;
+        for (int stage = 0; stage < STAGE_COUNT; stage++)
+            nReady[stage] = 0;
+        maxDepth[HTTP_LANE_PRIORITY] = std::max(nDepth / 4, (size_t)1);
+        maxDepth[HTTP_LANE_NORMAL] = std::max(nDepth - maxDepth[HTTP_LANE_PRIORITY], (size_t)1);
+        stats.nWorkers = nWorkers;
+        for (int lane = 0; lane < HTTP_LANE_COUNT; lane++)
+            stats.lanes[lane].nLimit = maxDepth[lane];
     }
     /*( Precondition: worker threads have all stopped
      * (call WaitExit)
      */
     ~WorkQueue()
     {
-        while (!queue.empty()) {
-            delete queue.front();
-            queue.pop_front();
+        priorityQueue.Clear();
+        triageQueue.Clear();
+        BOOST_FOREACH(EntryDeque* q, workerQueues) {
+            q->Clear();
+            delete q;
         }
     }
     /** Enqueue a work item */
     bool Enqueue(WorkItem* item)
     {
-        boost::unique_lock<boost::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
+        Entry entry;
+        entry.item = item;
+        entry.nTimeQueued = GetTimeMicros();
+        bool fTriage = item->NeedsTriage();
+
+        EntryDeque* q;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            // Items waiting for triage can go to either lane, so they are
+            // limited by the whole depth. Their rejections count as normal.
+            size_t nQueued = nPending[HTTP_LANE_NORMAL] + nPending[HTTP_LANE_PRIORITY] + nTriage;
+            bool fFull = fTriage ? nQueued >= maxDepth[HTTP_LANE_NORMAL] + maxDepth[HTTP_LANE_PRIORITY]
+                                 : nPending[HTTP_LANE_NORMAL] >= maxDepth[HTTP_LANE_NORMAL];
+            if (fFull) {
+                stats.lanes[HTTP_LANE_NORMAL].nRejected++;
+                return false;
+            }
+            if (fTriage) {
+                nTriage++;
+                q = &triageQueue;
+            } else {
+                q = &Admit(HTTP_LANE_NORMAL);
+            }
         }
-        queue.push_back(item);
-        cond.notify_one();
+        Push(*q, entry, fTriage ? STAGE_TRIAGE : STAGE_NORMAL);
         return true;
     }
     /** Thread function */
-    void Run()
+    void Run(int nWorker)
     {
         ThreadCounter count(*this);
+        const bool fReserved = fReserveWorker && nWorker == 0;
+        const size_t nOwn = fReserveWorker ? nWorker - 1 : nWorker;
         while (true) {
-            WorkItem* i = 0;
+            int stage = STAGE_COUNT;
             {
                 boost::unique_lock<boost::mutex> lock(cs);
-                while (running && queue.empty())
-                    cond.wait(lock);
+                while (running && (stage = Claim(fReserved)) == STAGE_COUNT)
+                    (fReserved ? condReserved : cond).wait(lock);
                 if (!running)
                     break;
-                i = queue.front();
-                queue.pop_front();
             }
-            (*i)();
-            delete i;
+            // Every pushed item is claimed once, so the priority and triage
+            // deques cannot be empty here
+            Entry entry;
+            if (stage == STAGE_NORMAL)
+                TakeNormal(nOwn, entry);
+            else if (!(stage == STAGE_PRIORITY ? priorityQueue : triageQueue).Pop(entry))
+                assert(false);
+            if (stage == STAGE_TRIAGE) {
+                Triage(entry);
+                continue;
+            }
+            int lane = stage == STAGE_PRIORITY ? HTTP_LANE_PRIORITY : HTTP_LANE_NORMAL;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                nPending[lane]--;
+                int64_t nWaitMillis = (GetTimeMicros() - entry.nTimeQueued) / 1000;
+                stats.lanes[lane].vWaitHistogram[HistogramBucket(std::max(nWaitMillis, (int64_t)0))]++;
+            }
+            (*entry.item)();
+            delete entry.item;
         }
     }
     /** Interrupt and exit loops */
@@ -147,6 +373,7 @@ public:
         boost::unique_lock<boost::mutex> lock(cs);
         running = false;
         cond.notify_all();
+        condReserved.notify_all();
     }
     /** Wait for worker threads to exit */
     void WaitExit()
@@ -161,20 +388,32 @@ public:
     size_t Depth()
     {
         boost::unique_lock<boost::mutex> lock(cs);
-        return queue.size();
+        return nPending[HTTP_LANE_NORMAL] + nPending[HTTP_LANE_PRIORITY] + nTriage;
+    }
+
+    /** Return a snapshot of the counters */
+    HTTPWorkQueueStats GetStats()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        HTTPWorkQueueStats ret = stats;
+        for (int lane = 0; lane < HTTP_LANE_COUNT; lane++)
+            ret.lanes[lane].nDepth = nPending[lane];
+        ret.nTriage = nTriage;
+        return ret;
     }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler):
-        prefix(prefix), exactMatch(exactMatch), handler(handler)
+    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler, HTTPRequestPriority priority):
+        prefix(prefix), exactMatch(exactMatch), handler(handler), priority(priority)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPRequestPriority priority;
 };
 
 /** HTTP module state */
@@ -186,7 +425,7 @@ struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = 0;
+static WorkQueue<HTTPWorkItem>* workQueue = 0;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -289,7 +528,7 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
-        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(hreq.release(), path, i->handler));
+        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(hreq.release(), path, i->handler, i->priority));
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
@@ -357,10 +596,10 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(WorkQueue<HTTPWorkItem>* queue, int nWorker)
 {
     RenameThread("dash-httpworker");
-    queue->Run();
+    queue->Run(nWorker);
 }
 
 /** libevent event log callback */
@@ -435,9 +674,10 @@ bool InitHTTPServer()
 
     LogPrint("http", "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    LogPrintf("HTTP: creating work queue of depth %d for %d worker threads\n", workQueueDepth, rpcThreads);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new WorkQueue<HTTPWorkItem>(workQueueDepth, rpcThreads);
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -453,7 +693,7 @@ bool StartHTTPServer()
     threadHTTP = boost::thread(boost::bind(&ThreadHTTP, eventBase, eventHTTP));
 
     for (int i = 0; i < rpcThreads; i++)
-        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueue));
+        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueue, i));
     return true;
 }
 
@@ -547,7 +787,8 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
@@ -555,7 +796,10 @@ HTTPRequest::~HTTPRequest()
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
-        WriteReply(HTTP_INTERNAL, "Unhandled request");
+        if (replyStarted)
+            AbortReply();
+        else
+            WriteReply(HTTP_INTERNAL, "Unhandled request");
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -591,6 +835,21 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+bool HTTPRequest::PeekBody(std::string& body, size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return false;
+    size_t size = evbuffer_get_length(buf);
+    if (size == 0 || size > nMaxSize)
+        return false;
+    const char* data = (const char*)evbuffer_pullup(buf, size);
+    if (!data)
+        return false;
+    body.assign(data, size);
+    return true;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -598,6 +857,89 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/**
+ * Write progress of a chunked reply. nUnsent counts the bytes a worker wrote
+ * that have not reached the socket yet, fClosed is set once the client went
+ * away. nQueued is only used by the main http thread: the bytes handed to
+ * evhttp since the output buffer of the connection last ran empty.
+ */
+struct HTTPReplyFlow
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    size_t nUnsent;
+    bool fClosed;
+    size_t nQueued;
+
+    HTTPReplyFlow() : nUnsent(0), fClosed(false), nQueued(0) {}
+
+    void Sent(size_t nBytes, bool fClosedIn)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nUnsent -= nBytes;
+        fClosed |= fClosedIn;
+        cond.notify_all();
+    }
+};
+
+/** evhttp emptied the output buffer of the connection, everything queued so far is sent */
+static void http_reply_sent(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyFlow* flow = (HTTPReplyFlow*)arg;
+    size_t nQueued = flow->nQueued;
+    flow->nQueued = 0;
+    flow->Sent(nQueued, false);
+}
+
+/** Chunked reply steps, run in the main http thread. They take ownership of chunk. */
+static void http_reply_chunk(struct evhttp_request* req, struct evbuffer* chunk, boost::shared_ptr<HTTPReplyFlow> flow)
+{
+    size_t nSize = evbuffer_get_length(chunk);
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    if (nSize)
+        evhttp_send_reply_chunk_with_cb(req, chunk, http_reply_sent, flow.get());
+    // evhttp leaves the chunk alone if the client went away or the reply has no body
+    if (nSize && evbuffer_get_length(chunk) == 0)
+        flow->nQueued += nSize;
+    else
+        flow->Sent(nSize, evhttp_request_get_connection(req) == NULL);
+#else
+    // No callback once data is sent, so slow clients are not waited for
+    if (nSize)
+        evhttp_send_reply_chunk(req, chunk);
+    flow->Sent(nSize, evhttp_request_get_connection(req) == NULL);
+#endif
+    evbuffer_free(chunk);
+}
+
+static void http_reply_start(struct evhttp_request* req, int nStatus, struct evbuffer* chunk, boost::shared_ptr<HTTPReplyFlow> flow)
+{
+    evhttp_send_reply_start(req, nStatus, NULL);
+    http_reply_chunk(req, chunk, flow);
+}
+
+static void http_reply_end(struct evhttp_request* req, struct evbuffer* chunk, boost::shared_ptr<HTTPReplyFlow> flow)
+{
+    http_reply_chunk(req, chunk, flow);
+    evhttp_send_reply_end(req);
+}
+
+/** A worker waited long for a client, check that it is still there */
+static void http_reply_probe(struct evhttp_request* req, boost::shared_ptr<HTTPReplyFlow> flow)
+{
+    if (evhttp_request_get_connection(req) == NULL)
+        flow->Sent(0, true);
+}
+
+static void http_reply_abort(struct evhttp_request* req)
+{
+    struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+    if (evcon)
+        evhttp_connection_free(evcon); // frees req as well
+    else
+        evhttp_request_free(req); // the client went away, evhttp left req to us
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -606,17 +948,95 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
     assert(!replySent && req);
-    // Send event to main http thread to send reply message
+    HTTPEvent* ev;
+    if (replyStarted) {
+        struct evbuffer* chunk = evbuffer_new();
+        assert(chunk);
+        evbuffer_add(chunk, strReply.data(), strReply.size());
+        {
+            boost::unique_lock<boost::mutex> lock(replyFlow->mutex);
+            replyFlow->nUnsent += strReply.size();
+        }
+        ev = new HTTPEvent(eventBase, true, boost::bind(http_reply_end, req, chunk, replyFlow));
+    } else {
+        // Send event to main http thread to send reply message
+        struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+        assert(evb);
+        evbuffer_add(evb, strReply.data(), strReply.size());
+        ev = new HTTPEvent(eventBase, true,
+            boost::bind(evhttp_send_reply, req, nStatus, (const char*)NULL, (struct evbuffer *)NULL));
+    }
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::WriteReplyChunk(const char* data, size_t len)
+{
+    assert(!replySent && req);
+    if (replyStarted) {
+        {
+            boost::unique_lock<boost::mutex> lock(replyFlow->mutex);
+            while (replyFlow->nUnsent > HTTP_REPLY_MAX_UNSENT && !replyFlow->fClosed) {
+                if (!replyFlow->cond.timed_wait(lock, boost::posix_time::seconds(1))) {
+                    // evhttp drops a client that does not read for -rpcservertimeout
+                    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_reply_probe, req, replyFlow));
+                    ev->trigger(0);
+                }
+            }
+            if (replyFlow->fClosed)
+                return;
+            replyFlow->nUnsent += len;
+        }
+        struct evbuffer* chunk = evbuffer_new();
+        assert(chunk);
+        evbuffer_add(chunk, data, len);
+        HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_reply_chunk, req, chunk, replyFlow));
+        ev->trigger(0);
+        return;
+    }
+
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
-    evbuffer_add(evb, strReply.data(), strReply.size());
-    HTTPEvent* ev = new HTTPEvent(eventBase, true,
-        boost::bind(evhttp_send_reply, req, nStatus, (const char*)NULL, (struct evbuffer *)NULL));
+    evbuffer_add(evb, data, len);
+    if (evbuffer_get_length(evb) < HTTP_CHUNKED_REPLY_MIN_SIZE)
+        return;
+
+    // Start the reply. evhttp would send the output buffer unframed with the
+    // headers, so its contents go out as the first chunk instead.
+    struct evbuffer* chunk = evbuffer_new();
+    assert(chunk);
+    evbuffer_add_buffer(chunk, evb);
+    replyFlow.reset(new HTTPReplyFlow());
+    replyFlow->nUnsent = evbuffer_get_length(chunk);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_reply_start, req, (int)HTTP_OK, chunk, replyFlow));
+    ev->trigger(0);
+    replyStarted = true;
+}
+
+void HTTPRequest::AbortReply()
+{
+    assert(!replySent && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_reply_abort, req));
     ev->trigger(0);
     replySent = true;
     req = 0; // transferred back to main thread
 }
 
+bool HTTPRequest::DiscardReplyChunks()
+{
+    assert(!replySent && req);
+    if (replyStarted)
+        return false;
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    evbuffer_drain(evb, evbuffer_get_length(evb));
+    struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
+    assert(headers);
+    evhttp_clear_headers(headers);
+    return true;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -657,10 +1077,18 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPRequestPriority &priority)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, priority));
+}
+
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats)
+{
+    if (!workQueue)
+        return false;
+    stats = workQueue->GetStats();
+    return true;
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
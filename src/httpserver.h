@@ -9,14 +9,18 @@
 #include <stdint.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 
+#include <univalue.h>
+
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
 struct evhttp_request;
 struct event_base;
+struct HTTPReplyFlow;
 class CService;
 class HTTPRequest;
 
@@ -36,14 +40,64 @@ void StopHTTPServer();
 
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<void(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Decides whether a request goes to the priority lane of the work queue.
+ * Runs on a worker thread before the request is queued in its lane. One
+ * worker triages all requests, so it has to be cheap.
+ */
+typedef boost::function<bool(HTTPRequest* req)> HTTPRequestPriority;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPRequestPriority &priority = HTTPRequestPriority());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+enum HTTPWorkQueueLane
+{
+    HTTP_LANE_NORMAL,
+    HTTP_LANE_PRIORITY,
+    HTTP_LANE_COUNT
+};
+
+/** Counters of the HTTP work queue */
+struct HTTPWorkQueueStats
+{
+    /** Histogram buckets hold 0, 1, 2-3, 4-7, ... with the last one open-ended */
+    static const int HISTOGRAM_BUCKETS = 16;
+
+    struct Lane
+    {
+        size_t nDepth;
+        //! Share of -rpcworkqueue
+        size_t nLimit;
+        size_t nMaxDepth;
+        uint64_t nQueued;
+        uint64_t nRejected;
+        //! Queue depth seen by each queued item
+        uint64_t vDepthHistogram[HISTOGRAM_BUCKETS];
+        //! Milliseconds each item waited for a worker
+        uint64_t vWaitHistogram[HISTOGRAM_BUCKETS];
+
+        Lane() : nDepth(0), nLimit(0), nMaxDepth(0), nQueued(0), nRejected(0)
+        {
+            for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+                vDepthHistogram[i] = vWaitHistogram[i] = 0;
+        }
+    };
+
+    int nWorkers;
+    //! Requests waiting for their lane to be decided
+    size_t nTriage;
+    Lane lanes[HTTP_LANE_COUNT];
+
+    HTTPWorkQueueStats() : nWorkers(0), nTriage(0) {}
+};
+
+/** Get the counters of the HTTP work queue. Returns false if there is none. */
+bool GetHTTPWorkQueueStats(HTTPWorkQueueStats& stats);
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -57,6 +111,9 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
+    //! Write progress of a started reply, shared with the event loop
+    boost::shared_ptr<HTTPReplyFlow> replyFlow;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -96,6 +153,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Copy the request body without consuming it.
+     * Returns false if it is empty or larger than nMaxSize.
+     */
+    bool PeekBody(std::string& body, size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -107,11 +170,58 @@ public:
      * Write HTTP reply.
      * nStatus is the HTTP status code to send.
      * strReply is the body of the reply. Keep it empty to send a standard message.
+     * If WriteReplyChunk already started the reply, strReply is sent as its
+     * last chunk and nStatus is ignored.
      *
      * @note Can be called only once. As this will give the request back to the
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Append data to the reply body. Small bodies are held back and sent by
+     * WriteReply. Once enough data has been written, the reply is started
+     * with status HTTP_OK and chunked transfer encoding, and from then on
+     * every call sends its data as a chunk. While the client lags behind by
+     * more than a megabyte, this waits for it to catch up.
+     * If the client went away, the data is dropped.
+     *
+     * @note Write all headers before the first call.
+     */
+    void WriteReplyChunk(const char* data, size_t len);
+
+    /**
+     * End a started reply by closing the connection, so that the client
+     * sees an incomplete reply instead of a truncated one.
+     *
+     * @note Same as WriteReply, do not call any other HTTPRequest methods after calling this.
+     */
+    void AbortReply();
+
+    /**
+     * Drop the headers and the reply body written by WriteReplyChunk so far,
+     * e.g. to send an error reply instead. Returns false if the reply was already started,
+     * in which case only WriteReply or AbortReply can be called to end it.
+     */
+    bool DiscardReplyChunks();
+};
+
+/** Streams JSON into the reply body of an HTTP request.
+ * Call flush() and then WriteReply to send the rest of the reply.
+ */
+class HTTPReplyStreamWriter : public UniValueStreamWriter
+{
+private:
+    HTTPRequest* req;
+
+protected:
+    void flushChunk(const char* data, size_t len)
+    {
+        req->WriteReplyChunk(data, len);
+    }
+
+public:
+    HTTPReplyStreamWriter(HTTPRequest* reqIn) : req(reqIn) {}
 };
 
 /** Event handler closure.
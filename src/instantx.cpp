@@ -119,7 +119,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     CTxLockCandidate& txLockCandidate = itLockCandidate->second;
     Vote(txLockCandidate);
-    ProcessOrphanTxLockVotes();
+    ProcessOrphanTxLockVotes(txHash);
 
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
@@ -175,7 +175,8 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 
         int nLockInputHeight = nPrevoutHeight + 4;
 
-        int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
+        int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
+        int n = mnodeman.GetMasternodeTopRank(activeMasternode.vin, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION, nSignaturesTotal);
 
         if(n == -1) {
             LogPrint("instantsend", "CInstantSend::Vote -- Can't calculate rank for masternode %s\n", activeMasternode.vin.prevout.ToStringShort());
@@ -183,9 +184,8 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
             continue;
         }
 
-        int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
-        if(n > nSignaturesTotal) {
-            LogPrint("instantsend", "CInstantSend::Vote -- Masternode not in the top %d (%d)\n", nSignaturesTotal, n);
+        if(n == 0) {
+            LogPrint("instantsend", "CInstantSend::Vote -- Masternode not in the top %d\n", nSignaturesTotal);
             ++itOutpointLock;
             continue;
         }
@@ -233,6 +233,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
         if(itOutpointLock->second.AddVote(vote)) {
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
+            UpdateLatencyStats(txHash, INSTANTSEND_STAGE_FIRST_VOTE);
 
             if(itVoted == mapVotedOutpoints.end()) {
                 std::set<uint256> setHashes;
@@ -279,7 +280,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) {
         if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            AddOrphanTxLockVote(vote);
             LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
                     txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             bool fReprocess = true;
@@ -359,6 +360,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
         // this should never happen
         return false;
     }
+    UpdateLatencyStats(txHash, INSTANTSEND_STAGE_FIRST_VOTE);
 
     int nSignatures = txLockCandidate.CountVotes();
     int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
@@ -372,7 +374,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     return true;
 }
 
-void CInstantSend::ProcessOrphanTxLockVotes()
+void CInstantSend::ProcessOrphanTxLockVotes(const uint256& txHash)
 {
     LOCK(cs_main);
 #ifdef ENABLE_WALLET
@@ -381,16 +383,45 @@ void CInstantSend::ProcessOrphanTxLockVotes()
 #endif
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(ProcessTxLockVote(NULL, it->second)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+    std::map<uint256, std::set<uint256> >::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx == mapTxLockVotesOrphanByTx.end()) return;
+
+    // copy, processed votes are erased from the index
+    std::set<uint256> setVoteHashes = itByTx->second;
+    BOOST_FOREACH(const uint256& hashVote, setVoteHashes) {
+        std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(hashVote);
+        if(it == mapTxLockVotesOrphan.end()) continue;
+        CTxLockVote vote = it->second;
+        if(ProcessTxLockVote(NULL, vote)) {
+            EraseOrphanTxLockVote(hashVote);
         }
     }
 }
 
+void CInstantSend::AddOrphanTxLockVote(const CTxLockVote& vote)
+{
+    uint256 hashVote = vote.GetHash();
+    mapTxLockVotesOrphan[hashVote] = vote;
+    mapTxLockVotesOrphanByTx[vote.GetTxHash()].insert(hashVote);
+    setTxLockVotesOrphanByTime.insert(std::make_pair(vote.GetTimeCreated(), hashVote));
+}
+
+void CInstantSend::EraseOrphanTxLockVote(const uint256& hashVote)
+{
+    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(hashVote);
+    if(it == mapTxLockVotesOrphan.end()) return;
+
+    std::map<uint256, std::set<uint256> >::iterator itByTx = mapTxLockVotesOrphanByTx.find(it->second.GetTxHash());
+    if(itByTx != mapTxLockVotesOrphanByTx.end()) {
+        itByTx->second.erase(hashVote);
+        if(itByTx->second.empty()) {
+            mapTxLockVotesOrphanByTx.erase(itByTx);
+        }
+    }
+    setTxLockVotesOrphanByTime.erase(std::make_pair(it->second.GetTimeCreated(), hashVote));
+    mapTxLockVotesOrphan.erase(it);
+}
+
 bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 {
     // There could be a situation when we already have quite a lot of votes
@@ -408,16 +439,18 @@ bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, co
 {
     // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
+    std::map<uint256, std::set<uint256> >::iterator itByTx = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itByTx == mapTxLockVotesOrphanByTx.end()) return false;
+
     int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
+    BOOST_FOREACH(const uint256& hashVote, itByTx->second) {
+        std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.find(hashVote);
+        if(it != mapTxLockVotesOrphan.end() && it->second.GetOutpoint() == outpoint) {
             nCountVotes++;
             if(nCountVotes >= COutPointLock::SIGNATURES_REQUIRED) {
                 return true;
             }
         }
-        ++it;
     }
     return false;
 }
@@ -435,6 +468,7 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
     if(txLockCandidate.IsAllOutPointsReady() && !IsLockedInstantSendTransaction(txHash)) {
         // we have enough votes now
         LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
+        UpdateLatencyStats(txHash, INSTANTSEND_STAGE_READY);
         if(ResolveConflicts(txLockCandidate, Params().GetConsensus().nInstantSendKeepLock)) {
             LockTransactionInputs(txLockCandidate);
             UpdateLockedTransaction(txLockCandidate);
@@ -468,6 +502,8 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
     }
 #endif
 
+    UpdateLatencyStats(txHash, INSTANTSEND_STAGE_LOCKED);
+
     GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest);
 
     LogPrint("instantsend", "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
@@ -561,10 +597,7 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate, int
     }
     // Not in block yet, make sure all its inputs are still unspent
     BOOST_FOREACH(const CTxIn& txin, txLockCandidate.txLockRequest.vin) {
-        CCoins coins;
-        if(!pcoinsTip->GetCoins(txin.prevout.hash, coins) ||
-           (unsigned int)txin.prevout.n>=coins.vout.size() ||
-           coins.vout[txin.prevout.n].IsNull()) {
+        if(!pcoinsTip->HaveCoin(txin.prevout)) {
             // Not in UTXO anymore? A conflicting tx was mined while we were waiting for votes.
             // Reprocess tip to make sure tx for this lock is included.
             LogPrintf("CTxLockRequest::ResolveConflicts -- Failed to find UTXO %s - disconnecting tip...\n", txin.prevout.ToStringShort());
@@ -645,17 +678,20 @@ void CInstantSend::CheckAndRemove()
         }
     }
 
-    // remove expired orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(GetTime() - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  masternode=%s\n",
-                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
+    // remove expired orphan votes, oldest first
+    while(!setTxLockVotesOrphanByTime.empty() &&
+            GetTime() - setTxLockVotesOrphanByTime.begin()->first > ORPHAN_VOTE_SECONDS) {
+        uint256 hashVote = setTxLockVotesOrphanByTime.begin()->second;
+        std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.find(hashVote);
+        if(itOrphanVote == mapTxLockVotesOrphan.end()) {
+            // shouldn't happen
+            setTxLockVotesOrphanByTime.erase(setTxLockVotesOrphanByTime.begin());
+            continue;
         }
+        LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  masternode=%s\n",
+                itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
+        mapTxLockVotes.erase(hashVote);
+        EraseOrphanTxLockVote(hashVote);
     }
 
     // remove expired masternode orphan votes (DOS protection)
@@ -858,23 +894,126 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
+    std::map<uint256, std::set<uint256> >::iterator itOrphanVotes = mapTxLockVotesOrphanByTx.find(txHash);
+    if(itOrphanVotes != mapTxLockVotesOrphanByTx.end()) {
+        BOOST_FOREACH(const uint256& hashVote, itOrphanVotes->second) {
             LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+                    txHash.ToString(), nHeightNew, hashVote.ToString());
+            mapTxLockVotes[hashVote].SetConfirmedHeight(nHeightNew);
         }
-        ++itOrphanVote;
     }
 }
 
+void CInstantSend::UpdateLatencyStats(const uint256& txHash, InstantSendLatencyStage nStage)
+{
+    LOCK(cs_instantsend);
+
+    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    if(it == mapTxLockCandidates.end()) return;
+    CTxLockCandidate& txLockCandidate = it->second;
+    if(txLockCandidate.vStageLatencies[nStage] != -1) return;
+
+    int64_t nMicros = std::max(GetTimeMicros() - txLockCandidate.nTimeCreatedMicros, (int64_t)0);
+    txLockCandidate.vStageLatencies[nStage] = nMicros;
+    latencyStats.stages[nStage].Add(nMicros);
+    LogPrint("instantsend", "CInstantSend::UpdateLatencyStats -- txid=%s, stage=%s, %.3fms\n",
+            txHash.ToString(), GetInstantSendLatencyStageName(nStage), nMicros * 0.001);
+}
+
+CInstantSendLatencyStats CInstantSend::GetLatencyStats(bool fReset)
+{
+    LOCK(cs_instantsend);
+    CInstantSendLatencyStats stats = latencyStats;
+    if(fReset) {
+        latencyStats = CInstantSendLatencyStats();
+    }
+    return stats;
+}
+
+bool CInstantSend::GetTxLockLatencies(const uint256& txHash, std::vector<int64_t>& vLatenciesRet)
+{
+    LOCK(cs_instantsend);
+    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    if(it == mapTxLockCandidates.end()) return false;
+    vLatenciesRet = it->second.vStageLatencies;
+    return true;
+}
+
 std::string CInstantSend::ToString()
 {
     LOCK(cs_instantsend);
     return strprintf("Lock Candidates: %llu, Votes %llu", mapTxLockCandidates.size(), mapTxLockVotes.size());
 }
 
+/**
+ * Find the height and value of an outpoint that is already spent. Block files
+ * are only read while the index of recently spent outpoints is still filling up
+ * after startup.
+ */
+static bool GetSpentOutpointInfo(const COutPoint& outpoint, int& nHeightRet, CAmount& nValueRet)
+{
+    bool fComplete;
+    if(GetSpentOutpoint(outpoint, nHeightRet, nValueRet, fComplete)) return true;
+    if(fComplete) return false;
+
+    CTransaction txOutpointCreated;
+    uint256 nHashOutpointConfirmed;
+    if(!GetTransaction(outpoint.hash, txOutpointCreated, Params().GetConsensus(), nHashOutpointConfirmed, true) || nHashOutpointConfirmed == uint256()) {
+        return false;
+    }
+    if(outpoint.n >= txOutpointCreated.vout.size()) {
+        LogPrint("instantsend", "GetSpentOutpointInfo -- Outpoint %s is out of bounds, size() = %lld\n",
+                outpoint.ToStringShort(), txOutpointCreated.vout.size());
+        return false;
+    }
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(nHashOutpointConfirmed);
+    if(mi == mapBlockIndex.end() || !mi->second) {
+        // not on this chain?
+        LogPrint("instantsend", "GetSpentOutpointInfo -- Failed to find block %s for outpoint %s\n",
+                nHashOutpointConfirmed.ToString(), outpoint.ToStringShort());
+        return false;
+    }
+    nHeightRet = mi->second->nHeight;
+    nValueRet = txOutpointCreated.vout[outpoint.n].nValue;
+    return true;
+}
+
+const char* GetInstantSendLatencyStageName(int nStage)
+{
+    switch(nStage) {
+        case INSTANTSEND_STAGE_FIRST_VOTE:  return "first_vote";
+        case INSTANTSEND_STAGE_READY:       return "ready";
+        case INSTANTSEND_STAGE_LOCKED:      return "locked";
+        default:                            return "unknown";
+    }
+}
+
+void CInstantSendLatencyStats::Stage::Add(int64_t nMicros)
+{
+    nCount++;
+    nTotalMicros += nMicros;
+    nMaxMicros = std::max(nMaxMicros, nMicros);
+
+    int nBucket = 0;
+    for(int64_t nMillis = nMicros / 1000; nMillis > 0 && nBucket < HISTOGRAM_BUCKETS - 1; nMillis >>= 1) {
+        nBucket++;
+    }
+    vHistogram[nBucket]++;
+}
+
+int64_t CInstantSendLatencyStats::Stage::GetPercentileMillis(double dPercentile) const
+{
+    if(nCount == 0) return 0;
+    uint64_t nTarget = std::max((uint64_t)1, (uint64_t)(dPercentile * nCount + 0.5));
+    uint64_t nSeen = 0;
+    for(int i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+        nSeen += vHistogram[i];
+        if(nSeen >= nTarget) return (int64_t)1 << i;
+    }
+    return nMaxMicros / 1000;
+}
+
 //
 // CTxLockRequest
 //
@@ -908,40 +1047,22 @@ bool CTxLockRequest::IsValid(bool fRequireUnspent) const
 
     BOOST_FOREACH(const CTxIn& txin, vin) {
 
-        CCoins coins;
+        Coin coin;
         int nPrevoutHeight = 0;
         CAmount nValue = 0;
 
-        if(!pcoinsTip->GetCoins(txin.prevout.hash, coins) ||
-           (unsigned int)txin.prevout.n>=coins.vout.size() ||
-           coins.vout[txin.prevout.n].IsNull()) {
+        if(!pcoinsTip->GetCoin(txin.prevout, coin)) {
             LogPrint("instantsend", "CTxLockRequest::IsValid -- Failed to find UTXO %s\n", txin.prevout.ToStringShort());
             // Normally above sould be enough, but in case we are reprocessing this because of
             // a lot of legit orphan votes we should also check already spent outpoints.
             if(fRequireUnspent) return false;
-            CTransaction txOutpointCreated;
-            uint256 nHashOutpointConfirmed;
-            if(!GetTransaction(txin.prevout.hash, txOutpointCreated, Params().GetConsensus(), nHashOutpointConfirmed, true) || nHashOutpointConfirmed == uint256()) {
+            if(!GetSpentOutpointInfo(txin.prevout, nPrevoutHeight, nValue)) {
                 LogPrint("instantsend", "CTxLockRequest::IsValid -- Failed to find outpoint %s\n", txin.prevout.ToStringShort());
                 return false;
             }
-            if(txin.prevout.n >= txOutpointCreated.vout.size()) {
-                LogPrint("instantsend", "CTxLockRequest::IsValid -- Outpoint %s is out of bounds, size() = %lld\n",
-                        txin.prevout.ToStringShort(), txOutpointCreated.vout.size());
-                return false;
-            }
-            BlockMap::iterator mi = mapBlockIndex.find(nHashOutpointConfirmed);
-            if(mi == mapBlockIndex.end() || !mi->second) {
-                // shouldn't happen
-                LogPrint("instantsend", "CTxLockRequest::IsValid -- Failed to find block %s for outpoint %s\n",
-                        nHashOutpointConfirmed.ToString(), txin.prevout.ToStringShort());
-                return false;
-            }
-            nPrevoutHeight = mi->second->nHeight;
-            nValue = txOutpointCreated.vout[txin.prevout.n].nValue;
         } else {
-            nPrevoutHeight = coins.nHeight;
-            nValue = coins.vout[txin.prevout.n].nValue;
+            nPrevoutHeight = coin.nHeight;
+            nValue = coin.out.nValue;
         }
 
         int nTxAge = chainActive.Height() - nPrevoutHeight + 1;
@@ -1003,39 +1124,30 @@ bool CTxLockVote::IsValid(CNode* pnode) const
         LogPrint("instantsend", "CTxLockVote::IsValid -- Failed to find UTXO %s\n", outpoint.ToStringShort());
         // Validating utxo set is not enough, votes can arrive after outpoint was already spent,
         // if lock request was mined. We should process them too to count them later if they are legit.
-        CTransaction txOutpointCreated;
-        uint256 nHashOutpointConfirmed;
-        if(!GetTransaction(outpoint.hash, txOutpointCreated, Params().GetConsensus(), nHashOutpointConfirmed, true) || nHashOutpointConfirmed == uint256()) {
+        CAmount nValueUnused;
+        if(!GetSpentOutpointInfo(outpoint, nPrevoutHeight, nValueUnused)) {
             LogPrint("instantsend", "CTxLockVote::IsValid -- Failed to find outpoint %s\n", outpoint.ToStringShort());
             return false;
         }
-        LOCK(cs_main);
-        BlockMap::iterator mi = mapBlockIndex.find(nHashOutpointConfirmed);
-        if(mi == mapBlockIndex.end() || !mi->second) {
-            // not on this chain?
-            LogPrint("instantsend", "CTxLockVote::IsValid -- Failed to find block %s for outpoint %s\n", nHashOutpointConfirmed.ToString(), outpoint.ToStringShort());
-            return false;
-        }
-        nPrevoutHeight = mi->second->nHeight;
     }
 
     int nLockInputHeight = nPrevoutHeight + 4;
 
-    int n = mnodeman.GetMasternodeRank(CTxIn(outpointMasternode), nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
+    int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
+    int n = mnodeman.GetMasternodeTopRank(CTxIn(outpointMasternode), nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION, nSignaturesTotal);
 
     if(n == -1) {
-        //can be caused by past versions trying to vote with an invalid protocol
         LogPrint("instantsend", "CTxLockVote::IsValid -- Can't calculate rank for masternode %s\n", outpointMasternode.ToStringShort());
         return false;
     }
-    LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s, rank=%d\n", outpointMasternode.ToStringShort(), n);
 
-    int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
-    if(n > nSignaturesTotal) {
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s is not in the top %d (%d), vote hash=%s\n",
-                outpointMasternode.ToStringShort(), nSignaturesTotal, n, GetHash().ToString());
+    if(n == 0) {
+        //can be caused by past versions trying to vote with an invalid protocol
+        LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s is not in the top %d, vote hash=%s\n",
+                outpointMasternode.ToStringShort(), nSignaturesTotal, GetHash().ToString());
         return false;
     }
+    LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s, rank=%d\n", outpointMasternode.ToStringShort(), n);
 
     if(!CheckSignature()) {
         LogPrintf("CTxLockVote::IsValid -- Signature invalid\n");
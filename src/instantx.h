@@ -33,6 +33,47 @@ extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
+/** Stages of a transaction lock, timed from the arrival of its lock request */
+enum InstantSendLatencyStage
+{
+    INSTANTSEND_STAGE_FIRST_VOTE,   // first vote was added to the lock candidate
+    INSTANTSEND_STAGE_READY,        // all outpoints got enough votes
+    INSTANTSEND_STAGE_LOCKED,       // wallet and external listeners were notified
+    INSTANTSEND_STAGE_COUNT
+};
+
+const char* GetInstantSendLatencyStageName(int nStage);
+
+/** Latency histograms of transaction locks */
+struct CInstantSendLatencyStats
+{
+    /** Histogram buckets hold <1ms, 1ms, 2-3ms, 4-7ms, ... with the last one open-ended */
+    static const int HISTOGRAM_BUCKETS = 20;
+
+    struct Stage
+    {
+        uint64_t nCount;
+        int64_t nTotalMicros;
+        int64_t nMaxMicros;
+        uint64_t vHistogram[HISTOGRAM_BUCKETS];
+
+        Stage() : nCount(0), nTotalMicros(0), nMaxMicros(0)
+        {
+            for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+                vHistogram[i] = 0;
+        }
+
+        void Add(int64_t nMicros);
+        /** Upper bound of the bucket holding the given percentile, in milliseconds */
+        int64_t GetPercentileMillis(double dPercentile) const;
+    };
+
+    int64_t nTimeStarted;
+    Stage stages[INSTANTSEND_STAGE_COUNT];
+
+    CInstantSendLatencyStats() : nTimeStarted(GetTime()) {}
+};
+
 class CInstantSend
 {
 private:
@@ -46,6 +87,8 @@ private:
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
     std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
     std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    std::map<uint256, std::set<uint256> > mapTxLockVotesOrphanByTx; // tx hash - orphan vote hash set
+    std::set<std::pair<int64_t, uint256> > setTxLockVotesOrphanByTime; // time created - orphan vote hash
 
     std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
 
@@ -55,12 +98,16 @@ private:
     //track masternodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
 
+    CInstantSendLatencyStats latencyStats;
+
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void Vote(CTxLockCandidate& txLockCandidate);
 
     //process consensus vote message
     bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote);
-    void ProcessOrphanTxLockVotes();
+    void ProcessOrphanTxLockVotes(const uint256& txHash);
+    void AddOrphanTxLockVote(const CTxLockVote& vote);
+    void EraseOrphanTxLockVote(const uint256& hashVote);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
     bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
     int64_t GetAverageMasternodeOrphanVoteTime();
@@ -73,6 +120,9 @@ private:
 
     bool IsInstantSendReadyToLock(const uint256 &txHash);
 
+    /// Record the first time a lock candidate reaches nStage
+    void UpdateLatencyStats(const uint256& txHash, InstantSendLatencyStage nStage);
+
 public:
     CCriticalSection cs_instantsend;
 
@@ -106,6 +156,10 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
 
+    CInstantSendLatencyStats GetLatencyStats(bool fReset = false);
+    /// Microseconds from the lock request to each stage of a known lock candidate, -1 if not reached
+    bool GetTxLockLatencies(const uint256& txHash, std::vector<int64_t>& vLatenciesRet);
+
     std::string ToString();
 };
 
@@ -227,12 +281,17 @@ public:
     CTxLockCandidate(const CTxLockRequest& txLockRequestIn) :
         nConfirmedHeight(-1),
         txLockRequest(txLockRequestIn),
-        mapOutPointLocks()
+        mapOutPointLocks(),
+        nTimeCreatedMicros(GetTimeMicros()),
+        vStageLatencies(INSTANTSEND_STAGE_COUNT, -1)
         {}
 
     CTxLockRequest txLockRequest;
     std::map<COutPoint, COutPointLock> mapOutPointLocks;
 
+    int64_t nTimeCreatedMicros;
+    std::vector<int64_t> vStageLatencies; // microseconds since nTimeCreatedMicros, -1 if not reached yet
+
     uint256 GetHash() const { return txLockRequest.GetHash(); }
 
     void AddOutPointLock(const COutPoint& outpoint);
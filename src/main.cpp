@@ -10,6 +10,7 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -46,6 +47,7 @@
 #include "masternode-sync.h"
 #include "masternodeman.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -97,6 +99,8 @@ CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE);
 
 CTxMemPool mempool(::minRelayTxFee);
 
+CBlockCache blockcache;
+
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
@@ -942,16 +946,74 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
     return nSigOps;
 }
 
+/** Creation height and value of the outpoints spent in recent blocks, for InstantSend votes on mined locks */
+static std::map<COutPoint, std::pair<int, CAmount> > mapSpentOutpoints;
+/** The keys of mapSpentOutpoints by the height they were spent at */
+static std::map<int, std::vector<COutPoint> > mapSpentOutpointsByHeight;
+/** Lowest height from which every block up to the tip is in the index, -1 if none */
+static int nSpentOutpointsFirstHeight = -1;
+
+static void EraseSpentOutpoints(int nHeight)
+{
+    std::map<int, std::vector<COutPoint> >::iterator it = mapSpentOutpointsByHeight.find(nHeight);
+    if (it == mapSpentOutpointsByHeight.end())
+        return;
+    BOOST_FOREACH(const COutPoint& outpoint, it->second)
+        mapSpentOutpoints.erase(outpoint);
+    mapSpentOutpointsByHeight.erase(it);
+}
+
+static void AddSpentOutpoints(int nHeight, const std::vector<std::pair<COutPoint, std::pair<int, CAmount> > >& vSpent)
+{
+    AssertLockHeld(cs_main);
+
+    EraseSpentOutpoints(nHeight);
+    std::vector<COutPoint>& vOutpoints = mapSpentOutpointsByHeight[nHeight];
+    vOutpoints.reserve(vSpent.size());
+    for (unsigned int i = 0; i < vSpent.size(); i++) {
+        mapSpentOutpoints[vSpent[i].first] = vSpent[i].second;
+        vOutpoints.push_back(vSpent[i].first);
+    }
+    if (nSpentOutpointsFirstHeight == -1 || nHeight < nSpentOutpointsFirstHeight)
+        nSpentOutpointsFirstHeight = nHeight;
+
+    while (!mapSpentOutpointsByHeight.empty() && mapSpentOutpointsByHeight.begin()->first <= nHeight - SPENT_OUTPOINTS_DEPTH)
+        EraseSpentOutpoints(mapSpentOutpointsByHeight.begin()->first);
+    nSpentOutpointsFirstHeight = std::max(nSpentOutpointsFirstHeight, nHeight - SPENT_OUTPOINTS_DEPTH + 1);
+}
+
+static void DisconnectSpentOutpoints(int nHeight)
+{
+    AssertLockHeld(cs_main);
+
+    EraseSpentOutpoints(nHeight);
+    // Heights below the window were trimmed, after a reorg deeper than the
+    // window the index has to fill up again before misses are final
+    if (nSpentOutpointsFirstHeight >= nHeight)
+        nSpentOutpointsFirstHeight = -1;
+}
+
+bool GetSpentOutpoint(const COutPoint& outpoint, int& nHeightRet, CAmount& nValueRet, bool& fCompleteRet)
+{
+    LOCK(cs_main);
+    fCompleteRet = nSpentOutpointsFirstHeight != -1 &&
+                   nSpentOutpointsFirstHeight <= chainActive.Height() - SPENT_OUTPOINTS_DEPTH + 1;
+    std::map<COutPoint, std::pair<int, CAmount> >::const_iterator it = mapSpentOutpoints.find(outpoint);
+    if (it == mapSpentOutpoints.end())
+        return false;
+    nHeightRet = it->second.first;
+    nValueRet = it->second.second;
+    return true;
+}
+
 int GetUTXOHeight(const COutPoint& outpoint)
 {
     LOCK(cs_main);
-    CCoins coins;
-    if(!pcoinsTip->GetCoins(outpoint.hash, coins) ||
-       (unsigned int)outpoint.n>=coins.vout.size() ||
-       coins.vout[outpoint.n].IsNull()) {
+    Coin coin;
+    if(!pcoinsTip->GetCoin(outpoint, coin)) {
         return -1;
     }
-    return coins.nHeight;
+    return coin.nHeight;
 }
 
 int GetInputAge(const CTxIn &txin)
@@ -1565,24 +1627,37 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 }
 
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CAddressIndexKey* pkeyAfter, size_t nLimit)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, pkeyAfter, nLimit))
         return error("unable to get txids for address");
 
     return true;
 }
 
+CAddressIndexMergeCursor* NewAddressIndexMergeCursor(const std::vector<std::pair<uint160, int> > &addresses,
+                                                     int start, int end)
+{
+    if (!fAddressIndex) {
+        error("address index not enabled");
+        return NULL;
+    }
+
+    return new CAddressIndexMergeCursor(*pblocktree, addresses, start, end);
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CAddressUnspentKey* pkeyAfter, size_t nLimit)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, pkeyAfter, nLimit))
         return error("unable to get txids for address");
 
     return true;
@@ -1634,9 +1709,9 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
     }
 
     if (pindexSlow) {
-        CBlock block;
-        if (ReadBlockFromDisk(block, pindexSlow, consensusParams)) {
-            BOOST_FOREACH(const CTransaction &tx, block.vtx) {
+        boost::shared_ptr<const CBlock> pblock;
+        if (ReadBlockFromDisk(pblock, pindexSlow, consensusParams)) {
+            BOOST_FOREACH(const CTransaction &tx, pblock->vtx) {
                 if (tx.GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
@@ -1704,13 +1779,62 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(boost::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
+    pblock = blockcache.Get(pindex->GetBlockHash());
+    if (pblock)
+        return true;
+
+    boost::shared_ptr<CBlock> pblockRead(new CBlock());
+    if (!ReadBlockFromDisk(*pblockRead, pindex->GetBlockPos(), consensusParams))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash())
+    if (pblockRead->GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
                 pindex->ToString(), pindex->GetBlockPos().ToString());
+    pblock = pblockRead;
+    blockcache.Insert(pindex->GetBlockHash(), pblock);
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    // For callers which modify the block or keep it in a CBlock of their own
+    boost::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pindex, consensusParams))
+        return false;
+    block = *pblock;
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // The block is preceded by the message start and its size, see WriteBlockToDisk
+    static const unsigned int nHeaderSize = MESSAGE_START_SIZE + sizeof(unsigned int);
+    if (pos.nPos < nHeaderSize)
+        return error("ReadRawBlockFromDisk: Invalid position %s", pos.ToString());
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - nHeaderSize);
+
+    // Open history file to read
+    CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars chStart;
+        unsigned int nSize;
+        filein >> FLATDATA(chStart) >> nSize;
+        if (memcmp(chStart, messageStart, MESSAGE_START_SIZE))
+            return error("ReadRawBlockFromDisk: Block magic mismatch at %s", pos.ToString());
+        if (nSize > MAX_BLOCK_SIZE)
+            return error("ReadRawBlockFromDisk: Block size %u too large at %s", nSize, pos.ToString());
+        vchBlock.resize(nSize);
+        if (nSize)
+            filein.read((char*)&vchBlock[0], nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
     return true;
 }
 
@@ -2393,6 +2517,9 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
         return true;
     }
 
+    // its inputs are back in the UTXO set
+    DisconnectSpentOutpoints(pindex->nHeight);
+
     if (fAddressIndex) {
         if (!pblocktree->EraseAddressIndex(addressIndex)) {
             return AbortNode(state, "Failed to delete address index");
@@ -2433,10 +2560,109 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
 void ThreadScriptCheck() {
+    static std::atomic<int> nThreadsStarted(0);
     RenameThread("sibcoin-scriptch");
+    // Workers take cores 1..n, the master thread adding the checks is left alone.
+    // Workers beyond the number of cores would have to share one, they are not pinned.
+    int nCore = ++nThreadsStarted;
+    if (GetBoolArg("-parpin", DEFAULT_SCRIPTCHECK_PIN)) {
+        if (nCore >= GetNumCores())
+            LogPrintf("ThreadScriptCheck -- no free core for thread %d, not pinning it\n", nCore);
+        else if (!PinThread(nCore))
+            LogPrintf("ThreadScriptCheck -- could not pin thread to core %d\n", nCore);
+    }
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Closure reading the coins of one txid from the coins database. The result
+ * goes to a slot owned by the caller, which is kept alive until the queue has
+ * been waited for.
+ */
+class CCoinsPrefetchCheck
+{
+private:
+    const CCoinsView *view;
+    uint256 txid;
+    CCoins *pcoins;
+    char *pfFound;
+
+public:
+    CCoinsPrefetchCheck() : view(NULL), pcoins(NULL), pfFound(NULL) {}
+    CCoinsPrefetchCheck(const CCoinsView *viewIn, const uint256 &txidIn, CCoins *pcoinsIn, char *pfFoundIn) :
+        view(viewIn), txid(txidIn), pcoins(pcoinsIn), pfFound(pfFoundIn) {}
+
+    bool operator()() {
+        *pfFound = view->GetCoins(txid, *pcoins);
+        // A miss is not an error; ConnectBlock will report missing inputs.
+        return true;
+    }
+
+    void swap(CCoinsPrefetchCheck &check) {
+        std::swap(view, check.view);
+        std::swap(txid, check.txid);
+        std::swap(pcoins, check.pcoins);
+        std::swap(pfFound, check.pfFound);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetchCheck> prefetchqueue(16);
+
+void ThreadCoinsPrefetch() {
+    RenameThread("sibcoin-prefetch");
+    prefetchqueue.Thread();
+}
+
+/**
+ * Warm pcoinsTip with the inputs of a block before it is connected. The
+ * txids missing from the cache are read from the coins database by the
+ * prefetch threads in parallel, so that ConnectBlock does not have to do one
+ * synchronous database read per cache miss. Returns the number of txids read.
+ */
+static unsigned int PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+
+    if (!nScriptCheckThreads)
+        return 0;
+
+    std::set<uint256> setSeen;
+    std::vector<uint256> vTxids;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        if (!tx.IsCoinBase()) {
+            BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+                // Outputs created earlier in this block are not in the database,
+                // neither are the ones we already have in memory.
+                if (setSeen.insert(txin.prevout.hash).second && !pcoinsTip->HaveCoinsInCache(txin.prevout.hash))
+                    vTxids.push_back(txin.prevout.hash);
+            }
+        }
+        setSeen.insert(tx.GetHash());
+    }
+    if (vTxids.size() < 2)
+        return 0;
+
+    // not std::vector<bool>, as the workers write to it concurrently
+    std::vector<char> vFound(vTxids.size(), false);
+    std::vector<CCoins> vCoins(vTxids.size());
+    std::vector<CCoinsPrefetchCheck> vChecks;
+    vChecks.reserve(vTxids.size());
+    const CCoinsView *view = pcoinsTip->GetBackend();
+    for (unsigned int i = 0; i < vTxids.size(); i++) {
+        vChecks.push_back(CCoinsPrefetchCheck(view, vTxids[i], &vCoins[i], &vFound[i]));
+    }
+
+    CCheckQueueControl<CCoinsPrefetchCheck> control(&prefetchqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    for (unsigned int i = 0; i < vTxids.size(); i++) {
+        if (vFound[i])
+            pcoinsTip->AddPrefetchedCoins(vTxids[i], vCoins[i]);
+    }
+    return vTxids.size();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2613,6 +2839,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
     std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    std::vector<std::pair<COutPoint, std::pair<int, CAmount> > > vSpentOutpoints;
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
@@ -2644,6 +2871,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
 
+            for (size_t j = 0; j < tx.vin.size(); j++)
+                vSpentOutpoints.push_back(std::make_pair(tx.vin[j].prevout, std::make_pair(prevheights[j], view.GetOutputFor(tx.vin[j]).nValue)));
+
             if (fAddressIndex || fSpentIndex)
             {
                 for (size_t j = 0; j < tx.vin.size(); j++) {
@@ -2768,6 +2998,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return state.DoS(100, false);
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2), nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * 0.000001);
+    if (LogAcceptCategory("bench")) {
+        CSignatureCacheStats sigcacheStats = GetSignatureCacheStats();
+        LogPrint("bench", "    - Signature cache: %u hits, %u misses, %u evictions\n", sigcacheStats.nHits, sigcacheStats.nMisses, sigcacheStats.nEvictions);
+    }
 
     if (fJustCheck)
         return true;
@@ -2813,6 +3047,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
             return AbortNode(state, "Failed to write timestamp index");
 
+    AddSpentOutpoints(pindex->nHeight, vSpentOutpoints);
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -3059,6 +3295,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -3079,10 +3316,14 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
             return AbortNode(state, "Failed to read block");
         pblock = &block;
     }
-    // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
-    int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    // Warm the coins cache with the block's inputs.
+    unsigned int nPrefetched = PrefetchBlockInputs(*pblock);
+    int64_t nTime3 = GetTimeMicros(); nTimePrefetch += nTime3 - nTime2;
+    int64_t nTime4;
+    LogPrint("bench", "  - Prefetch inputs: %.2fms (%u txids) [%.2fs]\n", (nTime3 - nTime2) * 0.001, nPrefetched, nTimePrefetch * 0.000001);
+    // Apply the block atomically to the chain state.
     {
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(*pblock, state, pindexNew, view);
@@ -3093,17 +3334,20 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         mapBlockSource.erase(pindexNew->GetBlockHash());
-        nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
-        LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
+        // Blocks read from disk were cached by ReadBlockFromDisk already.
+        if (pblock != &block)
+            blockcache.Insert(pindexNew->GetBlockHash(), *pblock);
+        nTime4 = GetTimeMicros(); nTimeConnectTotal += nTime4 - nTime3;
+        LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeConnectTotal * 0.000001);
         assert(view.Flush());
     }
-    int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
-    LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime4 - nTime3) * 0.001, nTimeFlush * 0.000001);
+    int64_t nTime5 = GetTimeMicros(); nTimeFlush += nTime5 - nTime4;
+    LogPrint("bench", "  - Flush: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeFlush * 0.000001);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
         return false;
-    int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
-    LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime5 - nTime4) * 0.001, nTimeChainState * 0.000001);
+    int64_t nTime6 = GetTimeMicros(); nTimeChainState += nTime6 - nTime5;
+    LogPrint("bench", "  - Writing chainstate: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimeChainState * 0.000001);
     // Remove conflicting transactions from the mempool.
     list<CTransaction> txConflicted;
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload());
@@ -3119,9 +3363,9 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
         SyncWithWallets(tx, pblock);
     }
 
-    int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
-    LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
-    LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
+    int64_t nTime7 = GetTimeMicros(); nTimePostConnect += nTime7 - nTime6; nTimeTotal += nTime7 - nTime1;
+    LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime7 - nTime6) * 0.001, nTimePostConnect * 0.000001);
+    LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime7 - nTime1) * 0.001, nTimeTotal * 0.000001);
     return true;
 }
 
@@ -3501,10 +3745,10 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex *pindex) {
     return true;
 }
 
-CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
+CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256* phash = NULL)
 {
     // Check for duplicate
-    uint256 hash = block.GetHash();
+    uint256 hash = phash ? *phash : block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
@@ -3669,10 +3913,10 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     return true;
 }
 
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW)
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW, const uint256* phash)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus()))
+    if (fCheckPOW && !CheckProofOfWork(phash ? *phash : block.GetHash(), block.nBits, Params().GetConsensus()))
         return state.DoS(50, error("CheckBlockHeader(): proof of work failed"),
                          REJECT_INVALID, "high-hash");
 
@@ -3684,7 +3928,7 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot)
+bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot, const uint256* phash)
 {
     // These are checks that are independent of context.
 
@@ -3693,7 +3937,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, fCheckPOW))
+    if (!CheckBlockHeader(block, state, fCheckPOW, phash))
         return false;
 
     // Check the merkle root.
@@ -3878,11 +4122,11 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL, const uint256* phash=NULL)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
+    uint256 hash = phash ? *phash : block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
 
@@ -3899,7 +4143,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state))
+        if (!CheckBlockHeader(block, state, true, &hash))
             return false;
 
         // Get prev block index
@@ -3919,7 +4163,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return false;
     }
     if (pindex == NULL)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, &hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3927,8 +4171,11 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
-/** Store block on disk. If dbp is non-NULL, the file is known to already reside on disk */
-static bool AcceptBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+/**
+ * Store block on disk. If dbp is non-NULL, the file is known to already reside on disk.
+ * If phash is non-NULL, it is the block hash as already computed by the caller.
+ */
+static bool AcceptBlock(const CBlock& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phash = NULL)
 {
     if (fNewBlock) *fNewBlock = false;
     AssertLockHeld(cs_main);
@@ -3936,7 +4183,7 @@ static bool AcceptBlock(const CBlock& block, CValidationState& state, const CCha
     CBlockIndex *pindexDummy = NULL;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, phash))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -3961,7 +4208,7 @@ static bool AcceptBlock(const CBlock& block, CValidationState& state, const CCha
     }
     if (fNewBlock) *fNewBlock = true;
 
-    if ((!CheckBlock(block, state)) || !ContextualCheckBlock(block, state, pindex->pprev)) {
+    if ((!CheckBlock(block, state, true, true, pindex->phashBlock)) || !ContextualCheckBlock(block, state, pindex->pprev)) {
         if (state.IsInvalid() && !state.CorruptionPossible()) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
             setDirtyBlockIndex.insert(pindex);
@@ -4543,6 +4790,277 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
+/**
+ * Closure hashing a block being imported and running its context-free checks
+ * (PoW hash, merkle root, transaction sanity). The hash is stored in *phash
+ * for AcceptExternalBlock. Blocks which pass are marked fChecked, so
+ * AcceptBlock does not repeat the work; failures are left for AcceptBlock
+ * to report.
+ */
+class CBlockCheck
+{
+private:
+    const CBlock *pblock;
+    uint256 *phash;
+
+public:
+    CBlockCheck() : pblock(NULL), phash(NULL) {}
+    CBlockCheck(const CBlock *pblockIn, uint256 *phashIn) : pblock(pblockIn), phash(phashIn) {}
+
+    bool operator()() {
+        *phash = pblock->GetHash();
+        CValidationState state;
+        CheckBlock(*pblock, state, true, true, phash);
+        return true;
+    }
+
+    void swap(CBlockCheck &check) {
+        std::swap(pblock, check.pblock);
+        std::swap(phash, check.phash);
+    }
+};
+
+static CCheckQueue<CBlockCheck> blockcheckqueue(1);
+
+void ThreadBlockCheck() {
+    RenameThread("sibcoin-blockchk");
+    blockcheckqueue.Thread();
+}
+
+/** Number of blocks read, checked and accepted together by LoadExternalBlockFile */
+static const unsigned int IMPORT_BATCH_SIZE = 16;
+
+/** Number of batches LoadExternalBlockFile accepts ahead of the connect stage */
+static const int IMPORT_MAX_UNCONNECTED_BATCHES = 4;
+
+static int64_t nTimeImportRead = 0;
+static int64_t nTimeImportCheck = 0;
+static int64_t nTimeImportAccept = 0;
+static int64_t nTimeImportWaitConnect = 0;
+static int64_t nTimeImportConnect = 0;
+
+/**
+ * The connect stage of LoadExternalBlockFile: a thread running
+ * ActivateBestChain after each accepted batch, while the import thread reads,
+ * checks and accepts the next ones. ActivateBestChain releases cs_main
+ * between steps, so accepting and connecting interleave.
+ */
+class CImportConnector
+{
+private:
+    const CChainParams& chainparams;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! Batches accepted by the import thread
+    int nAccepted;
+    //! Batches connected, i.e. accepted before the last ActivateBestChain started
+    int nConnected;
+    bool fFailed;
+    bool fStop;
+    boost::thread thread;
+
+    void Loop()
+    {
+        RenameThread("sibcoin-loadconn");
+        try {
+            while (true) {
+                int nTarget;
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    while (nConnected == nAccepted && !fStop)
+                        cond.wait(lock);
+                    if (fStop)
+                        return;
+                    nTarget = nAccepted;
+                }
+
+                int64_t nTime0 = GetTimeMicros();
+                CValidationState state;
+                bool fOk = ActivateBestChain(state, chainparams);
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    nTimeImportConnect += GetTimeMicros() - nTime0;
+                    nConnected = nTarget;
+                    fFailed = !fOk;
+                }
+                cond.notify_all();
+                if (!fOk)
+                    return;
+            }
+        } catch (const boost::thread_interrupted&) {
+            // The blocks left are connected by the next import or by ThreadImport
+        }
+    }
+
+public:
+    CImportConnector(const CChainParams& chainparamsIn) : chainparams(chainparamsIn), nAccepted(0), nConnected(0), fFailed(false), fStop(false),
+        thread(boost::bind(&CImportConnector::Loop, this)) {}
+
+    ~CImportConnector()
+    {
+        boost::this_thread::disable_interruption di;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fStop = true;
+        }
+        cond.notify_all();
+        thread.interrupt();
+        thread.join();
+    }
+
+    //! Connect the blocks of an accepted batch. Waits while too many batches are left to connect. Returns false if connecting failed.
+    bool Add()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nAccepted++;
+        cond.notify_all();
+        while (nAccepted - nConnected > IMPORT_MAX_UNCONNECTED_BATCHES && !fFailed)
+            cond.wait(lock);
+        return !fFailed;
+    }
+
+    //! Wait until all accepted batches are connected. Returns false if connecting failed.
+    bool Wait()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (nConnected < nAccepted && !fFailed)
+            cond.wait(lock);
+        return !fFailed;
+    }
+
+    int64_t GetConnectTime()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        return nTimeImportConnect;
+    }
+};
+
+/** Read the next block from a block file, skipping garbage. Returns false at the end of the file. */
+static bool ReadNextExternalBlock(const CChainParams& chainparams, CBufferedFile& blkdat, uint64_t& nRewind, CBlock& block, unsigned int& nBlockPosRet)
+{
+    while (!blkdat.eof()) {
+        boost::this_thread::interruption_point();
+
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SIZE)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            return false;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            blkdat.SetPos(nBlockPos);
+            block.SetNull();
+            blkdat >> block;
+            nRewind = blkdat.GetPos();
+            nBlockPosRet = nBlockPos;
+            return true;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+    }
+    return false;
+}
+
+/** Read up to IMPORT_BATCH_SIZE blocks. Returns false if the end of the file was reached. */
+static bool ReadExternalBlockBatch(const CChainParams& chainparams, CBufferedFile& blkdat, uint64_t& nRewind,
+                                   std::vector<CBlock>& vBlocks, std::vector<unsigned int>& vBlockPos)
+{
+    vBlocks.clear();
+    vBlockPos.clear();
+    while (vBlocks.size() < IMPORT_BATCH_SIZE) {
+        unsigned int nBlockPos = 0;
+        vBlocks.push_back(CBlock());
+        if (!ReadNextExternalBlock(chainparams, blkdat, nRewind, vBlocks.back(), nBlockPos)) {
+            vBlocks.pop_back();
+            return false;
+        }
+        vBlockPos.push_back(nBlockPos);
+    }
+    return true;
+}
+
+/** Accept one block read from a block file, whose hash was computed by its CBlockCheck. Returns false if importing should stop. */
+static bool AcceptExternalBlock(const CChainParams& chainparams, const CBlock& block, const uint256& hash, CDiskBlockPos *dbp,
+                                std::multimap<uint256, CDiskBlockPos>& mapBlocksUnknownParent, int& nLoaded)
+{
+    // detect out of order blocks, and store them for later
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL, &hash))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    CBlock blockChild;
+    deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            if (ReadBlockFromDisk(blockChild, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, blockChild.GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(blockChild, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(blockChild.GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
@@ -4554,102 +5072,75 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SIZE, MAX_BLOCK_SIZE+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
+        // Blocks are imported in batches which go through four stages: they
+        // are read and deserialized, checked context-free on the block check
+        // threads, accepted in file order on this thread, and connected by
+        // the connect stage. While one batch is being checked, this thread
+        // reads the next one; while batches are being connected, it goes on
+        // with the next ones.
+        CImportConnector connector(chainparams);
+        std::vector<CBlock> vBlocks, vBlocksNext;
+        std::vector<unsigned int> vBlockPos, vBlockPosNext;
+        std::vector<uint256> vHashes;
+        int64_t nTime0 = GetTimeMicros();
+        bool fEof = !ReadExternalBlockBatch(chainparams, blkdat, nRewind, vBlocks, vBlockPos);
+        nTimeImportRead += GetTimeMicros() - nTime0;
+        bool fAbort = false;
+        while (!vBlocks.empty() && !fAbort) {
+            int64_t nTime1 = GetTimeMicros();
+            int64_t nTime2;
+            {
+                CCheckQueueControl<CBlockCheck> control(nScriptCheckThreads ? &blockcheckqueue : NULL);
+                std::vector<CBlockCheck> vChecks;
+                vChecks.reserve(vBlocks.size());
+                vHashes.resize(vBlocks.size());
+                for (unsigned int i = 0; i < vBlocks.size(); i++)
+                    vChecks.push_back(CBlockCheck(&vBlocks[i], &vHashes[i]));
+                // without check threads the hashes are still needed, so run the checks here
+                if (nScriptCheckThreads)
+                    control.Add(vChecks);
+                else
+                    BOOST_FOREACH(CBlockCheck& check, vChecks)
+                        check();
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+                vBlocksNext.clear();
+                vBlockPosNext.clear();
+                if (!fEof)
+                    fEof = !ReadExternalBlockBatch(chainparams, blkdat, nRewind, vBlocksNext, vBlockPosNext);
+                nTime2 = GetTimeMicros(); nTimeImportRead += nTime2 - nTime1;
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
+                control.Wait();
+            }
+            int64_t nTime3 = GetTimeMicros(); nTimeImportCheck += nTime3 - nTime2;
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
+            for (unsigned int i = 0; i < vBlocks.size() && !fAbort; i++) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (dbp)
+                        dbp->nPos = vBlockPos[i];
+                    fAbort = !AcceptExternalBlock(chainparams, vBlocks[i], vHashes[i], dbp, mapBlocksUnknownParent, nLoaded);
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
-        }
+            int64_t nTime4 = GetTimeMicros(); nTimeImportAccept += nTime4 - nTime3;
+
+            if (!fAbort)
+                fAbort = !connector.Add();
+            int64_t nTime5 = GetTimeMicros(); nTimeImportWaitConnect += nTime5 - nTime4;
+            LogPrint("bench", "Import %u blocks: read %.2fms [%.2fs], wait for checks %.2fms [%.2fs], accept %.2fms [%.2fs], wait for connect %.2fms [%.2fs], connect [%.2fs]\n",
+                     vBlocks.size(), (nTime2 - nTime1) * 0.001, nTimeImportRead * 0.000001,
+                     (nTime3 - nTime2) * 0.001, nTimeImportCheck * 0.000001,
+                     (nTime4 - nTime3) * 0.001, nTimeImportAccept * 0.000001,
+                     (nTime5 - nTime4) * 0.001, nTimeImportWaitConnect * 0.000001,
+                     connector.GetConnectTime() * 0.000001);
+
+            vBlocks.swap(vBlocksNext);
+            vBlockPos.swap(vBlockPosNext);
+        }
+        if (!fAbort)
+            connector.Wait();
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
@@ -4961,7 +5452,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return instantsend.AlreadyHave(inv.hash);
 
     case MSG_SPORK:
-        return mapSporks.count(inv.hash);
+        return sporkManager.AlreadyHave(inv.hash);
 
     case MSG_MASTERNODE_PAYMENT_VOTE:
         return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
@@ -5048,9 +5539,10 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
                     // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                    boost::shared_ptr<const CBlock> pblock;
+                    if (!ReadBlockFromDisk(pblock, (*mi).second, consensusParams))
                         assert(!"cannot load block from disk");
+                    const CBlock& block = *pblock;
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage(NetMsgType::BLOCK, block);
                     else // MSG_FILTERED_BLOCK)
@@ -5139,10 +5631,11 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_SPORK) {
-                    if(mapSporks.count(inv.hash)) {
+                    CSporkMessage spork;
+                    if(sporkManager.GetSporkByHash(inv.hash, spork)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapSporks[inv.hash];
+                        ss << spork;
                         pfrom->PushMessage(NetMsgType::SPORK, ss);
                         pushed = true;
                     }
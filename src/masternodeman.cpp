@@ -114,6 +114,8 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  mapTopRanksCache(),
+  nTopRanksCacheClock(0),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -129,6 +131,7 @@ bool CMasternodeMan::Add(CMasternode &mn)
         vMasternodes.push_back(mn);
         indexMasternodes.AddMasternodeVIN(mn.vin);
         fMasternodesAdded = true;
+        mapTopRanksCache.clear();
         return true;
     }
 
@@ -171,7 +174,11 @@ void CMasternodeMan::Check()
     LogPrint("masternode", "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        int nActiveStatePrev = mn.nActiveState;
         mn.Check();
+        if(mn.nActiveState != nActiveStatePrev) {
+            mapTopRanksCache.clear();
+        }
     }
 }
 
@@ -208,6 +215,7 @@ void CMasternodeMan::CheckAndRemove()
                 it->FlagGovernanceItemsAsDirty();
                 it = vMasternodes.erase(it);
                 fMasternodesRemoved = true;
+                mapTopRanksCache.clear();
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
@@ -376,6 +384,7 @@ void CMasternodeMan::Clear()
     nLastWatchdogVoteTime = 0;
     indexMasternodes.Clear();
     indexMasternodesOld.Clear();
+    mapTopRanksCache.clear();
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -689,6 +698,60 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nM
     return -1;
 }
 
+int CMasternodeMan::GetMasternodeTopRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, int nTopRanks)
+{
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+
+    LOCK(cs);
+
+    int64_t nNow = GetTime();
+    std::map<int, top_ranks_t>::iterator it = mapTopRanksCache.find(nBlockHeight);
+    // masternodes can also change their state in CMasternode::Check called outside of
+    // this class, so don't trust a quorum longer than one check interval
+    if(it != mapTopRanksCache.end() &&
+            (it->second.blockHash != blockHash || it->second.nMinProtocol != nMinProtocol ||
+             it->second.nTopRanks != nTopRanks || nNow - it->second.nTimeCreated > MASTERNODE_CHECK_SECONDS)) {
+        mapTopRanksCache.erase(it);
+        it = mapTopRanksCache.end();
+    }
+
+    if(it == mapTopRanksCache.end()) {
+        if((int)mapTopRanksCache.size() >= MAX_TOP_RANKS_CACHE_SIZE) {
+            std::map<int, top_ranks_t>::iterator itOldest = mapTopRanksCache.begin();
+            for(std::map<int, top_ranks_t>::iterator it2 = mapTopRanksCache.begin(); it2 != mapTopRanksCache.end(); ++it2) {
+                if(it2->second.nLastUsed < itOldest->second.nLastUsed) itOldest = it2;
+            }
+            mapTopRanksCache.erase(itOldest);
+        }
+
+        // same ordering as GetMasternodeRank with fOnlyActive
+        std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+            if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+            int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+            vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
+        }
+        sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreMN());
+
+        it = mapTopRanksCache.insert(std::make_pair(nBlockHeight, top_ranks_t())).first;
+        top_ranks_t& topRanks = it->second;
+        topRanks.blockHash = blockHash;
+        topRanks.nMinProtocol = nMinProtocol;
+        topRanks.nTopRanks = nTopRanks;
+        topRanks.nTimeCreated = nNow;
+        for(int i = 0; i < nTopRanks && i < (int)vecMasternodeScores.size(); i++) {
+            topRanks.mapRanks[vecMasternodeScores[i].second->vin.prevout] = i + 1;
+        }
+    }
+
+    it->second.nLastUsed = ++nTopRanksCacheClock;
+
+    std::map<COutPoint, int>::const_iterator itRank = it->second.mapRanks.find(vin.prevout);
+    return itRank == it->second.mapRanks.end() ? 0 : itRank->second;
+}
+
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
 {
     std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
@@ -1394,6 +1457,7 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         if(pmn->UpdateFromNewBroadcast(mnb)) {
             masternodeSync.AddedMasternodeList();
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
+            mapTopRanksCache.clear();
         }
     }
 }
@@ -1584,7 +1648,11 @@ void CMasternodeMan::CheckMasternode(const CTxIn& vin, bool fForce)
     if(!pMN)  {
         return;
     }
+    int nActiveStatePrev = pMN->nActiveState;
     pMN->Check(fForce);
+    if(pMN->nActiveState != nActiveStatePrev) {
+        mapTopRanksCache.clear();
+    }
 }
 
 void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForce)
@@ -1594,7 +1662,11 @@ void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForc
     if(!pMN)  {
         return;
     }
+    int nActiveStatePrev = pMN->nActiveState;
     pMN->Check(fForce);
+    if(pMN->nActiveState != nActiveStatePrev) {
+        mapTopRanksCache.clear();
+    }
 }
 
 int CMasternodeMan::GetMasternodeState(const CTxIn& vin)
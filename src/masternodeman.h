@@ -110,6 +110,19 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int MAX_TOP_RANKS_CACHE_SIZE       = 64;
+
+    /// Top ranked masternodes at one block height
+    struct top_ranks_t
+    {
+        uint256 blockHash;
+        int nMinProtocol;
+        int nTopRanks;
+        int64_t nTimeCreated;
+        /// Value of nTopRanksCacheClock at the last lookup, oldest is evicted first
+        uint64_t nLastUsed;
+        std::map<COutPoint, int> mapRanks;
+    };
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -152,6 +165,11 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    /// Quorums used by GetMasternodeTopRank, by block height.
+    /// Cleared whenever masternodes are added, removed or change their state.
+    std::map<int, top_ranks_t> mapTopRanksCache;
+    uint64_t nTopRanksCacheClock;
+
     friend class CMasternodeSync;
 
 public:
@@ -296,6 +314,12 @@ public:
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
+    /**
+     * Same as GetMasternodeRank for active masternodes but only ranks the first nTopRanks
+     * ones and caches them per height, so repeated checks against the same quorum are
+     * map lookups. Returns 0 if the masternode is not in the top, -1 if the block is unknown.
+     */
+    int GetMasternodeTopRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol, int nTopRanks);
     CMasternode* GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
 
     void ProcessMasternodeConnections();
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include "support/allocators/pool.h"
+
 #include <stdlib.h>
 
 #include <map>
@@ -127,6 +129,15 @@ static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z>& m)
     return MallocUsage(sizeof(boost_unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+/** For pooled maps, count the chunks of the pool rather than the nodes, as
+ *  that is what is actually allocated, plus whatever bypassed the pool. */
+template<typename X, typename Y, typename Z, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z, std::equal_to<X>, CPoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> >& m)
+{
+    const CPoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* resource = m.get_allocator().Resource();
+    return resource->NumAllocatedChunks() * MallocUsage(resource->ChunkSizeBytes()) + MallocUsage(resource->OversizedBytes());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
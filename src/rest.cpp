@@ -24,6 +24,8 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int32_t MAX_REST_BLOCK_RANGE = 1000; //max number of blocks of a /rest/blockrange/ request
+static const size_t MAX_REST_BLOCK_RANGE_SIZE = 32 * 1024 * 1024; //stop adding blocks to a range reply beyond this size
 
 enum RetFormat {
     RF_UNDEF,
@@ -60,8 +62,10 @@ struct CCoin {
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, UniValueStreamWriter& writer);
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSON(UniValueStreamWriter& writer);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
@@ -118,6 +122,18 @@ static bool ParseHashStr(const string& strReq, uint256& v)
     return true;
 }
 
+/** Append bytes to the reply body, hex encoded for RF_HEX */
+static void WriteReplyBytes(HTTPRequest* req, const RetFormat rf, const unsigned char* pch, size_t len)
+{
+    if (rf == RF_HEX) {
+        std::string strHex(2 * len, '\0');
+        HexEncode(pch, len, &strHex[0]);
+        req->WriteReplyChunk(strHex.data(), strHex.size());
+    } else {
+        req->WriteReplyChunk((const char*)pch, len);
+    }
+}
+
 static bool CheckWarmup(HTTPRequest* req)
 {
     std::string statusmessage;
@@ -176,9 +192,10 @@ static bool rest_headers(HTTPRequest* req,
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
+        if (!ssHeader.empty())
+            WriteReplyBytes(req, rf, (const unsigned char*)&ssHeader.begin()[0], ssHeader.size());
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
     case RF_JSON: {
@@ -213,8 +230,9 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
+    boost::shared_ptr<const CBlock> pblock;
     CBlockIndex* pblockindex = NULL;
+    std::vector<unsigned char> vchBlock;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -224,33 +242,35 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        // The binary and hex formats are the stored bytes, there is no need to parse them
+        if (rf == RF_BINARY || rf == RF_HEX) {
+            if (!ReadRawBlockFromDisk(vchBlock, pblockindex->GetBlockPos(), Params().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else if (!ReadBlockFromDisk(pblock, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        WriteReplyBytes(req, rf, vchBlock.data(), vchBlock.size());
+        req->WriteReply(HTTP_OK);
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
+        WriteReplyBytes(req, rf, vchBlock.data(), vchBlock.size());
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPReplyStreamWriter writer(req);
+        blockToJSON(*pblock, pblockindex, showTxDetails, writer);
+        writer.flush();
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
 
@@ -273,6 +293,88 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+static bool rest_blockrange(HTTPRequest* req,
+                            const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RF_BINARY && rf != RF_HEX && rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block count specified. Use /rest/blockrange/<count>/<hash>.<ext>.");
+
+    int32_t count;
+    if (!ParseInt32(path[0], &count) || count < 1 || count > MAX_REST_BLOCK_RANGE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + path[0]);
+
+    string hashStr = path[1];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    // Blocks are read one at a time, so that cs_main is not held for the
+    // whole range. The reply ends early at the tip, at pruned blocks or
+    // beyond MAX_REST_BLOCK_RANGE_SIZE; clients continue after the last
+    // block they got.
+    const CBlockIndex* pindex = NULL;
+    long nBlocks = 0;
+    size_t nSize = 0;
+    std::vector<unsigned char> vchBlock;
+    boost::shared_ptr<const CBlock> pblock;
+    HTTPReplyStreamWriter writer(req);
+    while (nBlocks < count && nSize < MAX_REST_BLOCK_RANGE_SIZE) {
+        {
+            LOCK(cs_main);
+            if (nBlocks == 0) {
+                BlockMap::const_iterator it = mapBlockIndex.find(hash);
+                pindex = (it != mapBlockIndex.end() && chainActive.Contains(it->second)) ? it->second : NULL;
+                if (!pindex)
+                    return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found in active chain");
+            } else {
+                // The chain may have been reorganized since the previous block
+                pindex = chainActive.Contains(pindex) ? chainActive.Next(pindex) : NULL;
+            }
+            if (!pindex || (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0))
+                break;
+            if (rf == RF_JSON) {
+                if (!ReadBlockFromDisk(pblock, pindex, Params().GetConsensus()))
+                    break;
+            } else if (!ReadRawBlockFromDisk(vchBlock, pindex->GetBlockPos(), Params().MessageStart()))
+                break;
+        }
+        if (nBlocks == 0) {
+            req->WriteHeader("Content-Type", rf == RF_JSON ? "application/json" : (rf == RF_HEX ? "text/plain" : "application/octet-stream"));
+            if (rf == RF_JSON)
+                writer.beginArray();
+        }
+        if (rf == RF_JSON) {
+            // The same objects as /rest/block/<hash>.json
+            blockToJSON(*pblock, pindex, true, writer);
+            nSize += ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION);
+        } else {
+            WriteReplyBytes(req, rf, vchBlock.data(), vchBlock.size());
+            nSize += vchBlock.size();
+        }
+        nBlocks++;
+    }
+
+    if (nBlocks == 0)
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available");
+
+    if (rf == RF_JSON) {
+        writer.endArray();
+        writer.flush();
+    }
+    req->WriteReply(HTTP_OK, rf == RF_BINARY ? "" : "\n");
+    return true;
+}
+
 static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -332,11 +434,11 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPReplyStreamWriter writer(req);
+        mempoolToJSON(writer);
+        writer.flush();
+        req->WriteReply(HTTP_OK, "\n");
         return true;
     }
     default: {
@@ -603,6 +705,7 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blockrange/", rest_blockrange},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
@@ -610,10 +713,21 @@ static const struct {
       {"/rest/getutxos", rest_getutxos},
 };
 
+/** Only cheap probes go to the priority lane: chain and mempool info, and a
+ * single header such as the tip. Blocks, ranges and mempool contents can be
+ * large and use the normal lane. */
+static bool rest_priority(HTTPRequest* req)
+{
+    const std::string strURI = req->GetURI();
+    if (boost::starts_with(strURI, "/rest/chaininfo") || boost::starts_with(strURI, "/rest/mempool/info"))
+        return true;
+    return boost::starts_with(strURI, "/rest/headers/1/");
+}
+
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, rest_priority);
     return true;
 }
 
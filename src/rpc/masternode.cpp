@@ -5,6 +5,7 @@
 #include "activemasternode.h"
 #include "darksend.h"
 #include "init.h"
+#include "instantx.h"
 #include "main.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
@@ -74,6 +75,10 @@ UniValue getpoolinfo(const UniValue& params, bool fHelp)
     obj.push_back(Pair("entries",           darkSendPool.GetEntriesCount()));
     obj.push_back(Pair("status",            darkSendPool.GetStatus()));
 
+    if (fMasterNode) {
+        obj.push_back(Pair("sessions",      darkSendPool.GetSessionsCount()));
+    }
+
     if (darkSendPool.pSubmittedToMasternode) {
         obj.push_back(Pair("outpoint",      darkSendPool.pSubmittedToMasternode->vin.prevout.ToStringShort()));
         obj.push_back(Pair("addr",          darkSendPool.pSubmittedToMasternode->addr.ToString()));
@@ -88,6 +93,55 @@ UniValue getpoolinfo(const UniValue& params, bool fHelp)
     return obj;
 }
 
+UniValue getinstantsendinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw std::runtime_error(
+            "getinstantsendinfo ( reset )\n"
+            "Returns an object containing InstantSend lock latencies seen by this node.\n"
+            "Every stage is timed from the arrival of the lock request.\n"
+            "\nArguments:\n"
+            "1. reset        (boolean, optional, default=false) Start new statistics after returning these\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"since\": xxxxx,          (numeric) Start of the statistics in seconds since epoch (Jan 1 1970 GMT)\n"
+            "  \"stage\": {               (json object) One of first_vote, ready, locked\n"
+            "    \"count\": xxxxx,        (numeric) Number of locks that reached this stage\n"
+            "    \"avg_ms\": x.xxx,       (numeric) Average latency in milliseconds\n"
+            "    \"max_ms\": x.xxx,       (numeric) Maximum latency in milliseconds\n"
+            "    \"p50_ms\": xxxxx,       (numeric) Median latency, rounded up to the histogram bucket\n"
+            "    \"p99_ms\": xxxxx,       (numeric) 99th percentile latency, rounded up to the histogram bucket\n"
+            "    \"histogram\": [ n,...]  (array) Locks with latency <1ms, 1ms, 2-3ms, 4-7ms, ...\n"
+            "  }, ...\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getinstantsendinfo", "")
+            + HelpExampleRpc("getinstantsendinfo", "true")
+        );
+
+    bool fReset = params.size() > 0 && params[0].get_bool();
+    CInstantSendLatencyStats stats = instantsend.GetLatencyStats(fReset);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("since", stats.nTimeStarted));
+    for (int i = 0; i < INSTANTSEND_STAGE_COUNT; i++) {
+        const CInstantSendLatencyStats::Stage& stage = stats.stages[i];
+        UniValue objStage(UniValue::VOBJ);
+        objStage.push_back(Pair("count", stage.nCount));
+        objStage.push_back(Pair("avg_ms", stage.nCount ? stage.nTotalMicros * 0.001 / stage.nCount : 0.0));
+        objStage.push_back(Pair("max_ms", stage.nMaxMicros * 0.001));
+        objStage.push_back(Pair("p50_ms", stage.GetPercentileMillis(0.5)));
+        objStage.push_back(Pair("p99_ms", stage.GetPercentileMillis(0.99)));
+        UniValue histogram(UniValue::VARR);
+        for (int j = 0; j < CInstantSendLatencyStats::HISTOGRAM_BUCKETS; j++)
+            histogram.push_back(stage.vHistogram[j]);
+        objStage.push_back(Pair("histogram", histogram));
+        obj.push_back(Pair(GetInstantSendLatencyStageName(i), objStage));
+    }
+
+    return obj;
+}
+
 
 UniValue masternode(const UniValue& params, bool fHelp)
 {
@@ -6,12 +6,14 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "httpserver.h"
 #include "init.h"
 #include "main.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "spork.h"
@@ -26,6 +28,9 @@
 
 #include <boost/assign/list_of.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <univalue.h>
 
@@ -139,6 +144,73 @@ UniValue debug(const UniValue& params, bool fHelp)
     return "Debug mode: " + (fDebug ? strMode : "off");
 }
 
+static UniValue HistogramToJSON(const uint64_t* vHistogram)
+{
+    UniValue result(UniValue::VOBJ);
+    for (int i = 0; i < HTTPWorkQueueStats::HISTOGRAM_BUCKETS; i++) {
+        if (!vHistogram[i])
+            continue;
+        std::string strBucket;
+        if (i < 2)
+            strBucket = strprintf("%d", i);
+        else if (i == HTTPWorkQueueStats::HISTOGRAM_BUCKETS - 1)
+            strBucket = strprintf("%d+", 1 << (i - 1));
+        else
+            strBucket = strprintf("%d-%d", 1 << (i - 1), (1 << i) - 1);
+        result.push_back(Pair(strBucket, vHistogram[i]));
+    }
+    return result;
+}
+
+UniValue gethttpqueueinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "gethttpqueueinfo\n"
+            "Returns the state of the work queue of the RPC and REST server.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"workers\": n,              (numeric) Number of worker threads, one of them is kept for the priority lane\n"
+            "  \"triage\": n,               (numeric) Requests waiting for their lane to be decided\n"
+            "  \"priority\": {              (json object) Lightweight calls and REST requests\n"
+            "    \"depth\": n,              (numeric) Requests waiting for a worker\n"
+            "    \"limit\": n,              (numeric) Most requests allowed to wait, the lane's share of -rpcworkqueue\n"
+            "    \"maxdepth\": n,           (numeric) Most requests ever waiting at once\n"
+            "    \"queued\": n,             (numeric) Requests queued since startup\n"
+            "    \"rejected\": n,           (numeric) Requests rejected because the queue was full\n"
+            "    \"depth_histogram\": {...}, (json object) Requests by queue depth when queued\n"
+            "    \"wait_ms_histogram\": {...} (json object) Requests by milliseconds waited for a worker\n"
+            "  },\n"
+            "  \"normal\": {...}            (json object) All other requests, same fields\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gethttpqueueinfo", "")
+            + HelpExampleRpc("gethttpqueueinfo", "")
+        );
+
+    HTTPWorkQueueStats stats;
+    if (!GetHTTPWorkQueueStats(stats))
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "HTTP server not running");
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("workers", stats.nWorkers));
+    result.push_back(Pair("triage", (uint64_t)stats.nTriage));
+    const char* vLaneNames[HTTP_LANE_COUNT] = {"normal", "priority"};
+    for (int lane = HTTP_LANE_COUNT - 1; lane >= 0; lane--) {
+        const HTTPWorkQueueStats::Lane& laneStats = stats.lanes[lane];
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("depth", (uint64_t)laneStats.nDepth));
+        obj.push_back(Pair("limit", (uint64_t)laneStats.nLimit));
+        obj.push_back(Pair("maxdepth", (uint64_t)laneStats.nMaxDepth));
+        obj.push_back(Pair("queued", laneStats.nQueued));
+        obj.push_back(Pair("rejected", laneStats.nRejected));
+        obj.push_back(Pair("depth_histogram", HistogramToJSON(laneStats.vDepthHistogram)));
+        obj.push_back(Pair("wait_ms_histogram", HistogramToJSON(laneStats.vWaitHistogram)));
+        result.push_back(Pair(vLaneNames[lane], obj));
+    }
+    return result;
+}
+
 UniValue mnsync(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -559,6 +631,270 @@ bool getAddressesFromParams(const UniValue& params, std::vector<std::pair<uint16
     return true;
 }
 
+/**
+ * Read the optional "limit" and "cursor" of a paginated address index call.
+ * Returns false if the call is not paginated.
+ */
+template <typename Key>
+bool getPageFromParams(const UniValue& params, size_t& nLimit, bool& fCursor, Key& cursor)
+{
+    nLimit = 0;
+    fCursor = false;
+    if (!params[0].isObject()) {
+        return false;
+    }
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull()) {
+        if (!cursorValue.isNull()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "A cursor can only be used together with a limit");
+        }
+        return false;
+    }
+    if (!limitValue.isNum() || limitValue.get_int() <= 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be a positive number");
+    }
+    nLimit = limitValue.get_int();
+
+    if (!cursorValue.isNull()) {
+        if (!cursorValue.isStr() || !IsHex(cursorValue.get_str())) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        std::vector<unsigned char> data(ParseHex(cursorValue.get_str()));
+        CDataStream ssCursor(data, SER_DISK, CLIENT_VERSION);
+        try {
+            ssCursor >> cursor;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        if (!ssCursor.empty()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        fCursor = true;
+    }
+    return true;
+}
+
+template <typename Key>
+std::string getCursorHex(const Key& key)
+{
+    CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+    ssCursor << key;
+    return HexStr(ssCursor.begin(), ssCursor.end());
+}
+
+/** Keep the first of repeated addresses only */
+void removeDuplicateAddresses(std::vector<std::pair<uint160, int> > &addresses)
+{
+    std::set<std::pair<uint160, int> > setSeen;
+    std::vector<std::pair<uint160, int> > unique;
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (setSeen.insert(*it).second) {
+            unique.push_back(*it);
+        }
+    }
+    addresses.swap(unique);
+}
+
+/** Position of the address a cursor was taken from in the requested addresses */
+size_t getCursorAddressPosition(const std::vector<std::pair<uint160, int> > &addresses, unsigned int type, const uint160 &hashBytes)
+{
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (addresses[i].first == hashBytes && (unsigned int)addresses[i].second == type) {
+            return i;
+        }
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to the requested addresses");
+}
+
+/** Read the optional "start" and "end" block heights of an address index call */
+void getHeightRangeFromParams(const UniValue& params, int& start, int& end)
+{
+    start = 0;
+    end = 0;
+    if (!params[0].isObject()) {
+        return;
+    }
+
+    UniValue startValue = find_value(params[0].get_obj(), "start");
+    UniValue endValue = find_value(params[0].get_obj(), "end");
+    if (startValue.isNum() && endValue.isNum()) {
+        start = startValue.get_int();
+        end = endValue.get_int();
+    }
+}
+
+/**
+ * Open a merge cursor over addresses, positioned after pcursorKey if it is
+ * given. Repeated addresses are read once.
+ */
+CAddressIndexMergeCursor* openAddressIndexCursor(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                                                 const CAddressIndexKey* pcursorKey)
+{
+    std::vector<std::pair<uint160, int> > unique(addresses);
+    removeDuplicateAddresses(unique);
+    CAddressIndexMergeCursor* pcursor = NewAddressIndexMergeCursor(unique, start, end);
+    if (!pcursor) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+    if (pcursorKey && !pcursor->SeekAfter(*pcursorKey)) {
+        delete pcursor;
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor does not belong to the requested addresses");
+    }
+    return pcursor;
+}
+
+typedef boost::function<void (const UniValue&)> AddressIndexEmitter;
+
+static void pushToArray(UniValue& array, const UniValue& val)
+{
+    array.push_back(val);
+}
+
+/**
+ * Hand the deltas of an address index page to emit, at most nLimit of them
+ * if nLimit is not 0. Returns true if the page was cut short; lastKey is the
+ * last key emitted then.
+ */
+bool emitAddressDeltas(CAddressIndexMergeCursor& cursor, size_t nLimit, CAddressIndexKey& lastKey, const AddressIndexEmitter& emit)
+{
+    size_t nCount = 0;
+    for (; cursor.Valid(); cursor.Next()) {
+        if (nLimit && nCount == nLimit) {
+            return true;
+        }
+
+        const CAddressIndexKey& key = cursor.GetKey();
+        std::string address;
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        UniValue delta(UniValue::VOBJ);
+        delta.push_back(Pair("satoshis", cursor.GetValue()));
+        delta.push_back(Pair("txid", key.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)key.index));
+        delta.push_back(Pair("blockindex", (int)key.txindex));
+        delta.push_back(Pair("height", key.blockHeight));
+        delta.push_back(Pair("address", address));
+        emit(delta);
+        nCount++;
+        lastKey = key;
+    }
+    return false;
+}
+
+/** Same as emitAddressDeltas, for the txids of an address index page */
+bool emitAddressTxids(CAddressIndexMergeCursor& cursor, size_t nLimit, CAddressIndexKey& lastKey, const AddressIndexEmitter& emit)
+{
+    // Entries come in block order and all entries of a transaction are next
+    // to each other, so comparing with the previous txid removes duplicates.
+    // A page only ends between two transactions.
+    size_t nCount = 0;
+    uint256 lastTxid;
+    for (; cursor.Valid(); cursor.Next()) {
+        const CAddressIndexKey& key = cursor.GetKey();
+        if (nCount == 0 || key.txhash != lastTxid) {
+            if (nLimit && nCount == nLimit) {
+                return true;
+            }
+            emit(UniValue(key.txhash.GetHex()));
+            nCount++;
+            lastTxid = key.txhash;
+        }
+        lastKey = key;
+    }
+    return false;
+}
+
+/**
+ * Hand the deltas of addresses to emit as getaddressdeltas always returned
+ * them without a limit: grouped by address, in the order given.
+ */
+void emitAddressDeltasByAddress(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                                const AddressIndexEmitter& emit)
+{
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        std::vector<std::pair<uint160, int> > address(1, *it);
+        boost::scoped_ptr<CAddressIndexMergeCursor> pcursor(openAddressIndexCursor(address, start, end, NULL));
+        CAddressIndexKey lastKey;
+        emitAddressDeltas(*pcursor, 0, lastKey, emit);
+    }
+}
+
+/**
+ * Hand the txids of addresses to emit as getaddresstxids always returned
+ * them without a limit: in block order for a single address, otherwise
+ * sorted by height and then by txid.
+ */
+void emitAddressTxidsSorted(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                            const AddressIndexEmitter& emit)
+{
+    boost::scoped_ptr<CAddressIndexMergeCursor> pcursor(openAddressIndexCursor(addresses, start, end, NULL));
+    if (addresses.size() == 1) {
+        CAddressIndexKey lastKey;
+        emitAddressTxids(*pcursor, 0, lastKey, emit);
+        return;
+    }
+
+    // The cursor goes up in height, so only the txids of one height are held
+    std::set<std::string> setTxids;
+    int nHeight = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        const CAddressIndexKey& key = pcursor->GetKey();
+        if (key.blockHeight != nHeight) {
+            BOOST_FOREACH(const std::string& txid, setTxids)
+                emit(UniValue(txid));
+            setTxids.clear();
+            nHeight = key.blockHeight;
+        }
+        setTxids.insert(key.txhash.GetHex());
+    }
+    BOOST_FOREACH(const std::string& txid, setTxids)
+        emit(UniValue(txid));
+}
+
+/**
+ * One page of the deltas of addresses, in block order across the addresses,
+ * continuing after pcursorKey if it is given. The page holds at most nLimit
+ * deltas and a cursor if there are more.
+ */
+UniValue getAddressDeltasPage(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                              size_t nLimit, const CAddressIndexKey* pcursorKey)
+{
+    boost::scoped_ptr<CAddressIndexMergeCursor> pcursor(openAddressIndexCursor(addresses, start, end, pcursorKey));
+
+    UniValue deltas(UniValue::VARR);
+    CAddressIndexKey lastKey;
+    bool fMore = emitAddressDeltas(*pcursor, nLimit, lastKey, boost::bind(&pushToArray, boost::ref(deltas), _1));
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("deltas", deltas));
+    if (fMore) {
+        result.push_back(Pair("cursor", getCursorHex(lastKey)));
+    }
+    return result;
+}
+
+/** Same as getAddressDeltasPage, for the txids of addresses */
+UniValue getAddressTxidsPage(const std::vector<std::pair<uint160, int> > &addresses, int start, int end,
+                             size_t nLimit, const CAddressIndexKey* pcursorKey)
+{
+    boost::scoped_ptr<CAddressIndexMergeCursor> pcursor(openAddressIndexCursor(addresses, start, end, pcursorKey));
+
+    UniValue txids(UniValue::VARR);
+    CAddressIndexKey lastKey;
+    bool fMore = emitAddressTxids(*pcursor, nLimit, lastKey, boost::bind(&pushToArray, boost::ref(txids), _1));
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("txids", txids));
+    if (fMore) {
+        result.push_back(Pair("cursor", getCursorHex(lastKey)));
+    }
+    return result;
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -653,6 +989,8 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return at most this many outputs, in index order\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous call\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -665,8 +1003,14 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"satoshis\"  (number) The number of satoshis of the output\n"
             "  }\n"
             "]\n"
+            "\nResult with a limit:\n"
+            "{\n"
+            "  \"utxos\"  (array) The outputs as above\n"
+            "  \"cursor\"  (string) Only present if there may be more outputs; pass it to the next call\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -676,15 +1020,33 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit = 0;
+    bool fCursor = false;
+    CAddressUnspentKey cursorKey;
+    bool fPaginate = getPageFromParams(params, nLimit, fCursor, cursorKey);
+    if (fPaginate) {
+        // A cursor names its address, which has to come up once only
+        removeDuplicateAddresses(addresses);
+    }
+    size_t nFirst = fCursor ? getCursorAddressPosition(addresses, cursorKey.type, cursorKey.hashBytes) : 0;
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+    for (size_t i = nFirst; i < addresses.size(); i++) {
+        const CAddressUnspentKey* pkeyAfter = (fCursor && i == nFirst) ? &cursorKey : NULL;
+        size_t nRemaining = fPaginate ? nLimit - unspentOutputs.size() : 0;
+        if (!GetAddressUnspent(addresses[i].first, addresses[i].second, unspentOutputs, pkeyAfter, nRemaining)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+        if (fPaginate && unspentOutputs.size() >= nLimit) {
+            break;
+        }
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    // Pages are returned in index order, so that the cursor can resume them
+    if (!fPaginate) {
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue result(UniValue::VARR);
 
@@ -704,6 +1066,15 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
+    if (fPaginate) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("utxos", result));
+        if (unspentOutputs.size() >= nLimit) {
+            page.push_back(Pair("cursor", getCursorHex(unspentOutputs.back().first)));
+        }
+        return page;
+    }
+
     return result;
 }
 
@@ -722,6 +1093,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many deltas, in block order across the addresses\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous call\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -733,24 +1106,23 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult with a limit:\n"
+            "{\n"
+            "  \"deltas\"  (array) The deltas as above\n"
+            "  \"cursor\"  (string) Only present if there are more deltas; pass it to the next call\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
 
-    UniValue startValue = find_value(params[0].get_obj(), "start");
-    UniValue endValue = find_value(params[0].get_obj(), "end");
-
     int start = 0;
     int end = 0;
-
-    if (startValue.isNum() && endValue.isNum()) {
-        start = startValue.get_int();
-        end = endValue.get_int();
-        if (end < start) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
-        }
+    getHeightRangeFromParams(params, start, end);
+    if (end < start) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
     }
 
     std::vector<std::pair<uint160, int> > addresses;
@@ -759,39 +1131,50 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    size_t nLimit = 0;
+    bool fCursor = false;
+    CAddressIndexKey cursorKey;
+    if (getPageFromParams(params, nLimit, fCursor, cursorKey)) {
+        return getAddressDeltasPage(addresses, start, end, nLimit, fCursor ? &cursorKey : NULL);
     }
 
     UniValue result(UniValue::VARR);
+    emitAddressDeltasByAddress(addresses, start, end, boost::bind(&pushToArray, boost::ref(result), _1));
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
+    return result;
+}
 
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
+bool getaddressdeltas_stream(const UniValue& params, UniValueStreamWriter& writer)
+{
+    if (params.size() != 1 || !params[0].isObject())
+        return false;
+
+    int start = 0;
+    int end = 0;
+    getHeightRangeFromParams(params, start, end);
+    if (end < start) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
     }
 
-    return result;
+    std::vector<std::pair<uint160, int> > addresses;
+
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    // A page is bounded by its limit and not worth streaming
+    size_t nLimit = 0;
+    bool fCursor = false;
+    CAddressIndexKey cursorKey;
+    if (getPageFromParams(params, nLimit, fCursor, cursorKey)) {
+        writer.value(getAddressDeltasPage(addresses, start, end, nLimit, fCursor ? &cursorKey : NULL));
+        return true;
+    }
+
+    writer.beginArray();
+    emitAddressDeltasByAddress(addresses, start, end, boost::bind(&UniValueStreamWriter::value, &writer, _1));
+    writer.endArray();
+    return true;
 }
 
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
@@ -865,14 +1248,22 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many txids, in block order\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous call\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult with a limit:\n"
+            "{\n"
+            "  \"txids\"  (array) The txids as above\n"
+            "  \"cursor\"  (string) Only present if there are more txids; pass it to the next call\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -884,53 +1275,49 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
 
     int start = 0;
     int end = 0;
-    if (params[0].isObject()) {
-        UniValue startValue = find_value(params[0].get_obj(), "start");
-        UniValue endValue = find_value(params[0].get_obj(), "end");
-        if (startValue.isNum() && endValue.isNum()) {
-            start = startValue.get_int();
-            end = endValue.get_int();
-        }
-    }
+    getHeightRangeFromParams(params, start, end);
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
+    size_t nLimit = 0;
+    bool fCursor = false;
+    CAddressIndexKey cursorKey;
+    if (getPageFromParams(params, nLimit, fCursor, cursorKey)) {
+        return getAddressTxidsPage(addresses, start, end, nLimit, fCursor ? &cursorKey : NULL);
     }
 
-    std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
+    emitAddressTxidsSorted(addresses, start, end, boost::bind(&pushToArray, boost::ref(result), _1));
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
+    return result;
+}
 
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
-        }
-    }
+bool getaddresstxids_stream(const UniValue& params, UniValueStreamWriter& writer)
+{
+    if (params.size() != 1)
+        return false;
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
-        }
+    std::vector<std::pair<uint160, int> > addresses;
+
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    return result;
+    int start = 0;
+    int end = 0;
+    getHeightRangeFromParams(params, start, end);
+
+    // A page is bounded by its limit and not worth streaming
+    size_t nLimit = 0;
+    bool fCursor = false;
+    CAddressIndexKey cursorKey;
+    if (getPageFromParams(params, nLimit, fCursor, cursorKey)) {
+        writer.value(getAddressTxidsPage(addresses, start, end, nLimit, fCursor ? &cursorKey : NULL));
+        return true;
+    }
 
+    writer.beginArray();
+    emitAddressTxidsSorted(addresses, start, end, boost::bind(&UniValueStreamWriter::value, &writer, _1));
+    writer.endArray();
+    return true;
 }
 
 UniValue getspentinfo(const UniValue& params, bool fHelp)
@@ -17,6 +17,8 @@
 
 #include <univalue.h>
 
+#include <list>
+
 #include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
@@ -255,11 +257,12 @@ UniValue stop(const UniValue& params, bool fHelp)
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode streamActor (optional)
+  //  --------------------- ------------------------  -----------------------  ---------- ----------------------
     /* Overall control/query calls */
     { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
     { "control",            "debug",                  &debug,                  true  },
+    { "control",            "gethttpqueueinfo",       &gethttpqueueinfo,       true  },
     { "control",            "help",                   &help,                   true  },
     { "control",            "stop",                   &stop,                   true  },
 
@@ -280,7 +283,7 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
     { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
+    { "blockchain",         "getblock",               &getblock,               true,  &getblock_stream },
     { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
     { "blockchain",         "getblockhash",           &getblockhash,           true  },
     { "blockchain",         "getblockheader",         &getblockheader,         true  },
@@ -288,7 +291,7 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,  &getrawmempool_stream },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
@@ -323,8 +326,8 @@ static const CRPCCommand vRPCCommands[] =
     /* Address index */
     { "addressindex",       "getaddressmempool",      &getaddressmempool,      true  },
     { "addressindex",       "getaddressutxos",        &getaddressutxos,        false },
-    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false },
-    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false },
+    { "addressindex",       "getaddressdeltas",       &getaddressdeltas,       false, &getaddressdeltas_stream },
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        false, &getaddresstxids_stream },
     { "addressindex",       "getaddressbalance",      &getaddressbalance,      false },
 
     /* Utility functions */
@@ -355,6 +358,7 @@ static const CRPCCommand vRPCCommands[] =
     { "dash",               "mnsync",                 &mnsync,                 true  },
     { "dash",               "spork",                  &spork,                  true  },
     { "dash",               "getpoolinfo",            &getpoolinfo,            true  },
+    { "dash",               "getinstantsendinfo",     &getinstantsendinfo,     true  },
 #ifdef ENABLE_WALLET
     { "dash",               "privatesend",            &privatesend,            false },
 
@@ -383,6 +387,7 @@ static const CRPCCommand vRPCCommands[] =
     { "wallet",             "importelectrumwallet",   &importelectrumwallet,   true  },
     { "wallet",             "importaddress",          &importaddress,          true  },
     { "wallet",             "importpubkey",           &importpubkey,           true  },
+    { "wallet",             "abortrescan",            &abortrescan,            true  },
     { "wallet",             "keypoolrefill",          &keypoolrefill,          true  },
     { "wallet",             "listaccounts",           &listaccounts,           false },
     { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false },
@@ -528,16 +533,159 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+/**
+ * A JSON-RPC batch whose calls are being run. Batch threads and the HTTP
+ * worker that received the batch take its calls one at a time, and write the
+ * replies to per-call slots so they are returned in request order.
+ */
+class CRPCBatch
+{
+public:
+    const UniValue& vReq;
+    std::vector<UniValue> vReplies;
+    //! Next call to be taken
+    unsigned int nNext;
+    //! Calls being run by batch threads
+    int nRunning;
+
+    CRPCBatch(const UniValue& vReqIn) : vReq(vReqIn), vReplies(vReqIn.size()), nNext(0), nRunning(0) {}
+
+    bool HasCallsLeft() const { return nNext < vReq.size(); }
+};
+
+int nRPCBatchThreads = 0;
+
+/** Guards the batches below and their call counters */
+static boost::mutex csRPCBatches;
+/** Batch threads wait here for calls */
+static boost::condition_variable condRPCBatchWork;
+/** HTTP workers wait here for the calls of their batch taken by batch threads */
+static boost::condition_variable condRPCBatchDone;
+/** Batches with calls left; all batch threads serve all of them */
+static std::list<CRPCBatch*> listRPCBatches;
+
+/**
+ * Take a call for a batch thread, from the first batch that has fewer than
+ * nRPCBatchThreads calls running. That batch goes to the back of the list so
+ * that concurrent batches share the threads. csRPCBatches must be held.
+ */
+static CRPCBatch* TakeRPCBatchCall(unsigned int& nCall)
+{
+    for (std::list<CRPCBatch*>::iterator it = listRPCBatches.begin(); it != listRPCBatches.end(); ++it) {
+        CRPCBatch* pbatch = *it;
+        // The HTTP worker of the batch runs one call as well
+        if (pbatch->nRunning + 1 >= nRPCBatchThreads)
+            continue;
+        nCall = pbatch->nNext++;
+        pbatch->nRunning++;
+        listRPCBatches.erase(it);
+        if (pbatch->HasCallsLeft())
+            listRPCBatches.push_back(pbatch);
+        return pbatch;
+    }
+    return NULL;
+}
+
+static void FinishRPCBatchCall(CRPCBatch* pbatch)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csRPCBatches);
+        pbatch->nRunning--;
+    }
+    condRPCBatchDone.notify_all();
+    // The batch may take another call now
+    condRPCBatchWork.notify_one();
+}
+
+void ThreadRPCBatch()
+{
+    RenameThread("sibcoin-rpcbatch");
+    while (true) {
+        CRPCBatch* pbatch;
+        unsigned int nCall;
+        {
+            boost::unique_lock<boost::mutex> lock(csRPCBatches);
+            while (!(pbatch = TakeRPCBatchCall(nCall)))
+                condRPCBatchWork.wait(lock);
+        }
+        try {
+            pbatch->vReplies[nCall] = JSONRPCExecOne(pbatch->vReq[nCall]);
+        } catch (...) {
+            FinishRPCBatchCall(pbatch);
+            throw;
+        }
+        FinishRPCBatchCall(pbatch);
+    }
+}
+
+/**
+ * Publishes a batch to the batch threads for as long as it is in scope, and
+ * waits for the calls they took before the batch goes away.
+ */
+class CRPCBatchScope
+{
+private:
+    CRPCBatch& batch;
+
+public:
+    CRPCBatchScope(CRPCBatch& batchIn) : batch(batchIn)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csRPCBatches);
+            listRPCBatches.push_back(&batch);
+        }
+        condRPCBatchWork.notify_all();
+    }
+
+    ~CRPCBatchScope()
+    {
+        boost::this_thread::disable_interruption di;
+        boost::unique_lock<boost::mutex> lock(csRPCBatches);
+        listRPCBatches.remove(&batch);
+        while (batch.nRunning)
+            condRPCBatchDone.wait(lock);
+    }
+
+    //! Take the next call for the HTTP worker, false once all were taken
+    bool TakeCall(unsigned int& nCall)
+    {
+        boost::unique_lock<boost::mutex> lock(csRPCBatches);
+        if (!batch.HasCallsLeft())
+            return false;
+        nCall = batch.nNext++;
+        if (!batch.HasCallsLeft())
+            listRPCBatches.remove(&batch);
+        return true;
+    }
+};
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
     UniValue ret(UniValue::VARR);
+
+    if (nRPCBatchThreads && vReq.size() > 1) {
+        CRPCBatch batch(vReq);
+        {
+            // The HTTP worker runs calls too, so a batch never waits for a
+            // free batch thread to make progress
+            CRPCBatchScope scope(batch);
+            unsigned int nCall;
+            while (scope.TakeCall(nCall))
+                batch.vReplies[nCall] = JSONRPCExecOne(vReq[nCall]);
+        }
+
+        for (unsigned int reqIdx = 0; reqIdx < batch.vReplies.size(); reqIdx++)
+            ret.push_back(batch.vReplies[reqIdx]);
+        return ret.write() + "\n";
+    }
+
     for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
         ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
 
     return ret.write() + "\n";
 }
 
-UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
+void CRPCTable::dispatch(const std::string &strMethod, const UniValue &params, UniValue* pResult, UniValueStreamWriter* pWriter) const
 {
     // Return immediately if in warmup
     {
@@ -556,7 +704,10 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     try
     {
         // Execute
-        return pcmd->actor(params, false);
+        if (!pWriter)
+            *pResult = pcmd->actor(params, false);
+        else if (!pcmd->streamActor || !pcmd->streamActor(params, *pWriter))
+            pWriter->value(pcmd->actor(params, false));
     }
     catch (const std::exception& e)
     {
@@ -566,6 +717,18 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
+{
+    UniValue result;
+    dispatch(strMethod, params, &result, NULL);
+    return result;
+}
+
+void CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, UniValueStreamWriter& writer) const
+{
+    dispatch(strMethod, params, NULL, &writer);
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
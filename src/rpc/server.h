@@ -32,6 +32,11 @@ namespace RPCServer
 class CBlockIndex;
 class CNetAddr;
 
+/** Default for -rpcbatchthreads, the number of calls of one JSON-RPC batch run at once */
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+/** Maximum number of calls of a JSON-RPC batch run at once */
+static const int MAX_RPC_BATCH_THREADS = 16;
+
 class JSONRequest
 {
 public:
@@ -113,6 +118,13 @@ void RPCRunLater(const std::string& name, boost::function<void(void)> func, int6
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
 
+/**
+ * Writes the result of a call straight to writer instead of returning it.
+ * Returns false without writing anything to leave the call to the regular
+ * actor, e.g. for invalid parameters or small results.
+ */
+typedef bool(*rpcstreamfn_type)(const UniValue& params, UniValueStreamWriter& writer);
+
 class CRPCCommand
 {
 public:
@@ -120,6 +132,7 @@ public:
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
+    rpcstreamfn_type streamActor; //!< optional, for methods with very large results
 };
 
 /**
@@ -129,6 +142,10 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+
+    /** Common part of execute() and executeStream(): the result goes to
+     * pWriter if it is set and to pResult otherwise */
+    void dispatch(const std::string &method, const UniValue &params, UniValue* pResult, UniValueStreamWriter* pWriter) const;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -143,6 +160,15 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method and write its result to writer. Methods with a
+     * streaming actor write their result piece by piece, all others are
+     * executed as by execute() and the result is written as a whole.
+     * @throws an exception (UniValue) when an error happens. Part of the
+     * result may have been written already in that case.
+     */
+    void executeStream(const std::string &method, const UniValue &params, UniValueStreamWriter& writer) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -176,6 +202,8 @@ extern UniValue getaddressmempool(const UniValue& params, bool fHelp);
 extern UniValue getaddressutxos(const UniValue& params, bool fHelp);
 extern UniValue getaddressdeltas(const UniValue& params, bool fHelp);
 extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
+extern bool getaddressdeltas_stream(const UniValue& params, UniValueStreamWriter& writer);
+extern bool getaddresstxids_stream(const UniValue& params, UniValueStreamWriter& writer);
 extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
 
 extern UniValue getpeerinfo(const UniValue& params, bool fHelp);
@@ -195,6 +223,7 @@ extern UniValue importpubkey(const UniValue& params, bool fHelp);
 extern UniValue dumpwallet(const UniValue& params, bool fHelp);
 extern UniValue importwallet(const UniValue& params, bool fHelp);
 extern UniValue importelectrumwallet(const UniValue& params, bool fHelp);
+extern UniValue abortrescan(const UniValue& params, bool fHelp);
 
 extern UniValue getgenerate(const UniValue& params, bool fHelp); // in rpc/mining.cpp
 extern UniValue setgenerate(const UniValue& params, bool fHelp);
@@ -247,6 +276,7 @@ extern UniValue encryptwallet(const UniValue& params, bool fHelp);
 extern UniValue validateaddress(const UniValue& params, bool fHelp);
 extern UniValue getinfo(const UniValue& params, bool fHelp);
 extern UniValue debug(const UniValue& params, bool fHelp);
+extern UniValue gethttpqueueinfo(const UniValue& params, bool fHelp);
 extern UniValue getwalletinfo(const UniValue& params, bool fHelp);
 extern UniValue getblockchaininfo(const UniValue& params, bool fHelp);
 extern UniValue getnetworkinfo(const UniValue& params, bool fHelp);
@@ -268,6 +298,7 @@ extern UniValue verifytxoutproof(const UniValue& params, bool fHelp);
 
 extern UniValue privatesend(const UniValue& params, bool fHelp);
 extern UniValue getpoolinfo(const UniValue& params, bool fHelp);
+extern UniValue getinstantsendinfo(const UniValue& params, bool fHelp);
 extern UniValue spork(const UniValue& params, bool fHelp);
 extern UniValue masternode(const UniValue& params, bool fHelp);
 extern UniValue masternodelist(const UniValue& params, bool fHelp);
@@ -284,11 +315,13 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern bool getrawmempool_stream(const UniValue& params, UniValueStreamWriter& writer);
 extern UniValue getblockhashes(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue getblockheaders(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
+extern bool getblock_stream(const UniValue& params, UniValueStreamWriter& writer);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
@@ -302,4 +335,9 @@ void InterruptRPC();
 void StopRPC();
 std::string JSONRPCExecBatch(const UniValue& vReq);
 
+/** Number of calls of one batch run at once, including the HTTP worker (0 = serial) */
+extern int nRPCBatchThreads;
+/** Worker thread for the calls of JSON-RPC batches, shared by all batches */
+void ThreadRPCBatch();
+
 #endif // BITCOIN_RPCSERVER_H
@@ -5,103 +5,255 @@
 
 #include "sigcache.h"
 
-#include "memusage.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
-#include <boost/unordered_set.hpp>
+#include <algorithm>
+#include <limits>
+#include <new>
+#include <string.h>
 
-namespace {
+static const size_t CACHE_LINE_SIZE = 64;
 
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- */
-class CSignatureCacheHasher
+struct CSignatureCache::CSlot
 {
-public:
-    size_t operator()(const uint256& key) const {
-        return key.GetCheapHash();
-    }
+    //! Odd while a writer owns the slot
+    std::atomic<uint32_t> nSeq;
+    //! Generation the entry was stored in, 0 for an empty slot
+    std::atomic<uint32_t> nGeneration;
+    std::atomic<uint64_t> vEntry[4];
+    unsigned char padding[CACHE_LINE_SIZE - 40];
+
+    CSlot() : nSeq(0), nGeneration(0) {}
+};
+
+struct CSignatureCache::CStatsShard
+{
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+    std::atomic<uint64_t> nInserts;
+    std::atomic<uint64_t> nEvictions;
+    unsigned char padding[CACHE_LINE_SIZE - 32];
+
+    CStatsShard() : nHits(0), nMisses(0), nInserts(0), nEvictions(0) {}
 };
 
-/**
- * Valid signature cache, to avoid doing expensive ECDSA signature checking
- * twice for every transaction (once when accepted into memory pool, and
- * again when accepted into the block chain)
- */
-class CSignatureCache
-{
-private:
-     //! Entries are SHA256(nonce || signature hash || public key || signature):
-    uint256 nonce;
-    typedef boost::unordered_set<uint256, CSignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
-
-
-public:
-    CSignatureCache()
-    {
-        GetRandBytes(nonce.begin(), 32);
+CSignatureCache::CSignatureCache(size_t nMaxSizeBytes) : slots(NULL), nSlots(0), nGeneration(1), nGenerationInserts(0)
+{
+    static_assert(sizeof(CSlot) == CACHE_LINE_SIZE, "signature cache slots must fill a cache line");
+
+    GetRandBytes(nonce.begin(), 32);
+
+    // A power of two number of slots, so positions are a mask away
+    if (nMaxSizeBytes >= 2 * sizeof(CSlot)) {
+        nSlots = 2;
+        while (nSlots * 2 * sizeof(CSlot) <= nMaxSizeBytes)
+            nSlots *= 2;
+        vMemory.resize((nSlots + 1) * sizeof(CSlot));
+        uintptr_t nAligned = ((uintptr_t)&vMemory[0] + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1);
+        slots = reinterpret_cast<CSlot*>(nAligned);
+        for (size_t i = 0; i < nSlots; i++)
+            new (&slots[i]) CSlot();
     }
+    stats = new CStatsShard[STATS_SHARDS];
+}
+
+CSignatureCache::~CSignatureCache()
+{
+    delete[] stats;
+}
+
+void CSignatureCache::ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+{
+    CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
+}
+
+void CSignatureCache::GetPositions(const uint64_t vEntry[4], size_t vPos[2]) const
+{
+    // Entries are salted hashes already, their own bits are good enough
+    vPos[0] = vEntry[0] & (nSlots - 1);
+    vPos[1] = vEntry[1] & (nSlots - 1);
+    if (vPos[1] == vPos[0])
+        vPos[1] ^= 1;
+}
+
+CSignatureCache::CStatsShard& CSignatureCache::GetStatsShard(const uint64_t vEntry[4])
+{
+    return stats[vEntry[2] % STATS_SHARDS];
+}
+
+bool CSignatureCache::ReadSlot(size_t nPos, uint64_t vEntry[4], uint32_t& nGenerationRet, uint32_t& nSeqRet) const
+{
+    const CSlot& slot = slots[nPos];
+    nSeqRet = slot.nSeq.load(std::memory_order_acquire);
+    if (nSeqRet & 1)
+        return false;
+    nGenerationRet = slot.nGeneration.load(std::memory_order_relaxed);
+    for (int i = 0; i < 4; i++)
+        vEntry[i] = slot.vEntry[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.nSeq.load(std::memory_order_relaxed) == nSeqRet;
+}
+
+bool CSignatureCache::LockSlot(size_t nPos, uint32_t nSeq)
+{
+    if (!slots[nPos].nSeq.compare_exchange_strong(nSeq, nSeq + 1, std::memory_order_acquire))
+        return false;
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void CSignatureCache::UnlockSlot(size_t nPos, uint32_t nSeq)
+{
+    slots[nPos].nSeq.store(nSeq + 2, std::memory_order_release);
+}
+
+bool CSignatureCache::Get(const uint256& entry, bool fErase)
+{
+    if (nSlots == 0)
+        return false;
+
+    uint64_t vKey[4];
+    memcpy(vKey, entry.begin(), sizeof(vKey));
+    CStatsShard& shard = GetStatsShard(vKey);
+    size_t vPos[2];
+    GetPositions(vKey, vPos);
 
-    void
-    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey)
-    {
-        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(&pubkey[0], pubkey.size()).Write(&vchSig[0], vchSig.size()).Finalize(entry.begin());
+    for (int i = 0; i < 2; i++) {
+        uint64_t vSlot[4];
+        uint32_t nSlotGeneration, nSeq;
+        // a slot being written counts as a miss, the caller just verifies again
+        if (!ReadSlot(vPos[i], vSlot, nSlotGeneration, nSeq) || nSlotGeneration == 0 || memcmp(vSlot, vKey, sizeof(vKey)) != 0)
+            continue;
+        // if the slot changed since we read it, the entry is gone already
+        if (fErase && LockSlot(vPos[i], nSeq)) {
+            slots[vPos[i]].nGeneration.store(0, std::memory_order_relaxed);
+            UnlockSlot(vPos[i], nSeq);
+        }
+        shard.nHits.fetch_add(1, std::memory_order_relaxed);
+        return true;
     }
 
-    bool
-    Get(const uint256& entry)
-    {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.count(entry);
+    shard.nMisses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void CSignatureCache::Set(const uint256& entry)
+{
+    if (nSlots == 0)
+        return;
+
+    uint64_t vKey[4];
+    memcpy(vKey, entry.begin(), sizeof(vKey));
+    CStatsShard& shard = GetStatsShard(vKey);
+    const uint32_t nCurrentGeneration = nGeneration.load(std::memory_order_relaxed);
+    uint32_t nKeyGeneration = nCurrentGeneration;
+    size_t vPos[2];
+    GetPositions(vKey, vPos);
+
+    // Take whichever of the two slots is empty or holds the oldest entry
+    size_t nPos = 0;
+    uint32_t nSeq = 0;
+    uint32_t nOldest = std::numeric_limits<uint32_t>::max();
+    bool fFound = false;
+    for (int i = 0; i < 2; i++) {
+        uint64_t vSlot[4];
+        uint32_t nSlotGeneration, nSlotSeq;
+        if (!ReadSlot(vPos[i], vSlot, nSlotGeneration, nSlotSeq))
+            continue;
+        if (nSlotGeneration != 0 && memcmp(vSlot, vKey, sizeof(vKey)) == 0)
+            return;
+        if (!fFound || nSlotGeneration < nOldest) {
+            nPos = vPos[i];
+            nSeq = nSlotSeq;
+            nOldest = nSlotGeneration;
+            fFound = true;
+        }
     }
+    // both slots are being written right now, don't wait for them
+    if (!fFound)
+        return;
 
-    void Erase(const uint256& entry)
-    {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.erase(entry);
+    shard.nInserts.fetch_add(1, std::memory_order_relaxed);
+    const uint32_t nGenerationSize = std::max<size_t>(1, nSlots / 4);
+    if (nGenerationInserts.fetch_add(1, std::memory_order_relaxed) + 1 == nGenerationSize) {
+        nGenerationInserts.fetch_sub(nGenerationSize, std::memory_order_relaxed);
+        nGeneration.fetch_add(1, std::memory_order_relaxed);
     }
 
-    void Set(const uint256& entry)
-    {
-        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
-        {
-            map_type::size_type s = GetRand(setValid.bucket_count());
-            map_type::local_iterator it = setValid.begin(s);
-            if (it != setValid.end(s)) {
-                setValid.erase(*it);
-            }
+    for (unsigned int nKicks = 0; ; nKicks++) {
+        if (!LockSlot(nPos, nSeq)) {
+            // the new entry is simply not stored, a kicked out one is lost
+            if (nKicks == 0)
+                return;
+            break;
+        }
+        CSlot& slot = slots[nPos];
+        uint64_t vVictim[4];
+        uint32_t nVictimGeneration = slot.nGeneration.load(std::memory_order_relaxed);
+        for (int i = 0; i < 4; i++) {
+            vVictim[i] = slot.vEntry[i].load(std::memory_order_relaxed);
+            slot.vEntry[i].store(vKey[i], std::memory_order_relaxed);
         }
+        slot.nGeneration.store(nKeyGeneration, std::memory_order_relaxed);
+        UnlockSlot(nPos, nSeq);
 
-        setValid.insert(entry);
+        // empty, or older than the previous generation: nothing worth keeping
+        if (nVictimGeneration == 0 || nVictimGeneration + 2 <= nCurrentGeneration)
+            return;
+        if (nKicks == MAX_KICKS)
+            break;
+
+        // move the live entry we replaced to its other slot
+        memcpy(vKey, vVictim, sizeof(vKey));
+        nKeyGeneration = nVictimGeneration;
+        GetPositions(vKey, vPos);
+        nPos = vPos[0] == nPos ? vPos[1] : vPos[0];
+        uint64_t vSlot[4];
+        uint32_t nSlotGeneration;
+        if (!ReadSlot(nPos, vSlot, nSlotGeneration, nSeq))
+            break;
     }
-};
+    shard.nEvictions.fetch_add(1, std::memory_order_relaxed);
+}
 
+CSignatureCacheStats CSignatureCache::GetStats() const
+{
+    CSignatureCacheStats result;
+    result.nHits = result.nMisses = result.nInserts = result.nEvictions = 0;
+    for (unsigned int i = 0; i < STATS_SHARDS; i++) {
+        result.nHits += stats[i].nHits.load(std::memory_order_relaxed);
+        result.nMisses += stats[i].nMisses.load(std::memory_order_relaxed);
+        result.nInserts += stats[i].nInserts.load(std::memory_order_relaxed);
+        result.nEvictions += stats[i].nEvictions.load(std::memory_order_relaxed);
+    }
+    result.nGeneration = nGeneration.load(std::memory_order_relaxed);
+    result.nSlots = nSlots;
+    return result;
+}
+
+static CSignatureCache& GetSignatureCache()
+{
+    static CSignatureCache signatureCache(std::max<int64_t>(0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)) * ((size_t) 1 << 20));
+    return signatureCache;
+}
+
+CSignatureCacheStats GetSignatureCacheStats()
+{
+    return GetSignatureCache().GetStats();
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = GetSignatureCache();
 
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
 
-    if (signatureCache.Get(entry)) {
-        if (!store) {
-            signatureCache.Erase(entry);
-        }
+    if (signatureCache.Get(entry, !store))
         return true;
-    }
 
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -7,7 +7,9 @@
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
 #include "script/interpreter.h"
+#include "uint256.h"
 
+#include <atomic>
 #include <vector>
 
 // DoS prevention: limit cache size to less than 40MB (over 500000
@@ -16,6 +18,78 @@ static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
 
 class CPubKey;
 
+/** Counters of a CSignatureCache since it was created */
+struct CSignatureCacheStats
+{
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nInserts;
+    //! Entries of the current or previous generation dropped to make room
+    uint64_t nEvictions;
+    uint32_t nGeneration;
+    size_t nSlots;
+};
+
+/**
+ * Valid signature cache, to avoid doing expensive ECDSA signature checking
+ * twice for every transaction (once when accepted into memory pool, and
+ * again when accepted into the block chain).
+ *
+ * A fixed table of cache-line sized slots, each entry living in one of two
+ * slots picked from its bits (cuckoo hashing). Readers never block: a slot is
+ * read under a per-slot sequence counter and a torn read counts as a miss.
+ * Writers claim a single slot at a time and give up instead of waiting, which
+ * is fine for a cache. Entries are tagged with a generation which advances
+ * every quarter table of inserts; entries two generations old are replaced
+ * first, live ones are kicked to their other slot a few times before being
+ * dropped.
+ */
+class CSignatureCache
+{
+private:
+    struct CSlot;
+    struct CStatsShard;
+
+    static const unsigned int STATS_SHARDS = 16;
+    static const unsigned int MAX_KICKS = 8;
+
+    //! Entries are SHA256(nonce || signature hash || public key || signature):
+    uint256 nonce;
+    std::vector<unsigned char> vMemory;
+    CSlot* slots;
+    size_t nSlots;
+    std::atomic<uint32_t> nGeneration;
+    //! Inserts since the generation last advanced
+    std::atomic<uint32_t> nGenerationInserts;
+    CStatsShard* stats;
+
+    bool ReadSlot(size_t nPos, uint64_t vEntry[4], uint32_t& nGenerationRet, uint32_t& nSeqRet) const;
+    //! Take a slot for writing, if it is still at the (even) sequence nSeq
+    bool LockSlot(size_t nPos, uint32_t nSeq);
+    void UnlockSlot(size_t nPos, uint32_t nSeq);
+    void GetPositions(const uint64_t vEntry[4], size_t vPos[2]) const;
+    CStatsShard& GetStatsShard(const uint64_t vEntry[4]);
+
+    CSignatureCache(const CSignatureCache&);
+    CSignatureCache& operator=(const CSignatureCache&);
+
+public:
+    //! Create a cache using at most nMaxSizeBytes, 0 disables it
+    explicit CSignatureCache(size_t nMaxSizeBytes);
+    ~CSignatureCache();
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const;
+
+    //! Look up an entry, optionally erasing it when found
+    bool Get(const uint256& entry, bool fErase = false);
+    void Set(const uint256& entry);
+
+    CSignatureCacheStats GetStats() const;
+};
+
+/** Counters of the cache used by CachingTransactionSignatureChecker */
+CSignatureCacheStats GetSignatureCacheStats();
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -9,6 +9,8 @@
 #include "net.h"
 #include "utilstrencodings.h"
 
+#include <atomic>
+
 class CSporkMessage;
 class CSporkManager;
 
@@ -18,6 +20,7 @@ class CSporkManager;
 */
 static const int SPORK_START                                            = 10001;
 static const int SPORK_END                                              = 10013;
+static const int SPORK_COUNT                                            = SPORK_END - SPORK_START + 1;
 
 static const int SPORK_2_INSTANTSEND_ENABLED                            = 10001;
 static const int SPORK_3_INSTANTSEND_BLOCK_FILTERING                    = 10002;
@@ -98,20 +101,35 @@ public:
 class CSporkManager
 {
 private:
+    // protects mapSporks and mapSporksActive
+    mutable CCriticalSection cs;
     std::vector<unsigned char> vchSig;
     std::string strMasterPrivKey;
     std::map<int, CSporkMessage> mapSporksActive;
+    /**
+     * Current value of every spork in [SPORK_START, SPORK_END], defaults
+     * included, so that IsSporkActive and GetSporkValue are a single atomic
+     * load which does not race with incoming sporks.
+     */
+    std::atomic<int64_t> vSporkValues[SPORK_COUNT];
+
+    /// Store a new active spork, publish its value and notify listeners
+    void SetSporkActive(const CSporkMessage& spork);
 
 public:
 
-    CSporkManager() {}
+    CSporkManager();
 
     void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     void ExecuteSpork(int nSporkID, int nValue);
     bool UpdateSpork(int nSporkID, int64_t nValue);
 
-    bool IsSporkActive(int nSporkID);
-    int64_t GetSporkValue(int nSporkID);
+    bool AlreadyHave(const uint256& hash) const;
+    bool GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet) const;
+
+    bool IsSporkActive(int nSporkID) const;
+    int64_t GetSporkValue(int nSporkID) const;
+    static int64_t GetSporkDefaultValue(int nSporkID);
     int GetSporkIDByName(std::string strName);
     std::string GetSporkNameByID(int nSporkID);
 
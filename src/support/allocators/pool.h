@@ -0,0 +1,203 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <memory>
+#include <new>
+#include <vector>
+
+/**
+ * A memory resource for node based containers with many small, equally sized
+ * allocations, such as the boost::unordered_map behind CCoinsMap.
+ *
+ * Memory is carved out of large chunks with a bump pointer. Freed blocks are
+ * kept in per-size free lists and reused for the next allocation of the same
+ * size; chunks are only returned to the system when the resource is destroyed.
+ * Requests bigger than MAX_BLOCK_SIZE_BYTES (e.g. the bucket array of a hash
+ * map) are passed through to ::operator new.
+ *
+ * All sizes are rounded up to a multiple of ALIGN_BYTES, which must be a power
+ * of two and at least the size of a pointer.
+ */
+template <size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class CPoolResource
+{
+private:
+    struct ListNode {
+        ListNode* pNext;
+    };
+
+    static const size_t NUM_FREE_LISTS = MAX_BLOCK_SIZE_BYTES / ALIGN_BYTES + 1;
+
+    //! size of each chunk requested from the system
+    const size_t nChunkSizeBytes;
+
+    //! all chunks allocated so far, released in the destructor
+    std::vector<char*> vChunks;
+
+    //! one singly linked free list per rounded block size
+    ListNode* vFreeLists[NUM_FREE_LISTS];
+
+    //! unused tail of the most recently allocated chunk
+    char* pAvailableBegin;
+    char* pAvailableEnd;
+
+    //! bytes currently handed out to ::operator new for oversized requests
+    size_t nOversizedBytes;
+
+    static size_t RoundUp(size_t nBytes)
+    {
+        return (nBytes + ALIGN_BYTES - 1) & ~(ALIGN_BYTES - 1);
+    }
+
+    static bool IsPooled(size_t nBytes, size_t nAlignment)
+    {
+        return nBytes <= MAX_BLOCK_SIZE_BYTES && nAlignment <= ALIGN_BYTES;
+    }
+
+    void PlaceInFreeList(char* p, size_t nRoundedBytes)
+    {
+        ListNode* node = new (p) ListNode;
+        node->pNext = vFreeLists[nRoundedBytes / ALIGN_BYTES];
+        vFreeLists[nRoundedBytes / ALIGN_BYTES] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Don't waste the remainder of the current chunk: it is always a
+        // multiple of ALIGN_BYTES, so it fits exactly into one free list.
+        size_t nRemaining = pAvailableEnd - pAvailableBegin;
+        if (nRemaining > 0)
+            PlaceInFreeList(pAvailableBegin, nRemaining);
+
+        char* pChunk = static_cast<char*>(::operator new(nChunkSizeBytes));
+        vChunks.push_back(pChunk);
+        pAvailableBegin = pChunk;
+        pAvailableEnd = pChunk + nChunkSizeBytes;
+    }
+
+    CPoolResource(const CPoolResource&);
+    CPoolResource& operator=(const CPoolResource&);
+
+public:
+    static const size_t DEFAULT_CHUNK_SIZE_BYTES = 256 * 1024;
+
+    explicit CPoolResource(size_t nChunkSizeBytesIn = DEFAULT_CHUNK_SIZE_BYTES) :
+        nChunkSizeBytes(RoundUp(nChunkSizeBytesIn)), pAvailableBegin(NULL), pAvailableEnd(NULL), nOversizedBytes(0)
+    {
+        static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+        static_assert(ALIGN_BYTES >= sizeof(ListNode), "ALIGN_BYTES must fit a free list node");
+        assert(nChunkSizeBytes >= MAX_BLOCK_SIZE_BYTES);
+        for (size_t i = 0; i < NUM_FREE_LISTS; i++)
+            vFreeLists[i] = NULL;
+    }
+
+    ~CPoolResource()
+    {
+        for (std::vector<char*>::iterator it = vChunks.begin(); it != vChunks.end(); ++it)
+            ::operator delete(*it);
+    }
+
+    void* Allocate(size_t nBytes, size_t nAlignment)
+    {
+        if (!IsPooled(nBytes, nAlignment)) {
+            nOversizedBytes += nBytes;
+            return ::operator new(nBytes);
+        }
+
+        const size_t nRounded = RoundUp(nBytes);
+        ListNode*& pFree = vFreeLists[nRounded / ALIGN_BYTES];
+        if (pFree != NULL) {
+            ListNode* node = pFree;
+            pFree = node->pNext;
+            node->~ListNode();
+            return node;
+        }
+
+        if ((size_t)(pAvailableEnd - pAvailableBegin) < nRounded)
+            AllocateChunk();
+        char* p = pAvailableBegin;
+        pAvailableBegin += nRounded;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t nBytes, size_t nAlignment)
+    {
+        if (!IsPooled(nBytes, nAlignment)) {
+            nOversizedBytes -= nBytes;
+            ::operator delete(p);
+            return;
+        }
+        PlaceInFreeList(static_cast<char*>(p), RoundUp(nBytes));
+    }
+
+    size_t NumAllocatedChunks() const { return vChunks.size(); }
+    size_t ChunkSizeBytes() const { return nChunkSizeBytes; }
+    size_t OversizedBytes() const { return nOversizedBytes; }
+};
+
+/**
+ * Allocator that forwards to a CPoolResource. The resource must outlive all
+ * containers using the allocator.
+ */
+template <typename T, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class CPoolAllocator
+{
+public:
+    typedef CPoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef CPoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    CPoolAllocator(ResourceType* resourceIn) throw() : resource(resourceIn) {}
+
+    template <typename U>
+    CPoolAllocator(const CPoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) throw() : resource(other.Resource()) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* Resource() const { return resource; }
+
+private:
+    ResourceType* resource;
+};
+
+template <typename T1, typename T2, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator==(const CPoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const CPoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return a.Resource() == b.Resource();
+}
+
+template <typename T1, typename T2, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator!=(const CPoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a,
+                const CPoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -4,6 +4,7 @@
 
 #include "util.h"
 
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_dash.h"
 
@@ -117,4 +118,32 @@ BOOST_AUTO_TEST_CASE(test_LockedPageManagerBase)
     BOOST_CHECK((last_unlock_len & (test_page_size-1)) == 0); // always unlock entire pages
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    CPoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Small blocks come out of one chunk, back to back
+    char* a = static_cast<char*>(resource.Allocate(10, 8));
+    char* b = static_cast<char*>(resource.Allocate(10, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(b - a, 16);
+
+    // Freed blocks are reused for the same rounded size only
+    resource.Deallocate(a, 10, 8);
+    BOOST_CHECK(resource.Allocate(24, 8) != a);
+    BOOST_CHECK(resource.Allocate(16, 8) == a);
+
+    // Oversized requests bypass the pool but are accounted for
+    void* big = resource.Allocate(100, 8);
+    BOOST_CHECK_EQUAL(resource.OversizedBytes(), 100U);
+    resource.Deallocate(big, 100, 8);
+    BOOST_CHECK_EQUAL(resource.OversizedBytes(), 0U);
+
+    // Exhausting a chunk allocates a new one
+    for (int i = 0; i < 100; i++)
+        resource.Allocate(64, 8);
+    BOOST_CHECK(resource.NumAllocatedChunks() > 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,117 @@
+// Copyright (c) 2017 The Sibcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "test/test_dash.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockcache_tests, BasicTestingSetup)
+
+static CBlock MakeBlock(uint32_t nNonce, unsigned int nTx)
+{
+    CBlock block;
+    block.nNonce = nNonce;
+    for (unsigned int i = 0; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = i;
+        tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(100, nNonce & 0xff);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        block.vtx.push_back(tx);
+    }
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_get_insert)
+{
+    CBlockCache cache;
+    CBlock block = MakeBlock(1, 3);
+    uint256 hash = block.GetHash();
+
+    BOOST_CHECK(!cache.Get(hash));
+    BOOST_CHECK_EQUAL(cache.Misses(), 1U);
+
+    block.fChecked = true;
+    cache.Insert(hash, block);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() > 0);
+
+    boost::shared_ptr<const CBlock> pblock = cache.Get(hash);
+    BOOST_CHECK(pblock);
+    BOOST_CHECK_EQUAL(cache.Hits(), 1U);
+    BOOST_CHECK(pblock->GetHash() == hash);
+    BOOST_CHECK_EQUAL(pblock->vtx.size(), 3U);
+    BOOST_CHECK(!pblock->fChecked);
+
+    // inserting the same block again does not grow the cache
+    size_t nUsage = cache.DynamicMemoryUsage();
+    cache.Insert(hash, block);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nUsage);
+
+    // a block handed out stays valid after it has been evicted
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(hash));
+    BOOST_CHECK(pblock->GetHash() == hash);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_shared_insert)
+{
+    CBlockCache cache;
+    boost::shared_ptr<const CBlock> pblock(new CBlock(MakeBlock(2, 3)));
+    uint256 hash = pblock->GetHash();
+
+    // a shared block is kept and handed out as is, not copied
+    cache.Insert(hash, pblock);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.Get(hash).get() == pblock.get());
+
+    // a copy inserted later does not replace it
+    cache.Insert(hash, *pblock);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.Get(hash).get() == pblock.get());
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_eviction)
+{
+    std::vector<CBlock> blocks;
+    for (uint32_t i = 0; i < 4; i++)
+        blocks.push_back(MakeBlock(i, 10));
+
+    // measure the usage of a single block, then allow exactly three
+    CBlockCache cache;
+    cache.Insert(blocks[0].GetHash(), blocks[0]);
+    size_t nBlockUsage = cache.DynamicMemoryUsage();
+    cache.Clear();
+    cache.SetMaxUsage(3 * nBlockUsage);
+
+    for (unsigned int i = 0; i < 3; i++)
+        cache.Insert(blocks[i].GetHash(), blocks[i]);
+    BOOST_CHECK_EQUAL(cache.Size(), 3U);
+
+    // touching block 0 makes block 1 the least recently used one
+    BOOST_CHECK(cache.Get(blocks[0].GetHash()));
+    cache.Insert(blocks[3].GetHash(), blocks[3]);
+    BOOST_CHECK_EQUAL(cache.Size(), 3U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() <= 3 * nBlockUsage);
+    BOOST_CHECK(cache.Get(blocks[0].GetHash()));
+    BOOST_CHECK(!cache.Get(blocks[1].GetHash()));
+    BOOST_CHECK(cache.Get(blocks[2].GetHash()));
+    BOOST_CHECK(cache.Get(blocks[3].GetHash()));
+
+    // shrinking the limit evicts, a limit of 0 disables the cache
+    cache.SetMaxUsage(nBlockUsage);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK(cache.Get(blocks[3].GetHash()));
+    cache.SetMaxUsage(0);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+    cache.Insert(blocks[0].GetHash(), blocks[0]);
+    BOOST_CHECK_EQUAL(cache.Size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
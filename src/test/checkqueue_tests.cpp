@@ -0,0 +1,227 @@
+// Copyright (c) 2012-2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+#include "random.h"
+
+#include "test/test_dash.h"
+
+#include <atomic>
+#include <set>
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+static const int CHECKQUEUE_TEST_WORKERS = 3;
+
+/** Counts how often each check ran, and fails on request */
+class CCountingCheck
+{
+public:
+    std::atomic<int>* pnRuns;
+    bool fOk;
+
+    CCountingCheck() : pnRuns(NULL), fOk(true) {}
+    CCountingCheck(std::atomic<int>* pnRunsIn, bool fOkIn = true) : pnRuns(pnRunsIn), fOk(fOkIn) {}
+
+    bool operator()()
+    {
+        if (pnRuns)
+            (*pnRuns)++;
+        return fOk;
+    }
+
+    void swap(CCountingCheck& check)
+    {
+        std::swap(pnRuns, check.pnRuns);
+        std::swap(fOk, check.fOk);
+    }
+};
+
+/** Records the threads that ran checks, each check taking a little while */
+class CThreadRecordingCheck
+{
+public:
+    boost::mutex* pmutex;
+    std::set<boost::thread::id>* pthreads;
+
+    CThreadRecordingCheck() : pmutex(NULL), pthreads(NULL) {}
+    CThreadRecordingCheck(boost::mutex* pmutexIn, std::set<boost::thread::id>* pthreadsIn) : pmutex(pmutexIn), pthreads(pthreadsIn) {}
+
+    bool operator()()
+    {
+        MilliSleep(1);
+        boost::unique_lock<boost::mutex> lock(*pmutex);
+        pthreads->insert(boost::this_thread::get_id());
+        return true;
+    }
+
+    void swap(CThreadRecordingCheck& check)
+    {
+        std::swap(pmutex, check.pmutex);
+        std::swap(pthreads, check.pthreads);
+    }
+};
+
+template <typename T>
+static void StartWorkers(CCheckQueue<T>& queue, boost::thread_group& threadGroup)
+{
+    for (int i = 0; i < CHECKQUEUE_TEST_WORKERS; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<T>::Thread, &queue));
+}
+
+/** Run nChecks counting checks in Adds of random size, failing check nFail if it is set */
+static bool RunCountingChecks(CCheckQueue<CCountingCheck>& queue, std::vector<std::atomic<int> >& vRuns, int nFail = -1)
+{
+    for (size_t i = 0; i < vRuns.size(); i++)
+        vRuns[i] = 0;
+    CCheckQueueControl<CCountingCheck> control(&queue);
+    size_t nAdded = 0;
+    while (nAdded < vRuns.size()) {
+        size_t nNow = std::min(vRuns.size() - nAdded, (size_t)(1 + insecure_rand() % 50));
+        std::vector<CCountingCheck> vChecks;
+        for (size_t i = nAdded; i < nAdded + nNow; i++)
+            vChecks.push_back(CCountingCheck(&vRuns[i], (int)i != nFail));
+        control.Add(vChecks);
+        nAdded += nNow;
+    }
+    return control.Wait();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_runs_every_check_once)
+{
+    CCheckQueue<CCountingCheck> queue(128);
+    boost::thread_group threadGroup;
+    StartWorkers(queue, threadGroup);
+
+    std::vector<std::atomic<int> > vRuns(5000);
+    BOOST_CHECK(RunCountingChecks(queue, vRuns));
+    for (size_t i = 0; i < vRuns.size(); i++)
+        BOOST_CHECK_EQUAL(vRuns[i].load(), 1);
+    BOOST_CHECK(queue.IsIdle());
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_idle_while_workers_start)
+{
+    // A control may be created right after the workers were spawned, while
+    // they are still joining the queue
+    for (int i = 0; i < 100; i++) {
+        CCheckQueue<CCountingCheck> queue(128);
+        boost::thread_group threadGroup;
+        StartWorkers(queue, threadGroup);
+        for (int j = 0; j < 100; j++) {
+            BOOST_CHECK(queue.IsIdle());
+            boost::this_thread::yield();
+        }
+
+        std::vector<std::atomic<int> > vRuns(100);
+        BOOST_CHECK(RunCountingChecks(queue, vRuns));
+
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_failure_and_reuse)
+{
+    CCheckQueue<CCountingCheck> queue(128);
+    boost::thread_group threadGroup;
+    StartWorkers(queue, threadGroup);
+
+    std::vector<std::atomic<int> > vRuns(1000);
+    for (int nFail = 0; nFail < 1000; nFail += 199) {
+        BOOST_CHECK(!RunCountingChecks(queue, vRuns, nFail));
+        // Checks after the failing one may be skipped, but none runs twice
+        for (size_t i = 0; i < vRuns.size(); i++)
+            BOOST_CHECK(vRuns[i] <= 1);
+        BOOST_CHECK(queue.IsIdle());
+
+        // The failure does not stick to the queue
+        BOOST_CHECK(RunCountingChecks(queue, vRuns));
+        for (size_t i = 0; i < vRuns.size(); i++)
+            BOOST_CHECK_EQUAL(vRuns[i].load(), 1);
+        BOOST_CHECK(queue.IsIdle());
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_spreads_large_add)
+{
+    CCheckQueue<CThreadRecordingCheck> queue(128);
+    boost::thread_group threadGroup;
+    StartWorkers(queue, threadGroup);
+
+    boost::mutex mutex;
+    std::set<boost::thread::id> setThreads;
+    {
+        // All checks go to a single per-worker queue, the others have to steal them
+        CCheckQueueControl<CThreadRecordingCheck> control(&queue);
+        std::vector<CThreadRecordingCheck> vChecks(400, CThreadRecordingCheck(&mutex, &setThreads));
+        control.Add(vChecks);
+        BOOST_CHECK(control.Wait());
+    }
+    BOOST_CHECK(setThreads.size() > 1);
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_repeated_controls)
+{
+    CCheckQueue<CCountingCheck> queue(128);
+    boost::thread_group threadGroup;
+    StartWorkers(queue, threadGroup);
+
+    for (int i = 0; i < 200; i++) {
+        std::vector<std::atomic<int> > vRuns(insecure_rand() % 300);
+        BOOST_CHECK(RunCountingChecks(queue, vRuns));
+        for (size_t j = 0; j < vRuns.size(); j++)
+            BOOST_CHECK_EQUAL(vRuns[j].load(), 1);
+        // The next control asserts this as well
+        BOOST_CHECK(queue.IsIdle());
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_interrupt)
+{
+    CCheckQueue<CCountingCheck> queue(128);
+
+    // Idle workers
+    {
+        boost::thread_group threadGroup;
+        StartWorkers(queue, threadGroup);
+        MilliSleep(10);
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+
+    // Workers that just finished a run
+    {
+        boost::thread_group threadGroup;
+        StartWorkers(queue, threadGroup);
+        std::vector<std::atomic<int> > vRuns(2000);
+        BOOST_CHECK(RunCountingChecks(queue, vRuns));
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+
+    // The master alone still gets everything done after the workers left
+    std::vector<std::atomic<int> > vRuns(100);
+    BOOST_CHECK(RunCountingChecks(queue, vRuns));
+    for (size_t i = 0; i < vRuns.size(); i++)
+        BOOST_CHECK_EQUAL(vRuns[i].load(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
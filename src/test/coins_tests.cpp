@@ -347,4 +347,48 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+BOOST_AUTO_TEST_CASE(coins_single_output_access_test)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.hash = GetRandHash();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(3);
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        tx.vout[i].nValue = (i + 1) * COIN;
+        tx.vout[i].scriptPubKey = CScript() << OP_TRUE;
+    }
+    uint256 txid = tx.GetHash();
+    cache.ModifyNewCoins(txid)->FromTx(tx, 42);
+
+    Coin coin;
+    BOOST_CHECK(cache.GetCoin(COutPoint(txid, 1), coin));
+    BOOST_CHECK(coin.out == tx.vout[1]);
+    BOOST_CHECK_EQUAL(coin.nHeight, 42);
+    BOOST_CHECK(!coin.fCoinBase);
+    BOOST_CHECK(cache.HaveCoin(COutPoint(txid, 1)));
+
+    // Out of range and unknown outpoints are not found
+    BOOST_CHECK(!cache.GetCoin(COutPoint(txid, 3), coin));
+    BOOST_CHECK(!cache.HaveCoin(COutPoint(GetRandHash(), 0)));
+
+    // Spending one output leaves the others accessible
+    cache.ModifyCoins(txid)->Spend(1);
+    BOOST_CHECK(!cache.GetCoin(COutPoint(txid, 1), coin));
+    BOOST_CHECK(!cache.HaveCoin(COutPoint(txid, 1)));
+    BOOST_CHECK(cache.HaveCoin(COutPoint(txid, 2)));
+
+    // The generic implementation must agree with the cache after a flush
+    cache.SetBestBlock(GetRandHash());
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(base.GetCoin(COutPoint(txid, 0), coin));
+    BOOST_CHECK(coin.out == tx.vout[0]);
+    BOOST_CHECK_EQUAL(coin.nHeight, 42);
+    BOOST_CHECK(!base.GetCoin(COutPoint(txid, 1), coin));
+    cache.SelfTest();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+namespace alert_tests{
+static unsigned const char alertTests[] = {
+0x41, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x51, 0x01, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x59, 0x3e, 0x0f, 0x00, 0x00, 0x01, 
+0x00, 0x00, 0x00, 0x0d, 0x41, 0x6c, 0x65, 0x72, 
+0x74, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 
+0x74, 0x07, 0x41, 0x6c, 0x65, 0x72, 0x74, 0x20, 
+0x31, 0x00, 0x46, 0x30, 0x44, 0x02, 0x20, 0x2b, 
+0xe1, 0xb9, 0xe2, 0xe9, 0x3b, 0x2f, 0xfd, 0xec, 
+0xbf, 0x2c, 0x63, 0xac, 0x3d, 0x2f, 0xa7, 0x71, 
+0xe1, 0xc9, 0x81, 0x3d, 0xda, 0x6e, 0x73, 0x56, 
+0x3d, 0x75, 0xab, 0x99, 0x22, 0x8c, 0x4b, 0x02, 
+0x20, 0x06, 0x87, 0x76, 0xd0, 0xf6, 0x81, 0x97, 
+0x28, 0x74, 0x4c, 0xf3, 0xb0, 0x74, 0x63, 0x5a, 
+0xcc, 0x6c, 0xf2, 0xea, 0x8e, 0x2d, 0x09, 0x49, 
+0x49, 0x83, 0xcc, 0xba, 0x46, 0x12, 0x67, 0x25, 
+0x52, 0x63, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x51, 
+0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x59, 0x3e, 0x0f, 0x00, 0x01, 
+0x0f, 0x2f, 0x53, 0x61, 0x74, 0x6f, 0x73, 0x68, 
+0x69, 0x3a, 0x30, 0x2e, 0x31, 0x2e, 0x30, 0x2f, 
+0x01, 0x00, 0x00, 0x00, 0x0d, 0x41, 0x6c, 0x65, 
+0x72, 0x74, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 
+0x6e, 0x74, 0x19, 0x41, 0x6c, 0x65, 0x72, 0x74, 
+0x20, 0x31, 0x20, 0x66, 0x6f, 0x72, 0x20, 0x53, 
+0x61, 0x74, 0x6f, 0x73, 0x68, 0x69, 0x20, 0x30, 
+0x2e, 0x31, 0x2e, 0x30, 0x00, 0x47, 0x30, 0x45, 
+0x02, 0x21, 0x00, 0xb1, 0xae, 0x1a, 0x1e, 0x2b, 
+0xf1, 0xd1, 0x5a, 0x24, 0x06, 0xb0, 0xe7, 0xcb, 
+0xfa, 0xcc, 0x87, 0xeb, 0xbc, 0xcd, 0x07, 0x3b, 
+0xf9, 0x13, 0xc3, 0x8f, 0xb7, 0xa6, 0xc1, 0x44, 
+0xa6, 0x21, 0x6c, 0x02, 0x20, 0x34, 0xa7, 0x6a, 
+0x21, 0x7e, 0x37, 0xcc, 0x19, 0xf2, 0x09, 0xa3, 
+0x9f, 0xe2, 0x03, 0xc7, 0xd4, 0x55, 0x2f, 0x4a, 
+0x28, 0x1c, 0x07, 0x5f, 0x94, 0x07, 0xcd, 0xdf, 
+0xb3, 0x17, 0x2f, 0xee, 0x44, 0x7a, 0x01, 0x00, 
+0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x80, 0x51, 0x01, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x59, 
+0x3e, 0x0f, 0x00, 0x02, 0x0f, 0x2f, 0x53, 0x61, 
+0x74, 0x6f, 0x73, 0x68, 0x69, 0x3a, 0x30, 0x2e, 
+0x31, 0x2e, 0x30, 0x2f, 0x0f, 0x2f, 0x53, 0x61, 
+0x74, 0x6f, 0x73, 0x68, 0x69, 0x3a, 0x30, 0x2e, 
+0x32, 0x2e, 0x30, 0x2f, 0x01, 0x00, 0x00, 0x00, 
+0x0d, 0x41, 0x6c, 0x65, 0x72, 0x74, 0x20, 0x63, 
+0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74, 0x20, 0x41, 
+0x6c, 0x65, 0x72, 0x74, 0x20, 0x31, 0x20, 0x66, 
+0x6f, 0x72, 0x20, 0x53, 0x61, 0x74, 0x6f, 0x73, 
+0x68, 0x69, 0x20, 0x30, 0x2e, 0x31, 0x2e, 0x30, 
+0x2c, 0x20, 0x30, 0x2e, 0x32, 0x2e, 0x30, 0x00, 
+0x47, 0x30, 0x45, 0x02, 0x21, 0x00, 0xdd, 0x52, 
+0xc5, 0xf9, 0xcb, 0x9d, 0x5b, 0xa9, 0xa1, 0xa0, 
+0x88, 0xb7, 0x1c, 0x2d, 0x13, 0x7f, 0x9f, 0x5c, 
+0xfc, 0x9f, 0xa4, 0xe5, 0x17, 0xbb, 0x67, 0x46, 
+0x9a, 0xfc, 0x5c, 0xfa, 0x1c, 0x0b, 0x02, 0x20, 
+0x37, 0x73, 0xef, 0xc9, 0x5e, 0x9c, 0x90, 0x64, 
+0xac, 0x97, 0xb8, 0x08, 0xed, 0xc5, 0xb2, 0x9e, 
+0x41, 0xd2, 0xcc, 0xd0, 0x6e, 0x07, 0x44, 0x7e, 
+0xcf, 0x76, 0x45, 0xfa, 0x62, 0x78, 0xe6, 0x2b, 
+0x4c, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x51, 0x01, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 
+0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x59, 0x3e, 0x0f, 0x00, 0x00, 0x64, 
+0x00, 0x00, 0x00, 0x0d, 0x41, 0x6c, 0x65, 0x72, 
+0x74, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 
+0x74, 0x12, 0x41, 0x6c, 0x65, 0x72, 0x74, 0x20, 
+0x32, 0x2c, 0x20, 0x63, 0x61, 0x6e, 0x63, 0x65, 
+0x6c, 0x73, 0x20, 0x31, 0x00, 0x46, 0x30, 0x44, 
+0x02, 0x20, 0x69, 0x53, 0x12, 0x70, 0xe8, 0xbb, 
+0xbf, 0x43, 0x9e, 0x87, 0x87, 0x62, 0x04, 0x55, 
+0x8f, 0x15, 0xd4, 0xf1, 0xa8, 0xab, 0x16, 0x21, 
+0xc0, 0xb2, 0x34, 0x1f, 0x86, 0x81, 0x01, 0xb1, 
+0x3e, 0x52, 0x02, 0x20, 0x1f, 0x7c, 0xb5, 0xb9, 
+0x0d, 0xef, 0x01, 0x30, 0x9b, 0x19, 0x17, 0x9e, 
+0x83, 0x5b, 0x55, 0xc4, 0xab, 0xa2, 0xbc, 0xa1, 
+0xab, 0xa1, 0x5b, 0x8e, 0x3b, 0xe1, 0x24, 0x98, 
+0xa4, 0x73, 0x24, 0xfa, 0x4c, 0x01, 0x00, 0x00, 
+0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0xbc, 0x51, 0x01, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x59, 0x3e, 
+0x0f, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0x0d, 
+0x41, 0x6c, 0x65, 0x72, 0x74, 0x20, 0x63, 0x6f, 
+0x6d, 0x6d, 0x65, 0x6e, 0x74, 0x12, 0x41, 0x6c, 
+0x65, 0x72, 0x74, 0x20, 0x32, 0x2c, 0x20, 0x63, 
+0x61, 0x6e, 0x63, 0x65, 0x6c, 0x73, 0x20, 0x31, 
+0x00, 0x47, 0x30, 0x45, 0x02, 0x21, 0x00, 0xa0, 
+0x3b, 0x80, 0x77, 0x30, 0x3b, 0x4f, 0x77, 0x0a, 
+0x59, 0x8d, 0x8d, 0x30, 0x78, 0x82, 0x6f, 0x09, 
+0xf7, 0xe1, 0xe9, 0xac, 0xd8, 0x9d, 0x25, 0xcd, 
+0x6e, 0x1b, 0x7a, 0xf8, 0xfc, 0x5b, 0x9e, 0x02, 
+0x20, 0x14, 0xf7, 0x31, 0x60, 0xb4, 0x3c, 0x0b, 
+0x58, 0x61, 0x85, 0xde, 0xe5, 0x44, 0x34, 0x85, 
+0x13, 0x54, 0x94, 0x34, 0x64, 0x30, 0xb0, 0xca, 
+0xa8, 0xdb, 0x16, 0x06, 0xa7, 0x14, 0x56, 0x1d, 
+0x76, 0x4c, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbc, 0x51, 
+0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 
+0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x0b, 
+0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x00, 
+0x64, 0x00, 0x00, 0x00, 0x0d, 0x41, 0x6c, 0x65, 
+0x72, 0x74, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 
+0x6e, 0x74, 0x12, 0x41, 0x6c, 0x65, 0x72, 0x74, 
+0x20, 0x32, 0x2c, 0x20, 0x63, 0x61, 0x6e, 0x63, 
+0x65, 0x6c, 0x73, 0x20, 0x31, 0x00, 0x47, 0x30, 
+0x45, 0x02, 0x21, 0x00, 0x8f, 0xc8, 0xd4, 0xf4, 
+0x97, 0x0a, 0x02, 0x35, 0x29, 0x49, 0xdd, 0x1c, 
+0xda, 0x84, 0xe0, 0x3d, 0x64, 0x04, 0xce, 0x3a, 
+0x8e, 0xa1, 0xe3, 0x0d, 0xe9, 0xda, 0x7b, 0x2f, 
+0xfd, 0x22, 0xfe, 0xf5, 0x02, 0x20, 0x3a, 0xe7, 
+0x29, 0x5e, 0xff, 0xee, 0x90, 0x38, 0xd5, 0x08, 
+0x5e, 0x34, 0x57, 0x31, 0x93, 0x51, 0x90, 0xbe, 
+0x34, 0x85, 0x8c, 0xc3, 0x48, 0x22, 0x9f, 0x63, 
+0xd1, 0x17, 0xb8, 0xd2, 0xec, 0xfd, 0x63, 0x01, 
+0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0xbc, 0x51, 0x01, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x01, 
+0x00, 0x00, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 
+0x16, 0x00, 0x00, 0x00, 0x01, 0x0f, 0x2f, 0x53, 
+0x61, 0x74, 0x6f, 0x73, 0x68, 0x69, 0x3a, 0x30, 
+0x2e, 0x31, 0x2e, 0x30, 0x2f, 0x64, 0x00, 0x00, 
+0x00, 0x0d, 0x41, 0x6c, 0x65, 0x72, 0x74, 0x20, 
+0x63, 0x6f, 0x6d, 0x6d, 0x65, 0x6e, 0x74, 0x19, 
+0x41, 0x6c, 0x65, 0x72, 0x74, 0x20, 0x32, 0x20, 
+0x66, 0x6f, 0x72, 0x20, 0x53, 0x61, 0x74, 0x6f, 
+0x73, 0x68, 0x69, 0x20, 0x30, 0x2e, 0x31, 0x2e, 
+0x30, 0x00, 0x46, 0x30, 0x44, 0x02, 0x20, 0x3b, 
+0xd9, 0xdd, 0xf4, 0x35, 0x3a, 0xea, 0x6c, 0x7e, 
+0x37, 0x14, 0x45, 0x2c, 0x59, 0x0b, 0xac, 0x21, 
+0xb6, 0x90, 0x2f, 0xca, 0xd8, 0x33, 0x34, 0x9b, 
+0x65, 0xb1, 0xb4, 0xe9, 0xca, 0x53, 0x5c, 0x02, 
+0x20, 0x6f, 0xe8, 0xa8, 0x2d, 0xcb, 0xa7, 0x28, 
+0xf2, 0xa1, 0xc4, 0xe9, 0x04, 0xf9, 0xdd, 0x2e, 
+0x30, 0x52, 0x9a, 0x74, 0x35, 0x4a, 0x8b, 0xbe, 
+0x3c, 0xfa, 0x24, 0xaf, 0x9c, 0xd4, 0x8d, 0x26, 
+0xb2, 0x56, 0x01, 0x00, 0x00, 0x00, 0x3c, 0x00, 
+0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xbc, 0x51, 
+0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 
+0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 
+0x00, 0x00, 0x00, 0x3f, 0x42, 0x0f, 0x00, 0x00, 
+0x64, 0x00, 0x00, 0x00, 0x0d, 0x41, 0x6c, 0x65, 
+0x72, 0x74, 0x20, 0x63, 0x6f, 0x6d, 0x6d, 0x65, 
+0x6e, 0x74, 0x1c, 0x45, 0x76, 0x69, 0x6c, 0x20, 
+0x41, 0x6c, 0x65, 0x72, 0x74, 0x27, 0x3b, 0x20, 
+0x2f, 0x62, 0x69, 0x6e, 0x2f, 0x6c, 0x73, 0x3b, 
+0x20, 0x65, 0x63, 0x68, 0x6f, 0x20, 0x27, 0x00, 
+0x47, 0x30, 0x45, 0x02, 0x21, 0x00, 0x98, 0x1f, 
+0xf6, 0xca, 0x25, 0xa6, 0x27, 0x58, 0x44, 0xbe, 
+0x7b, 0x77, 0xa9, 0xa5, 0xde, 0x4e, 0x30, 0x18, 
+0x0b, 0x5a, 0xee, 0xfe, 0x26, 0xa3, 0xc8, 0x23, 
+0xc7, 0x73, 0xb6, 0x9e, 0xd8, 0x3c, 0x02, 0x20, 
+0x38, 0xcb, 0x0f, 0xce, 0xc9, 0xd2, 0xa2, 0x91, 
+0x2f, 0x20, 0xa4, 0x27, 0x55, 0x1a, 0xf4, 0x19, 
+0x5e, 0xf1, 0xb3, 0xca, 0x75, 0xae, 0x59, 0xfb, 
+0xf6, 0xc1, 0xcd, 0x71, 0xb8, 0xd5, 0x53, 0x66, 
+};};
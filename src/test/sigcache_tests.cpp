@@ -0,0 +1,197 @@
+// Copyright (c) 2012-2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "script/sigcache.h"
+#include "uint256.h"
+
+#include "test/test_dash.h"
+
+#include <atomic>
+#include <string.h>
+#include <vector>
+
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(sigcache_tests, BasicTestingSetup)
+
+static std::vector<uint256> RandomEntries(size_t nCount)
+{
+    std::vector<uint256> vEntries;
+    for (size_t i = 0; i < nCount; i++)
+        vEntries.push_back(GetRandHash());
+    return vEntries;
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_set_get)
+{
+    CSignatureCache cache(1 << 20);
+    std::vector<uint256> vEntries = RandomEntries(1000);
+
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        BOOST_CHECK(!cache.Get(entry));
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        cache.Set(entry);
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        BOOST_CHECK(cache.Get(entry));
+    BOOST_FOREACH(const uint256& entry, RandomEntries(1000))
+        BOOST_CHECK(!cache.Get(entry));
+
+    // Setting an entry again does not store a second copy
+    cache.Set(vEntries[0]);
+    CSignatureCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nInserts, 1000U);
+    BOOST_CHECK_EQUAL(stats.nHits, 1000U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 2000U);
+    BOOST_CHECK_EQUAL(stats.nEvictions, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_erase)
+{
+    // CachingTransactionSignatureChecker erases entries it hits without store
+    CSignatureCache cache(1 << 20);
+    std::vector<uint256> vEntries = RandomEntries(100);
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        cache.Set(entry);
+
+    for (size_t i = 0; i < vEntries.size(); i += 2)
+        BOOST_CHECK(cache.Get(vEntries[i], true));
+    for (size_t i = 0; i < vEntries.size(); i++)
+        BOOST_CHECK_EQUAL(cache.Get(vEntries[i]), i % 2 == 1);
+
+    // Erased entries can be stored again
+    cache.Set(vEntries[0]);
+    BOOST_CHECK(cache.Get(vEntries[0]));
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_disabled)
+{
+    // -maxsigcachesize=0
+    CSignatureCache cache(0);
+    uint256 entry = GetRandHash();
+    cache.Set(entry);
+    BOOST_CHECK(!cache.Get(entry));
+    CSignatureCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nSlots, 0U);
+    BOOST_CHECK_EQUAL(stats.nInserts, 0U);
+}
+
+/** A random entry whose two slots are picked by nSlot0 and nSlot1 */
+static uint256 CollidingEntry(uint64_t nSlot0, uint64_t nSlot1)
+{
+    uint256 entry = GetRandHash();
+    memcpy(entry.begin(), &nSlot0, 8);
+    memcpy(entry.begin() + 8, &nSlot1, 8);
+    return entry;
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_kick)
+{
+    // 64 slots, the generation advances every 16 inserts
+    CSignatureCache cache(64 * 64);
+    BOOST_CHECK_EQUAL(cache.GetStats().nSlots, 64U);
+
+    // Entries sharing one slot are kicked to their other slot
+    std::vector<uint256> vEntries;
+    vEntries.push_back(CollidingEntry(5, 9));
+    vEntries.push_back(CollidingEntry(5, 17));
+    vEntries.push_back(CollidingEntry(17, 33));
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        cache.Set(entry);
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        BOOST_CHECK(cache.Get(entry));
+    BOOST_CHECK_EQUAL(cache.GetStats().nEvictions, 0U);
+
+    // Three live entries for the same two slots: kicking goes round in
+    // circles until one of them is dropped
+    CSignatureCache full(64 * 64);
+    vEntries.clear();
+    for (int i = 0; i < 3; i++)
+        vEntries.push_back(CollidingEntry(21, 42));
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        full.Set(entry);
+    unsigned int nFound = 0;
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        nFound += full.Get(entry);
+    BOOST_CHECK_EQUAL(nFound, 2U);
+    CSignatureCacheStats stats = full.GetStats();
+    BOOST_CHECK_EQUAL(stats.nInserts, 3U);
+    BOOST_CHECK_EQUAL(stats.nEvictions, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_full)
+{
+    // 16 slots
+    CSignatureCache cache(16 * 64);
+    BOOST_CHECK_EQUAL(cache.GetStats().nSlots, 16U);
+
+    std::vector<uint256> vEntries = RandomEntries(1000);
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        cache.Set(entry);
+
+    CSignatureCacheStats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nInserts, 1000U);
+    BOOST_CHECK(stats.nGeneration > 1);
+
+    // The table holds no more entries than it has slots, and new entries
+    // replace old ones rather than being refused
+    unsigned int nFound = 0;
+    BOOST_FOREACH(const uint256& entry, vEntries)
+        nFound += cache.Get(entry);
+    BOOST_CHECK(nFound > 0);
+    BOOST_CHECK(nFound <= 16);
+    BOOST_CHECK(cache.Get(vEntries.back()));
+}
+
+static void SigCacheWriter(CSignatureCache* pcache, const std::vector<uint256>* pvEntries, std::atomic<unsigned int>* pnFound)
+{
+    BOOST_FOREACH(const uint256& entry, *pvEntries)
+        pcache->Set(entry);
+    BOOST_FOREACH(const uint256& entry, *pvEntries)
+        *pnFound += pcache->Get(entry);
+}
+
+static void SigCacheReader(CSignatureCache* pcache, const std::vector<uint256>* pvEntries, std::atomic<unsigned int>* pnFound)
+{
+    for (int i = 0; i < 10; i++) {
+        BOOST_FOREACH(const uint256& entry, *pvEntries)
+            *pnFound += pcache->Get(entry);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sigcache_concurrent)
+{
+    static const int WRITERS = 4;
+    static const unsigned int ENTRIES_PER_WRITER = 2000;
+    CSignatureCache cache(4 << 20);
+
+    std::vector<std::vector<uint256> > vWriterEntries;
+    for (int i = 0; i < WRITERS; i++)
+        vWriterEntries.push_back(RandomEntries(ENTRIES_PER_WRITER));
+    std::vector<uint256> vAbsent = RandomEntries(ENTRIES_PER_WRITER);
+
+    std::atomic<unsigned int> nWriterFound(0);
+    std::atomic<unsigned int> nAbsentFound(0);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < WRITERS; i++) {
+        threadGroup.create_thread(boost::bind(&SigCacheWriter, &cache, &vWriterEntries[i], &nWriterFound));
+        threadGroup.create_thread(boost::bind(&SigCacheReader, &cache, &vAbsent, &nAbsentFound));
+    }
+    threadGroup.join_all();
+
+    // Readers never see entries nobody stored, and writers find nearly all of
+    // theirs: a Set only gives up on slots other writers hold at that moment
+    BOOST_CHECK_EQUAL(nAbsentFound.load(), 0U);
+    BOOST_CHECK(nWriterFound.load() >= WRITERS * ENTRIES_PER_WRITER * 95 / 100);
+
+    unsigned int nFound = 0;
+    for (int i = 0; i < WRITERS; i++) {
+        BOOST_FOREACH(const uint256& entry, vWriterEntries[i])
+            nFound += cache.Get(entry);
+    }
+    BOOST_CHECK(nFound >= WRITERS * ENTRIES_PER_WRITER * 95 / 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -331,5 +331,76 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK(!v.read("{} 42"));
 }
 
+
+class UniValueStringWriter : public UniValueStreamWriter
+{
+public:
+    std::string str;
+    unsigned int nChunks;
+
+    UniValueStringWriter(size_t chunkSize) : UniValueStreamWriter(chunkSize), nChunks(0) {}
+
+protected:
+    void flushChunk(const char *data, size_t len)
+    {
+        str.append(data, len);
+        nChunks++;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(univalue_streamwriter)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.push_back(Pair("esc\"ape", "line\nbreak"));
+    inner.push_back(Pair("num", -1.5));
+    inner.push_back(Pair("empty", UniValue(UniValue::VARR)));
+
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 100; i++)
+        arr.push_back(i);
+    arr.push_back(inner);
+    arr.push_back(NullUniValue);
+
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("a", true));
+    expected.push_back(Pair("list", arr));
+    expected.push_back(Pair("b", "str"));
+    expected.push_back(Pair("c", (int64_t)1234567890123LL));
+
+    // Emit the same document piece by piece with a tiny chunk size
+    UniValueStringWriter writer(16);
+    writer.beginObject();
+    writer.pushKV("a", true);
+    writer.key("list");
+    writer.beginArray();
+    for (int i = 0; i < 100; i++)
+        writer.value(i);
+    writer.value(inner);
+    writer.value(NullUniValue);
+    writer.endArray();
+    UniValue tail(UniValue::VOBJ);
+    tail.push_back(Pair("b", "str"));
+    tail.push_back(Pair("c", (int64_t)1234567890123LL));
+    writer.pushKVs(tail);
+    writer.endObject();
+    BOOST_CHECK(writer.str.size() < expected.write().size());
+    writer.flush();
+
+    BOOST_CHECK_EQUAL(writer.str, expected.write());
+    BOOST_CHECK_EQUAL(writer.size(), writer.str.size());
+    BOOST_CHECK(writer.nChunks > 1);
+
+    // Nothing is emitted before the first chunk fills up
+    UniValueStringWriter small(1024);
+    small.beginArray();
+    small.value(UniValue(UniValue::VOBJ));
+    small.value("x");
+    small.endArray();
+    BOOST_CHECK(small.str.empty());
+    small.flush();
+    BOOST_CHECK_EQUAL(small.str, "[{},\"x\"]");
+    BOOST_CHECK_EQUAL(small.nChunks, 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
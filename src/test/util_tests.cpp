@@ -86,6 +86,22 @@ BOOST_AUTO_TEST_CASE(util_HexStr)
         "04 67 8a fd b0");
 }
 
+BOOST_AUTO_TEST_CASE(util_HexEncode)
+{
+    // Every length around the unrolled step, and all byte values
+    std::vector<unsigned char> vch;
+    for (int i = 0; i < 256; i++)
+        vch.push_back(i);
+    for (size_t len = 0; len <= 17; len++) {
+        std::string str(2 * len, 'x');
+        HexEncode(vch.data() + vch.size() - len, len, &str[0]);
+        BOOST_CHECK_EQUAL(str, HexStr(vch.end() - len, vch.end()));
+    }
+    std::string str(2 * vch.size(), 'x');
+    HexEncode(&vch[0], vch.size(), &str[0]);
+    BOOST_CHECK_EQUAL(str, HexStr(vch));
+}
+
 
 BOOST_AUTO_TEST_CASE(util_DateTimeStrFormat)
 {
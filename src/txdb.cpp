@@ -14,6 +14,9 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -196,19 +199,30 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CAddressUnspentKey* pkeyAfter, size_t nLimit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    if (pkeyAfter) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, *pkeyAfter));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
 
-    while (pcursor->Valid()) {
+    size_t nRead = 0;
+    while (pcursor->Valid() && (nLimit == 0 || nRead < nLimit)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            if (pkeyAfter && key.second == *pkeyAfter) {
+                pcursor->Next();
+                continue;
+            }
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(make_pair(key.second, nValue));
+                nRead++;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -237,26 +251,35 @@ bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKe
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end,
+                                    const CAddressIndexKey* pkeyAfter, size_t nLimit) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    if (start > 0 && end > 0) {
+    if (pkeyAfter) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pkeyAfter));
+    } else if (start > 0 && end > 0) {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
     }
 
-    while (pcursor->Valid()) {
+    size_t nRead = 0;
+    while (pcursor->Valid() && (nLimit == 0 || nRead < nLimit)) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
         if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
             if (end > 0 && key.second.blockHeight > end) {
                 break;
             }
+            if (pkeyAfter && key.second == *pkeyAfter) {
+                pcursor->Next();
+                continue;
+            }
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(make_pair(key.second, nValue));
+                nRead++;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -269,6 +292,154 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+struct CAddressIndexMergeCursor::CSource
+{
+    boost::scoped_ptr<CDBIterator> pcursor;
+    unsigned int type;
+    uint160 hashBytes;
+    CAddressIndexKey key;
+    CAmount value;
+
+    CSource(CDBIterator* pcursorIn, unsigned int typeIn, const uint160& hashBytesIn) :
+        pcursor(pcursorIn), type(typeIn), hashBytes(hashBytesIn), value(0) {}
+
+    void SeekToStart(int nStart) {
+        if (nStart > 0) {
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, hashBytes, nStart)));
+        } else {
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, hashBytes)));
+        }
+    }
+};
+
+CAddressIndexMergeCursor::CAddressIndexMergeCursor(CDBWrapper& db, const std::vector<std::pair<uint160, int> >& addresses, int start, int end)
+{
+    nStart = (start > 0 && end > 0) ? start : 0;
+    nEnd = (start > 0 && end > 0) ? end : 0;
+
+    vSources.reserve(addresses.size());
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        vSources.push_back(new CSource(db.NewIterator(), it->second, it->first));
+        vSources.back()->SeekToStart(nStart);
+    }
+    BuildHeap();
+}
+
+CAddressIndexMergeCursor::~CAddressIndexMergeCursor()
+{
+    for (std::vector<CSource*>::iterator it = vSources.begin(); it != vSources.end(); it++)
+        delete *it;
+}
+
+bool CAddressIndexMergeCursor::ReadEntry(CSource& source)
+{
+    boost::this_thread::interruption_point();
+    if (!source.pcursor->Valid())
+        return false;
+    std::pair<char,CAddressIndexKey> key;
+    if (!source.pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX ||
+        key.second.type != source.type || key.second.hashBytes != source.hashBytes)
+        return false;
+    if (nEnd > 0 && key.second.blockHeight > nEnd)
+        return false;
+    if (!source.pcursor->GetValue(source.value))
+        return error("failed to get address index value");
+    source.key = key.second;
+    return true;
+}
+
+bool CAddressIndexMergeCursor::IsBefore(size_t a, size_t b) const
+{
+    const CAddressIndexKey& keyA = vSources[a]->key;
+    const CAddressIndexKey& keyB = vSources[b]->key;
+    if (keyA.blockHeight != keyB.blockHeight)
+        return keyA.blockHeight < keyB.blockHeight;
+    if (keyA.txindex != keyB.txindex)
+        return keyA.txindex < keyB.txindex;
+    return a < b;
+}
+
+// std::*_heap keep the largest element in front, so the ordering is reversed
+struct CAddressIndexMergeCursor::CHeapOrder
+{
+    const CAddressIndexMergeCursor* pcursor;
+    CHeapOrder(const CAddressIndexMergeCursor* pcursorIn) : pcursor(pcursorIn) {}
+    bool operator()(size_t a, size_t b) const { return pcursor->IsBefore(b, a); }
+};
+
+void CAddressIndexMergeCursor::BuildHeap()
+{
+    vHeap.clear();
+    for (size_t i = 0; i < vSources.size(); i++) {
+        if (ReadEntry(*vSources[i]))
+            vHeap.push_back(i);
+    }
+    CHeapOrder comp(this);
+    std::make_heap(vHeap.begin(), vHeap.end(), comp);
+}
+
+bool CAddressIndexMergeCursor::SeekAfter(const CAddressIndexKey& keyAfter)
+{
+    size_t nPos = vSources.size();
+    for (size_t i = 0; i < vSources.size(); i++) {
+        if (vSources[i]->type == keyAfter.type && vSources[i]->hashBytes == keyAfter.hashBytes) {
+            nPos = i;
+            break;
+        }
+    }
+    if (nPos == vSources.size())
+        return false;
+
+    for (size_t i = 0; i < vSources.size(); i++) {
+        CSource& source = *vSources[i];
+        if (i == nPos) {
+            source.pcursor->Seek(make_pair(DB_ADDRESSINDEX, keyAfter));
+            if (ReadEntry(source) && source.key == keyAfter)
+                source.pcursor->Next();
+            continue;
+        }
+        // Entries of the same transaction come before keyAfter for the
+        // addresses given before its own, and after it for the others.
+        source.SeekToStart(std::max(nStart, keyAfter.blockHeight));
+        while (ReadEntry(source)) {
+            bool fBefore = source.key.blockHeight < keyAfter.blockHeight ||
+                (source.key.blockHeight == keyAfter.blockHeight &&
+                 (source.key.txindex < keyAfter.txindex || (source.key.txindex == keyAfter.txindex && i < nPos)));
+            if (!fBefore)
+                break;
+            source.pcursor->Next();
+        }
+    }
+    BuildHeap();
+    return true;
+}
+
+const CAddressIndexKey& CAddressIndexMergeCursor::GetKey() const
+{
+    assert(Valid());
+    return vSources[vHeap.front()]->key;
+}
+
+CAmount CAddressIndexMergeCursor::GetValue() const
+{
+    assert(Valid());
+    return vSources[vHeap.front()]->value;
+}
+
+void CAddressIndexMergeCursor::Next()
+{
+    assert(Valid());
+    CHeapOrder comp(this);
+    std::pop_heap(vHeap.begin(), vHeap.end(), comp);
+    CSource& source = *vSources[vHeap.back()];
+    source.pcursor->Next();
+    if (ReadEntry(source)) {
+        std::push_heap(vHeap.begin(), vHeap.end(), comp);
+    } else {
+        vHeap.pop_back();
+    }
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(&GetObfuscateKey());
     batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -70,12 +70,14 @@ public:
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CAddressUnspentKey* pkeyAfter = NULL, size_t nLimit = 0);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0,
+                          const CAddressIndexKey* pkeyAfter = NULL, size_t nLimit = 0);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
@@ -83,4 +85,50 @@ public:
     bool LoadBlockIndexGuts();
 };
 
+/**
+ * Walks the address index entries of several addresses at once, merged into
+ * block order: by height, then by position of the transaction in the block.
+ * All entries of a transaction are adjacent, so txids can be deduplicated by
+ * comparing with the previous entry. Entries of one transaction for different
+ * addresses come in the order the addresses were given.
+ *
+ * Each address has its own database cursor, positioned at the start of the
+ * height range, and is read lazily; a heap picks the next entry.
+ */
+class CAddressIndexMergeCursor
+{
+private:
+    struct CSource;
+    struct CHeapOrder;
+
+    //! one cursor per address, in the order the addresses were given
+    std::vector<CSource*> vSources;
+
+    //! positions in vSources of the sources which have a current entry
+    std::vector<size_t> vHeap;
+
+    int nStart;
+    int nEnd;
+
+    bool ReadEntry(CSource& source);
+    bool IsBefore(size_t a, size_t b) const;
+    void BuildHeap();
+
+    CAddressIndexMergeCursor(const CAddressIndexMergeCursor&);
+    CAddressIndexMergeCursor& operator=(const CAddressIndexMergeCursor&);
+
+public:
+    /** Entries in [start, end] if both are above 0, otherwise all entries */
+    CAddressIndexMergeCursor(CDBWrapper& db, const std::vector<std::pair<uint160, int> >& addresses, int start = 0, int end = 0);
+    ~CAddressIndexMergeCursor();
+
+    /** Continue right after key, as returned by GetKey. Returns false if its address was not requested. */
+    bool SeekAfter(const CAddressIndexKey& key);
+
+    bool Valid() const { return !vHeap.empty(); }
+    const CAddressIndexKey& GetKey() const;
+    CAmount GetValue() const;
+    void Next();
+};
+
 #endif // BITCOIN_TXDB_H
@@ -159,6 +159,53 @@ public:
     friend const UniValue& find_value( const UniValue& obj, const std::string& name);
 };
 
+//
+// Incremental JSON emitter, for documents too large to build as a complete
+// UniValue tree first. Output is compact (as write() without indentation)
+// and is handed to flushChunk() in pieces of about chunkSize bytes.
+// Anything still buffered is only emitted by an explicit flush().
+//
+class UniValueStreamWriter {
+public:
+    explicit UniValueStreamWriter(size_t chunkSizeIn = 64 * 1024);
+    virtual ~UniValueStreamWriter() {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const std::string& k);
+    void value(const UniValue& val);
+    void pushKV(const std::string& k, const UniValue& val) {
+        key(k);
+        value(val);
+    }
+    // Write all members of obj into the currently open object
+    void pushKVs(const UniValue& obj);
+    void flush();
+
+    // Number of bytes written so far, flushed or not
+    size_t size() const { return written + buf.size(); }
+
+protected:
+    virtual void flushChunk(const char *data, size_t len) = 0;
+
+private:
+    std::string buf;
+    size_t chunkSize;
+    size_t written;
+    std::string openScopes;         // '{' or '[' per open container
+    std::vector<bool> scopeHasItems;
+    bool afterKey;
+
+    void separate();
+    void writeValue(const UniValue& val);
+    void maybeFlush() {
+        if (buf.size() >= chunkSize)
+            flush();
+    }
+};
+
 //
 // The following were added for compatibility with json_spirit.
 // Most duplicate other methods, and should be removed.
@@ -115,3 +115,126 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     s += "}";
 }
 
+
+UniValueStreamWriter::UniValueStreamWriter(size_t chunkSizeIn)
+    : chunkSize(chunkSizeIn), written(0), afterKey(false)
+{
+    buf.reserve(chunkSize);
+}
+
+void UniValueStreamWriter::separate()
+{
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    if (!scopeHasItems.empty()) {
+        if (scopeHasItems.back())
+            buf += ",";
+        scopeHasItems.back() = true;
+    }
+}
+
+void UniValueStreamWriter::beginObject()
+{
+    separate();
+    buf += "{";
+    openScopes += '{';
+    scopeHasItems.push_back(false);
+}
+
+void UniValueStreamWriter::endObject()
+{
+    assert(!openScopes.empty() && openScopes[openScopes.size() - 1] == '{' && !afterKey);
+    buf += "}";
+    openScopes.erase(openScopes.size() - 1);
+    scopeHasItems.pop_back();
+    maybeFlush();
+}
+
+void UniValueStreamWriter::beginArray()
+{
+    separate();
+    buf += "[";
+    openScopes += '[';
+    scopeHasItems.push_back(false);
+}
+
+void UniValueStreamWriter::endArray()
+{
+    assert(!openScopes.empty() && openScopes[openScopes.size() - 1] == '[');
+    buf += "]";
+    openScopes.erase(openScopes.size() - 1);
+    scopeHasItems.pop_back();
+    maybeFlush();
+}
+
+void UniValueStreamWriter::key(const string& k)
+{
+    assert(!openScopes.empty() && openScopes[openScopes.size() - 1] == '{' && !afterKey);
+    separate();
+    buf += "\"" + json_escape(k) + "\":";
+    afterKey = true;
+}
+
+void UniValueStreamWriter::value(const UniValue& val)
+{
+    assert(afterKey || openScopes.empty() || openScopes[openScopes.size() - 1] == '[');
+    separate();
+    writeValue(val);
+    maybeFlush();
+}
+
+void UniValueStreamWriter::pushKVs(const UniValue& obj)
+{
+    assert(obj.isObject());
+    const vector<string>& keys = obj.getKeys();
+    const vector<UniValue>& values = obj.getValues();
+    for (unsigned int i = 0; i < keys.size(); i++)
+        pushKV(keys[i], values[i]);
+}
+
+void UniValueStreamWriter::writeValue(const UniValue& val)
+{
+    switch (val.getType()) {
+    case UniValue::VOBJ: {
+        const vector<string>& keys = val.getKeys();
+        const vector<UniValue>& values = val.getValues();
+        buf += "{";
+        for (unsigned int i = 0; i < keys.size(); i++) {
+            if (i)
+                buf += ",";
+            buf += "\"" + json_escape(keys[i]) + "\":";
+            writeValue(values[i]);
+            maybeFlush();
+        }
+        buf += "}";
+        break;
+    }
+    case UniValue::VARR: {
+        const vector<UniValue>& values = val.getValues();
+        buf += "[";
+        for (unsigned int i = 0; i < values.size(); i++) {
+            if (i)
+                buf += ",";
+            writeValue(values[i]);
+            maybeFlush();
+        }
+        buf += "]";
+        break;
+    }
+    default:
+        // Scalars are written the same way as by UniValue::write()
+        buf += val.write();
+        break;
+    }
+}
+
+void UniValueStreamWriter::flush()
+{
+    if (buf.empty())
+        return;
+    flushChunk(buf.data(), buf.size());
+    written += buf.size();
+    buf.clear();
+}
@@ -76,6 +76,11 @@
 #include <sys/prctl.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp> // for startswith() and endswith()
@@ -885,6 +890,20 @@ void RenameThread(const char* name)
 #endif
 }
 
+bool PinThread(int nCore)
+{
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(nCore, &cpuset);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+#else
+    // Prevent warnings for unused parameters...
+    (void)nCore;
+    return false;
+#endif
+}
+
 std::string GetThreadName()
 {
     char name[16];
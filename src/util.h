@@ -248,6 +248,8 @@ int GetNumCores();
 
 void SetThreadPriority(int nPriority);
 void RenameThread(const char* name);
+/** Restrict the current thread to one CPU core, returns false where unsupported */
+bool PinThread(int nCore);
 std::string GetThreadName();
 
 /**
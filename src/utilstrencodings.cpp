@@ -92,6 +92,42 @@ vector<unsigned char> ParseHex(const string& str)
     return ParseHex(str.c_str());
 }
 
+/** Both hex digits of every byte value, so that a byte is encoded with one lookup */
+static struct CHexPairTable
+{
+    char pairs[256][2];
+
+    CHexPairTable()
+    {
+        static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+        for (int i = 0; i < 256; i++) {
+            pairs[i][0] = hexmap[i >> 4];
+            pairs[i][1] = hexmap[i & 15];
+        }
+    }
+} hexPairTable;
+
+void HexEncode(const unsigned char* pch, size_t len, char* pout)
+{
+    // Unrolled by 8, which lets the compiler keep the table lookups in flight
+    const unsigned char* pchEnd8 = pch + (len & ~(size_t)7);
+    while (pch < pchEnd8) {
+        memcpy(pout + 0, hexPairTable.pairs[pch[0]], 2);
+        memcpy(pout + 2, hexPairTable.pairs[pch[1]], 2);
+        memcpy(pout + 4, hexPairTable.pairs[pch[2]], 2);
+        memcpy(pout + 6, hexPairTable.pairs[pch[3]], 2);
+        memcpy(pout + 8, hexPairTable.pairs[pch[4]], 2);
+        memcpy(pout + 10, hexPairTable.pairs[pch[5]], 2);
+        memcpy(pout + 12, hexPairTable.pairs[pch[6]], 2);
+        memcpy(pout + 14, hexPairTable.pairs[pch[7]], 2);
+        pch += 8;
+        pout += 16;
+    }
+    for (size_t i = 0; i < (len & 7); i++)
+        memcpy(pout + 2 * i, hexPairTable.pairs[pch[i]], 2);
+}
+
 string EncodeBase64(const unsigned char* pch, size_t len)
 {
     static const char *pbase64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -39,6 +39,8 @@ enum SafeChars
 std::string SanitizeString(const std::string& str, int rule = SAFE_CHARS_DEFAULT);
 std::vector<unsigned char> ParseHex(const char* psz);
 std::vector<unsigned char> ParseHex(const std::string& str);
+/** Write the lowercase hex encoding of len bytes to pout, which must hold 2 * len chars */
+void HexEncode(const unsigned char* pch, size_t len, char* pout);
 signed char HexDigit(char c);
 bool IsHex(const std::string& str);
 std::vector<unsigned char> DecodeBase64(const char* p, bool* pfInvalid = NULL);
@@ -0,0 +1,766 @@
+// Copyright (c) 2012-2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/wallet.h"
+
+#include "base58.h"
+#include "coincontrol.h"
+#include "consensus/validation.h"
+#include "darksend.h"
+#include "instantx.h"
+#include "main.h"
+#include "script/sign.h"
+#include "script/standard.h"
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "test/test_dash.h"
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+extern CWallet* pwalletMain;
+
+// The wallet keeps PrivateSend rounds, balances and an index of spendable
+// coins, with denominated ones bucketed by denomination and rounds, up to
+// date as transactions come in instead of working them out on every call.
+// These tests check the cached values against a recomputation from scratch.
+
+/**
+ * A wallet holding the coinbase key of a chain with a few mature coinbases.
+ * It also watches the script of keyWatch, and knows nothing of keyOther.
+ */
+struct WalletCacheTestingSetup : public TestChain100Setup {
+    CScript scriptCoinbase;
+    CKey keyWatch;
+    CKey keyOther;
+    CScript scriptWatch;
+    CScript scriptOther;
+    CBasicKeyStore keystoreOther;
+    //! Transactions made by CreateSpend, which need not be in the wallet yet
+    std::map<uint256, CTransaction> mapCreated;
+
+    WalletCacheTestingSetup()
+    {
+        darkSendPool.InitDenominations();
+        // The blocks CreateAndProcessBlock makes leave the mempool out, but
+        // their coinbase claims its fees: mempool txs go without fees
+        mapArgs["-relaypriority"] = "0";
+        scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        keyWatch.MakeNewKey(true);
+        keyOther.MakeNewKey(true);
+        scriptWatch = GetScriptForDestination(keyWatch.GetPubKey().GetID());
+        scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+        keystoreOther.AddKey(keyWatch);
+        keystoreOther.AddKey(keyOther);
+        // coinbaseTxns[0..9] mature
+        for (int i = 0; i < 10; i++)
+            Mine(std::vector<CMutableTransaction>());
+
+        {
+            LOCK(pwalletMain->cs_wallet);
+            pwalletMain->AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+            pwalletMain->AddWatchOnly(scriptWatch);
+        }
+        pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+    }
+
+    ~WalletCacheTestingSetup()
+    {
+        mapArgs.erase("-relaypriority");
+    }
+
+    CBlock Mine(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
+    {
+        CBlock block = CreateAndProcessBlock(txns, scriptPubKey);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        return block;
+    }
+
+    CBlock Mine(const std::vector<CMutableTransaction>& txns)
+    {
+        return Mine(txns, scriptCoinbase);
+    }
+
+    CBlock Mine(const CMutableTransaction& tx)
+    {
+        return Mine(std::vector<CMutableTransaction>(1, tx));
+    }
+
+    /**
+     * A transaction spending vPrevouts, one output per amount. The outputs go
+     * to scriptPubKey, or to new keys of the wallet if it is empty.
+     */
+    CMutableTransaction CreateSpend(const std::vector<COutPoint>& vPrevouts, const std::vector<CAmount>& vAmounts, const CScript& scriptPubKey = CScript())
+    {
+        LOCK(pwalletMain->cs_wallet);
+
+        CMutableTransaction tx;
+        BOOST_FOREACH(const COutPoint& prevout, vPrevouts)
+            tx.vin.push_back(CTxIn(prevout));
+        BOOST_FOREACH(CAmount nAmount, vAmounts)
+            tx.vout.push_back(CTxOut(nAmount, scriptPubKey.empty() ? GetScriptForDestination(pwalletMain->GenerateNewKey().GetID()) : scriptPubKey));
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            const uint256& hashPrev = tx.vin[i].prevout.hash;
+            const CTransaction& txPrev = mapCreated.count(hashPrev) ? mapCreated[hashPrev] : pwalletMain->mapWallet[hashPrev];
+            BOOST_CHECK(SignSignature(*pwalletMain, txPrev, tx, i) || SignSignature(keystoreOther, txPrev, tx, i));
+        }
+        mapCreated[tx.GetHash()] = tx;
+        return tx;
+    }
+
+    CMutableTransaction CreateSpend(const COutPoint& prevout, const std::vector<CAmount>& vAmounts, const CScript& scriptPubKey = CScript())
+    {
+        return CreateSpend(std::vector<COutPoint>(1, prevout), vAmounts, scriptPubKey);
+    }
+
+    bool ToMemPool(const CMutableTransaction& tx)
+    {
+        LOCK(cs_main);
+
+        CValidationState state;
+        return AcceptToMemoryPool(mempool, state, tx, false, NULL, true, false);
+    }
+
+    COutPoint Coinbase(int nIndex)
+    {
+        return COutPoint(coinbaseTxns[nIndex].GetHash(), 0);
+    }
+
+    CAmount GetValue(const COutPoint& outpoint)
+    {
+        LOCK(pwalletMain->cs_wallet);
+        return mapCreated.count(outpoint.hash) ? mapCreated[outpoint.hash].vout[outpoint.n].nValue : pwalletMain->mapWallet[outpoint.hash].vout[outpoint.n].nValue;
+    }
+};
+
+/** GetRealInputPrivateSendRounds without the rounds cache */
+static int RecomputePrivateSendRounds(const CTxIn& txin, int nRounds)
+{
+    if (nRounds >= 16) return 15;
+
+    const CWalletTx* wtx = pwalletMain->GetWalletTx(txin.prevout.hash);
+    if (wtx == NULL) return nRounds - 1;
+    if (txin.prevout.n >= wtx->vout.size()) return -4;
+
+    CAmount nValue = wtx->vout[txin.prevout.n].nValue;
+    if (pwalletMain->IsCollateralAmount(nValue)) return -3;
+    if (!pwalletMain->IsDenominatedAmount(nValue)) return -2;
+    BOOST_FOREACH(const CTxOut& txout, wtx->vout) {
+        if (!pwalletMain->IsDenominatedAmount(txout.nValue)) return 0;
+    }
+
+    int nShortest = -1;
+    BOOST_FOREACH(const CTxIn& txinNext, wtx->vin) {
+        if (!pwalletMain->IsMine(txinNext)) continue;
+        int n = RecomputePrivateSendRounds(txinNext, nRounds + 1);
+        if (n >= 0 && (nShortest < 0 || n < nShortest))
+            nShortest = n;
+    }
+    if (nShortest < 0) return 0;
+    return nShortest >= 15 ? 16 : nShortest + 1;
+}
+
+static void CheckPrivateSendRounds()
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+    for (std::map<uint256, CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        for (unsigned int i = 0; i < it->second.vout.size(); i++) {
+            CTxIn txin(it->first, i);
+            BOOST_CHECK_EQUAL(pwalletMain->GetRealInputPrivateSendRounds(txin, 0), RecomputePrivateSendRounds(txin, 0));
+        }
+    }
+}
+
+/** The balances as the wallet used to get them, by a scan of all its transactions */
+static CWalletBalances RecomputeBalances()
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    CWalletBalances balances;
+    for (std::map<uint256, CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        const CWalletTx& wtx = it->second;
+        if (wtx.IsTrusted()) {
+            balances.nTrusted += wtx.GetAvailableCredit(false);
+            balances.nWatchTrusted += wtx.GetAvailableWatchOnlyCredit(false);
+            balances.nAnonymized += wtx.GetAnonymizedCredit(false);
+        } else if (wtx.GetDepthInMainChain() == 0 && wtx.InMempool()) {
+            balances.nUnconfirmed += wtx.GetAvailableCredit(false);
+            balances.nWatchUnconfirmed += wtx.GetAvailableWatchOnlyCredit(false);
+        }
+        balances.nImmature += wtx.GetImmatureCredit(false);
+        balances.nWatchImmature += wtx.GetImmatureWatchOnlyCredit(false);
+        balances.nDenomConfirmed += wtx.GetDenominatedCredit(false, false);
+        balances.nDenomUnconfirmed += wtx.GetDenominatedCredit(true, false);
+    }
+    return balances;
+}
+
+static void CheckBalances()
+{
+    CWalletBalances balances = RecomputeBalances();
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalance(), balances.nTrusted);
+    BOOST_CHECK_EQUAL(pwalletMain->GetUnconfirmedBalance(), balances.nUnconfirmed);
+    BOOST_CHECK_EQUAL(pwalletMain->GetImmatureBalance(), balances.nImmature);
+    BOOST_CHECK_EQUAL(pwalletMain->GetWatchOnlyBalance(), balances.nWatchTrusted);
+    BOOST_CHECK_EQUAL(pwalletMain->GetUnconfirmedWatchOnlyBalance(), balances.nWatchUnconfirmed);
+    BOOST_CHECK_EQUAL(pwalletMain->GetImmatureWatchOnlyBalance(), balances.nWatchImmature);
+    BOOST_CHECK_EQUAL(pwalletMain->GetAnonymizedBalance(), balances.nAnonymized);
+    BOOST_CHECK_EQUAL(pwalletMain->GetDenominatedBalance(false), balances.nDenomConfirmed);
+    BOOST_CHECK_EQUAL(pwalletMain->GetDenominatedBalance(true), balances.nDenomUnconfirmed);
+}
+
+typedef std::set<std::pair<COutPoint, std::pair<int, bool> > > OutputSet;
+
+static OutputSet ToOutputSet(const std::vector<COutput>& vCoins)
+{
+    OutputSet setCoins;
+    BOOST_FOREACH(const COutput& out, vCoins)
+        setCoins.insert(std::make_pair(COutPoint(out.tx->GetHash(), out.i), std::make_pair(out.nDepth, out.fSpendable)));
+    return setCoins;
+}
+
+/** AvailableCoins as it was, walking every output of every wallet transaction */
+static OutputSet RecomputeAvailableCoins(bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend)
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    std::vector<COutput> vCoins;
+    for (std::map<uint256, CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        const uint256& wtxid = it->first;
+        const CWalletTx* pcoin = &it->second;
+
+        if (!CheckFinalTx(*pcoin))
+            continue;
+        if (fOnlyConfirmed && !pcoin->IsTrusted())
+            continue;
+        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+            continue;
+        int nDepth = pcoin->GetDepthInMainChain(false);
+        if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+            continue;
+        if (nDepth == 0 && !pcoin->InMempool())
+            continue;
+
+        for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+            CAmount nValue = pcoin->vout[i].nValue;
+            bool found = false;
+            if (nCoinType == ONLY_DENOMINATED) {
+                found = pwalletMain->IsDenominatedAmount(nValue);
+            } else if (nCoinType == ONLY_NOT1000IFMN) {
+                found = !(fMasterNode && nValue == 1000*COIN);
+            } else if (nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
+                if (pwalletMain->IsCollateralAmount(nValue)) continue;
+                found = !pwalletMain->IsDenominatedAmount(nValue);
+                if (found && fMasterNode) found = nValue != 1000*COIN;
+            } else if (nCoinType == ONLY_1000) {
+                found = nValue == 1000*COIN;
+            } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                found = pwalletMain->IsCollateralAmount(nValue);
+            } else {
+                found = true;
+            }
+            if (!found) continue;
+
+            isminetype mine = pwalletMain->IsMine(pcoin->vout[i]);
+            if (!pwalletMain->IsSpent(wtxid, i) && mine != ISMINE_NO &&
+                (!pwalletMain->IsLockedCoin(wtxid, i) || nCoinType == ONLY_1000) &&
+                (nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
+        }
+    }
+    return ToOutputSet(vCoins);
+}
+
+/** Compare AvailableCoins with every filter, coin control selecting vSelected */
+static void CheckAvailableCoins(const std::vector<COutPoint>& vSelected)
+{
+    CCoinControl coinControlSelected;
+    BOOST_FOREACH(const COutPoint& outpoint, vSelected)
+        coinControlSelected.Select(outpoint);
+    CCoinControl coinControlOthers = coinControlSelected;
+    coinControlOthers.fAllowOtherInputs = true;
+    CCoinControl coinControlWatch;
+    coinControlWatch.fAllowWatchOnly = true;
+
+    std::vector<const CCoinControl*> vCoinControls;
+    vCoinControls.push_back(NULL);
+    vCoinControls.push_back(&coinControlSelected);
+    vCoinControls.push_back(&coinControlOthers);
+    vCoinControls.push_back(&coinControlWatch);
+
+    bool fMasterNodeOld = fMasterNode;
+    for (int nMasterNode = 0; nMasterNode < 2; nMasterNode++) {
+        fMasterNode = nMasterNode == 1;
+        for (int nCoinType = ALL_COINS; nCoinType <= ONLY_PRIVATESEND_COLLATERAL; nCoinType++) {
+            for (int nFlags = 0; nFlags < 8; nFlags++) {
+                bool fOnlyConfirmed = nFlags & 1;
+                bool fIncludeZeroValue = nFlags & 2;
+                bool fUseInstantSend = nFlags & 4;
+                BOOST_FOREACH(const CCoinControl* coinControl, vCoinControls) {
+                    std::vector<COutput> vCoins;
+                    pwalletMain->AvailableCoins(vCoins, fOnlyConfirmed, coinControl, fIncludeZeroValue, (AvailableCoinsType)nCoinType, fUseInstantSend);
+                    BOOST_CHECK(ToOutputSet(vCoins) == RecomputeAvailableCoins(fOnlyConfirmed, coinControl, fIncludeZeroValue, (AvailableCoinsType)nCoinType, fUseInstantSend));
+                }
+            }
+        }
+    }
+    fMasterNode = fMasterNodeOld;
+}
+
+/** The coins SelectCoinsByDenominations used to pick from when it may take them all */
+static std::set<COutPoint> RecomputeDenominatedCoins(int nDenom, int nRoundsMin, int nRoundsMax)
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    std::vector<int> vecBits;
+    darkSendPool.GetDenominationsBits(nDenom, vecBits);
+
+    std::set<COutPoint> setCoins;
+    OutputSet setAvailable = RecomputeAvailableCoins(true, NULL, false, ONLY_DENOMINATED, false);
+    for (OutputSet::const_iterator it = setAvailable.begin(); it != setAvailable.end(); ++it) {
+        const COutPoint& outpoint = it->first;
+        int nRounds = std::min(RecomputePrivateSendRounds(CTxIn(outpoint), 0), nPrivateSendRounds);
+        if (nRounds < nRoundsMin || nRounds >= nRoundsMax) continue;
+        BOOST_FOREACH(int nBit, vecBits) {
+            if (pwalletMain->mapWallet[outpoint.hash].vout[outpoint.n].nValue == vecPrivateSendDenominations[nBit])
+                setCoins.insert(outpoint);
+        }
+    }
+    return setCoins;
+}
+
+/** CountInputsWithAmount as it was, walking every output of every wallet transaction */
+static int RecomputeInputsWithAmount(CAmount nInputAmount)
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    int nTotal = 0;
+    for (std::map<uint256, CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        const CWalletTx& wtx = it->second;
+        if (!wtx.IsTrusted()) continue;
+        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+            if (wtx.vout[i].nValue != nInputAmount) continue;
+            if (!pwalletMain->IsDenominatedAmount(wtx.vout[i].nValue)) continue;
+            if (pwalletMain->IsSpent(it->first, i) || pwalletMain->IsMine(wtx.vout[i]) != ISMINE_SPENDABLE) continue;
+            nTotal++;
+        }
+    }
+    return nTotal;
+}
+
+typedef std::set<std::pair<std::string, std::pair<CAmount, std::set<COutPoint> > > > TallySet;
+
+static TallySet ToTallySet(const std::vector<CompactTallyItem>& vecTally)
+{
+    TallySet setTally;
+    BOOST_FOREACH(const CompactTallyItem& item, vecTally) {
+        std::set<COutPoint> setOutpoints;
+        BOOST_FOREACH(const CTxIn& txin, item.vecTxIn)
+            setOutpoints.insert(txin.prevout);
+        setTally.insert(std::make_pair(item.address.ToString(), std::make_pair(item.nAmount, setOutpoints)));
+    }
+    return setTally;
+}
+
+/** SelectCoinsGrouppedByAddresses as it was, tallying every output of every wallet transaction */
+static TallySet RecomputeTally(bool fSkipDenominated, bool fAnonymizable, bool fSkipUnconfirmed)
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    std::map<CBitcoinAddress, CompactTallyItem> mapTally;
+    for (std::map<uint256, CWalletTx>::const_iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); ++it) {
+        const CWalletTx& wtx = it->second;
+        if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
+        if (fSkipUnconfirmed && !wtx.IsTrusted()) continue;
+
+        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+            CAmount nValue = wtx.vout[i].nValue;
+            CTxDestination address;
+            if (!ExtractDestination(wtx.vout[i].scriptPubKey, address)) continue;
+            if (!(::IsMine(*pwalletMain, address) & ISMINE_SPENDABLE)) continue;
+            if (pwalletMain->IsSpent(it->first, i) || pwalletMain->IsLockedCoin(it->first, i)) continue;
+            if (fSkipDenominated && pwalletMain->IsDenominatedAmount(nValue)) continue;
+            if (fAnonymizable) {
+                if (pwalletMain->IsCollateralAmount(nValue)) continue;
+                if (fMasterNode && nValue == 1000*COIN) continue;
+                if (nValue <= vecPrivateSendDenominations.back()/10) continue;
+                if (std::min(RecomputePrivateSendRounds(CTxIn(it->first, i), 0), nPrivateSendRounds) >= nPrivateSendRounds) continue;
+            }
+
+            CompactTallyItem& item = mapTally[address];
+            item.address = address;
+            item.nAmount += nValue;
+            item.vecTxIn.push_back(CTxIn(it->first, i));
+        }
+    }
+
+    std::vector<CompactTallyItem> vecTally;
+    for (std::map<CBitcoinAddress, CompactTallyItem>::const_iterator it = mapTally.begin(); it != mapTally.end(); ++it) {
+        if (fAnonymizable && it->second.nAmount < vecPrivateSendDenominations.back()) continue;
+        vecTally.push_back(it->second);
+    }
+    return ToTallySet(vecTally);
+}
+
+/** Compare mixing candidates, counts and tallies for every denomination and rounds range */
+static void CheckDenominatedCoins()
+{
+    std::vector<std::pair<int, int> > vRounds;
+    vRounds.push_back(std::make_pair(0, nPrivateSendRounds));
+    vRounds.push_back(std::make_pair(0, 1));
+    vRounds.push_back(std::make_pair(1, 2));
+    vRounds.push_back(std::make_pair(2, 16));
+    vRounds.push_back(std::make_pair(nPrivateSendRounds, 16));
+
+    for (int nDenom = 1; nDenom < (1 << vecPrivateSendDenominations.size()); nDenom++) {
+        for (unsigned int i = 0; i < vRounds.size(); i++) {
+            // a minimum that is never reached makes it take every candidate
+            std::vector<CTxIn> vecTxIn;
+            std::vector<COutput> vCoins;
+            CAmount nValue;
+            pwalletMain->SelectCoinsByDenominations(nDenom, MAX_MONEY, MAX_MONEY, vecTxIn, vCoins, nValue, vRounds[i].first, vRounds[i].second);
+            std::set<COutPoint> setSelected;
+            CAmount nValueSelected = 0;
+            BOOST_FOREACH(const COutput& out, vCoins) {
+                setSelected.insert(COutPoint(out.tx->GetHash(), out.i));
+                nValueSelected += out.tx->vout[out.i].nValue;
+            }
+            BOOST_CHECK_EQUAL(vecTxIn.size(), vCoins.size());
+            BOOST_CHECK_EQUAL(nValue, nValueSelected);
+            std::set<COutPoint> setExpected = RecomputeDenominatedCoins(nDenom, vRounds[i].first, vRounds[i].second);
+            BOOST_CHECK(setSelected == setExpected);
+
+            // the usual call takes some of them
+            pwalletMain->SelectCoinsByDenominations(nDenom, vecPrivateSendDenominations.back(), MAX_MONEY, vecTxIn, vCoins, nValue, vRounds[i].first, vRounds[i].second);
+            BOOST_FOREACH(const CTxIn& txin, vecTxIn)
+                BOOST_CHECK(setExpected.count(txin.prevout));
+        }
+    }
+
+    BOOST_FOREACH(CAmount nAmount, vecPrivateSendDenominations)
+        BOOST_CHECK_EQUAL(pwalletMain->CountInputsWithAmount(nAmount), RecomputeInputsWithAmount(nAmount));
+    BOOST_CHECK_EQUAL(pwalletMain->CountInputsWithAmount(COIN), 0);
+
+    // Confirmed anonymizable tallies are cached outside of the index
+    for (int nFlags = 0; nFlags < 8; nFlags++) {
+        bool fSkipDenominated = nFlags & 1;
+        bool fAnonymizable = nFlags & 2;
+        bool fSkipUnconfirmed = nFlags & 4;
+        if (fAnonymizable && fSkipUnconfirmed) continue;
+        std::vector<CompactTallyItem> vecTally;
+        pwalletMain->SelectCoinsGrouppedByAddresses(vecTally, fSkipDenominated, fAnonymizable, fSkipUnconfirmed);
+        BOOST_CHECK(ToTallySet(vecTally) == RecomputeTally(fSkipDenominated, fAnonymizable, fSkipUnconfirmed));
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(wallet_cache_tests, WalletCacheTestingSetup)
+
+BOOST_AUTO_TEST_CASE(wallet_cache_privatesend_rounds)
+{
+    CAmount nDenom = vecPrivateSendDenominations[1];
+    CAmount nSmallDenom = vecPrivateSendDenominations[2];
+
+    // Splitting a coinbase into denominations only starts at round 0
+    CMutableTransaction txSplit = CreateSpend(Coinbase(0), std::vector<CAmount>(4, nDenom));
+    Mine(txSplit);
+    CheckPrivateSendRounds();
+
+    // Every tx of denominations only adds a round, confirmed or not
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(COutPoint(txSplit.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txSplit.GetHash(), 1));
+    CMutableTransaction txMix1 = CreateSpend(vPrevouts, std::vector<CAmount>(19, nSmallDenom));
+    BOOST_CHECK(ToMemPool(txMix1));
+    CheckPrivateSendRounds();
+
+    vPrevouts.clear();
+    for (int i = 0; i < 10; i++)
+        vPrevouts.push_back(COutPoint(txMix1.GetHash(), i));
+    CMutableTransaction txMix2 = CreateSpend(vPrevouts, std::vector<CAmount>(9, nSmallDenom));
+    std::vector<CMutableTransaction> vTxns;
+    vTxns.push_back(txMix1);
+    vTxns.push_back(txMix2);
+    Mine(vTxns);
+    CheckPrivateSendRounds();
+    BOOST_CHECK_EQUAL(pwalletMain->GetInputPrivateSendRounds(CTxIn(txMix2.GetHash(), 0)), 2);
+
+    // Spending mixed coins together with change, collateral and other amounts
+    vPrevouts.clear();
+    vPrevouts.push_back(COutPoint(txMix2.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txSplit.GetHash(), 2));
+    std::vector<CAmount> vAmounts;
+    vAmounts.push_back(nSmallDenom);
+    vAmounts.push_back(PRIVATESEND_COLLATERAL * 4);
+    vAmounts.push_back(COIN);
+    Mine(CreateSpend(vPrevouts, vAmounts));
+    CheckPrivateSendRounds();
+
+    // Children can come in before their parents, e.g. on rescans
+    CMutableTransaction txParent = CreateSpend(COutPoint(txSplit.GetHash(), 3), std::vector<CAmount>(9, nSmallDenom));
+    vPrevouts.clear();
+    vPrevouts.push_back(COutPoint(txParent.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txParent.GetHash(), 1));
+    CMutableTransaction txChild = CreateSpend(vPrevouts, std::vector<CAmount>(1, nSmallDenom));
+    pwalletMain->SyncTransaction(txChild, NULL);
+    CheckPrivateSendRounds();
+    pwalletMain->SyncTransaction(txParent, NULL);
+    CheckPrivateSendRounds();
+    BOOST_CHECK_EQUAL(pwalletMain->GetInputPrivateSendRounds(CTxIn(txChild.GetHash(), 0)), 2);
+
+    // Nothing changes when the wallet caches are dropped
+    pwalletMain->MarkDirty();
+    CheckPrivateSendRounds();
+}
+
+BOOST_AUTO_TEST_CASE(wallet_cache_balances)
+{
+    CheckBalances();
+    BOOST_CHECK(pwalletMain->GetBalance() > 0);
+    BOOST_CHECK(pwalletMain->GetImmatureBalance() > 0);
+
+    // New coinbases are immature, mined ones mature
+    Mine(std::vector<CMutableTransaction>());
+    CheckBalances();
+
+    // Spending to ourselves in the mempool keeps the change trusted
+    std::vector<CAmount> vAmounts;
+    vAmounts.push_back(10 * COIN);
+    vAmounts.push_back(vecPrivateSendDenominations[1]);
+    vAmounts.push_back(vecPrivateSendDenominations[2]);
+    vAmounts.push_back(GetValue(Coinbase(1)) - 10 * COIN - vecPrivateSendDenominations[1] - vecPrivateSendDenominations[2]);
+    BOOST_CHECK(ToMemPool(CreateSpend(Coinbase(1), vAmounts)));
+    CheckBalances();
+
+    // Payments from a key we do not know stay unconfirmed until mined
+    CAmount nValue = GetValue(Coinbase(2));
+    CMutableTransaction txOther = CreateSpend(Coinbase(2), std::vector<CAmount>(1, nValue), scriptOther);
+    Mine(txOther);
+    CheckBalances();
+    CMutableTransaction txFromOther = CreateSpend(COutPoint(txOther.GetHash(), 0), std::vector<CAmount>(1, nValue));
+    BOOST_CHECK(ToMemPool(txFromOther));
+    CheckBalances();
+    BOOST_CHECK_EQUAL(pwalletMain->GetUnconfirmedBalance(), nValue);
+    Mine(txFromOther);
+    CheckBalances();
+    BOOST_CHECK_EQUAL(pwalletMain->GetUnconfirmedBalance(), 0);
+
+    // Watch-only payments and coinbases
+    nValue = GetValue(Coinbase(3));
+    Mine(CreateSpend(Coinbase(3), std::vector<CAmount>(1, nValue), scriptWatch));
+    Mine(std::vector<CMutableTransaction>(), scriptWatch);
+    CheckBalances();
+    BOOST_CHECK_EQUAL(pwalletMain->GetWatchOnlyBalance(), nValue);
+    BOOST_CHECK(pwalletMain->GetImmatureWatchOnlyBalance() > 0);
+
+    // A mempool tx conflicted by a block
+    nValue = GetValue(Coinbase(4));
+    CMutableTransaction txConflicted = CreateSpend(Coinbase(4), std::vector<CAmount>(1, nValue));
+    BOOST_CHECK(ToMemPool(txConflicted));
+    CheckBalances();
+    vAmounts.clear();
+    vAmounts.push_back(nValue / 2);
+    vAmounts.push_back(nValue - nValue / 2);
+    Mine(CreateSpend(Coinbase(4), vAmounts));
+    CheckBalances();
+    BOOST_CHECK(pwalletMain->mapWallet[txConflicted.GetHash()].GetDepthInMainChain() < 0);
+
+    // Abandoning a tx that never made it to the mempool frees its inputs
+    CAmount nBalance = pwalletMain->GetBalance();
+    CMutableTransaction txAbandoned = CreateSpend(Coinbase(5), std::vector<CAmount>(1, GetValue(Coinbase(5))));
+    pwalletMain->SyncTransaction(txAbandoned, NULL);
+    CheckBalances();
+    BOOST_CHECK(pwalletMain->GetBalance() < nBalance);
+    BOOST_CHECK(pwalletMain->AbandonTransaction(txAbandoned.GetHash()));
+    CheckBalances();
+    BOOST_CHECK_EQUAL(pwalletMain->GetBalance(), nBalance);
+
+    // A reorg takes confirmations and maturity away, and brings the
+    // conflicted tx back
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params().GetConsensus(), chainActive[chainActive.Height() - 3]));
+        BOOST_CHECK(ActivateBestChain(state, Params()));
+    }
+    CheckBalances();
+    for (int i = 0; i < 5; i++)
+        Mine(std::vector<CMutableTransaction>());
+    CheckBalances();
+
+    // Nothing changes when the wallet caches are dropped
+    pwalletMain->MarkDirty();
+    CheckBalances();
+}
+
+BOOST_AUTO_TEST_CASE(wallet_cache_available_coins)
+{
+    std::vector<COutPoint> vSelected;
+    CheckAvailableCoins(vSelected);
+
+    // One output of every kind the filters tell apart, zero value included
+    CAmount nValue = GetValue(Coinbase(0)) + GetValue(Coinbase(1)) + GetValue(Coinbase(6));
+    BOOST_REQUIRE(nValue > 1010 * COIN);
+    std::vector<CAmount> vAmounts;
+    vAmounts.push_back(1000 * COIN);
+    vAmounts.push_back(vecPrivateSendDenominations[1]);
+    vAmounts.push_back(vecPrivateSendDenominations[2]);
+    vAmounts.push_back(PRIVATESEND_COLLATERAL * 2);
+    vAmounts.push_back(PRIVATESEND_COLLATERAL * 4);
+    vAmounts.push_back(0);
+    vAmounts.push_back(nValue - 1000 * COIN - vecPrivateSendDenominations[1] - vecPrivateSendDenominations[2] - PRIVATESEND_COLLATERAL * 6);
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(Coinbase(0));
+    vPrevouts.push_back(Coinbase(1));
+    vPrevouts.push_back(Coinbase(6));
+    CMutableTransaction txKinds = CreateSpend(vPrevouts, vAmounts);
+    Mine(txKinds);
+    Mine(CreateSpend(Coinbase(2), std::vector<CAmount>(1, GetValue(Coinbase(2))), scriptWatch));
+    CheckAvailableCoins(vSelected);
+
+    // Deep enough for InstantSend, next to a fresh tx that is not
+    for (int i = 0; i < INSTANTSEND_CONFIRMATIONS_REQUIRED; i++)
+        Mine(std::vector<CMutableTransaction>());
+    vAmounts.clear();
+    vAmounts.push_back(vecPrivateSendDenominations[1]);
+    vAmounts.push_back(GetValue(Coinbase(3)) - vecPrivateSendDenominations[1]);
+    CMutableTransaction txFresh = CreateSpend(Coinbase(3), vAmounts);
+    Mine(txFresh);
+    CheckAvailableCoins(vSelected);
+
+    // Trusted and untrusted mempool txs, and one not in the mempool
+    BOOST_CHECK(ToMemPool(CreateSpend(COutPoint(txKinds.GetHash(), 1), std::vector<CAmount>(1, vecPrivateSendDenominations[1]))));
+    CMutableTransaction txOther = CreateSpend(Coinbase(4), std::vector<CAmount>(1, GetValue(Coinbase(4))), scriptOther);
+    Mine(txOther);
+    BOOST_CHECK(ToMemPool(CreateSpend(COutPoint(txOther.GetHash(), 0), std::vector<CAmount>(1, GetValue(Coinbase(4))))));
+    pwalletMain->SyncTransaction(CreateSpend(Coinbase(5), std::vector<CAmount>(1, GetValue(Coinbase(5)))), NULL);
+    CheckAvailableCoins(vSelected);
+
+    // Locked coins, which ONLY_1000 still returns
+    {
+        LOCK(pwalletMain->cs_wallet);
+        COutPoint outpoint(txKinds.GetHash(), 0);
+        pwalletMain->LockCoin(outpoint);
+        outpoint = COutPoint(txKinds.GetHash(), 2);
+        pwalletMain->LockCoin(outpoint);
+    }
+    CheckAvailableCoins(vSelected);
+
+    // Coin control, selecting spendable, locked and watch-only coins
+    vSelected.push_back(COutPoint(txKinds.GetHash(), 2));
+    vSelected.push_back(COutPoint(txKinds.GetHash(), 3));
+    vSelected.push_back(COutPoint(txFresh.GetHash(), 0));
+    vSelected.push_back(COutPoint(mapCreated.rbegin()->first, 0));
+    CheckAvailableCoins(vSelected);
+
+    // Spent in a block, and the spend conflicted away again by a reorg
+    Mine(CreateSpend(COutPoint(txKinds.GetHash(), 3), std::vector<CAmount>(1, PRIVATESEND_COLLATERAL * 2)));
+    CheckAvailableCoins(vSelected);
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params().GetConsensus(), chainActive.Tip()));
+        BOOST_CHECK(ActivateBestChain(state, Params()));
+    }
+    CheckAvailableCoins(vSelected);
+    Mine(std::vector<CMutableTransaction>());
+    CheckAvailableCoins(vSelected);
+
+    // Nothing changes when the wallet caches are dropped
+    pwalletMain->MarkDirty();
+    CheckAvailableCoins(vSelected);
+}
+
+BOOST_AUTO_TEST_CASE(wallet_cache_denominated_coins)
+{
+    CAmount nDenom = vecPrivateSendDenominations[1];
+    CAmount nSmallDenom = vecPrivateSendDenominations[2];
+    CheckDenominatedCoins();
+
+    // Denominations only, and denominations next to change
+    std::vector<CAmount> vAmounts;
+    for (int i = 0; i < 4; i++)
+        vAmounts.push_back(vecPrivateSendDenominations[0]);
+    for (int i = 0; i < 4; i++)
+        vAmounts.push_back(nDenom);
+    for (int i = 0; i < 5; i++)
+        vAmounts.push_back(nSmallDenom);
+    CMutableTransaction txSplit = CreateSpend(Coinbase(0), vAmounts);
+    vAmounts.clear();
+    for (int i = 0; i < 3; i++)
+        vAmounts.push_back(nDenom);
+    vAmounts.push_back(vecPrivateSendDenominations[3]);
+    vAmounts.push_back(PRIVATESEND_COLLATERAL * 4);
+    vAmounts.push_back(GetValue(Coinbase(1)) - 3 * nDenom - vecPrivateSendDenominations[3] - PRIVATESEND_COLLATERAL * 4);
+    std::vector<CMutableTransaction> vTxns;
+    vTxns.push_back(txSplit);
+    vTxns.push_back(CreateSpend(Coinbase(1), vAmounts));
+    Mine(vTxns);
+    CheckDenominatedCoins();
+
+    // Mixing in the mempool, then again on top of it once mined
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(COutPoint(txSplit.GetHash(), 4));
+    vPrevouts.push_back(COutPoint(txSplit.GetHash(), 5));
+    CMutableTransaction txMix1 = CreateSpend(vPrevouts, std::vector<CAmount>(2, nDenom));
+    BOOST_CHECK(ToMemPool(txMix1));
+    CheckDenominatedCoins();
+    Mine(txMix1);
+    vPrevouts.clear();
+    vPrevouts.push_back(COutPoint(txMix1.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txMix1.GetHash(), 1));
+    CMutableTransaction txMix2 = CreateSpend(vPrevouts, std::vector<CAmount>(2, nDenom));
+    BOOST_CHECK(ToMemPool(txMix2));
+    CheckDenominatedCoins();
+
+    // Spending denominated coins, mixed or not, to other amounts
+    vPrevouts.clear();
+    vPrevouts.push_back(COutPoint(txSplit.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txMix2.GetHash(), 0));
+    vTxns.clear();
+    vTxns.push_back(txMix2);
+    vTxns.push_back(CreateSpend(vPrevouts, std::vector<CAmount>(1, vecPrivateSendDenominations[0] + nDenom)));
+    Mine(vTxns);
+    CheckDenominatedCoins();
+
+    // Locked coins are left out
+    {
+        LOCK(pwalletMain->cs_wallet);
+        COutPoint outpoint(txSplit.GetHash(), 1);
+        pwalletMain->LockCoin(outpoint);
+    }
+    CheckDenominatedCoins();
+
+    // A confirmed child seen before its parent is refiled under its rounds
+    // once the parent comes in
+    CMutableTransaction txParent = CreateSpend(COutPoint(txSplit.GetHash(), 8), std::vector<CAmount>(1, nSmallDenom));
+    CMutableTransaction txChild = CreateSpend(COutPoint(txParent.GetHash(), 0), std::vector<CAmount>(1, nSmallDenom));
+    vTxns.clear();
+    vTxns.push_back(txParent);
+    vTxns.push_back(txChild);
+    UnregisterValidationInterface(pwalletMain);
+    CBlock block = Mine(vTxns);
+    RegisterValidationInterface(pwalletMain);
+    pwalletMain->SyncTransaction(txChild, &block);
+    CheckDenominatedCoins();
+    BOOST_CHECK_EQUAL(pwalletMain->GetInputPrivateSendRounds(CTxIn(txChild.GetHash(), 0)), 0);
+    pwalletMain->SyncTransaction(txParent, &block);
+    CheckDenominatedCoins();
+    BOOST_CHECK_EQUAL(pwalletMain->GetInputPrivateSendRounds(CTxIn(txChild.GetHash(), 0)), 2);
+
+    // And after a rescan
+    pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true);
+    CheckDenominatedCoins();
+
+    // Nothing changes when the wallet caches are dropped
+    pwalletMain->MarkDirty();
+    CheckDenominatedCoins();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,224 @@
+// Copyright (c) 2012-2015 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/wallet.h"
+
+#include "main.h"
+#include "rpc/server.h"
+#include "script/sign.h"
+#include "script/standard.h"
+
+#include <vector>
+
+#include "test/test_dash.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+extern CWallet* pwalletMain;
+extern UniValue CallRPC(std::string args);
+
+// ScanForWalletTransactions reads blocks ahead and matches their outputs on
+// -par threads. These tests check that it finds what adding every transaction
+// of every block in order finds, and that abortrescan stops it.
+
+/**
+ * A chain whose transactions pay to keyMine in several forms, to a script
+ * watched by the wallets, to a P2SH script of keyMine and to scripts of
+ * keyOther, some of which look like ours to the rescan filter only.
+ */
+struct WalletRescanTestingSetup : public TestChain100Setup {
+    CKey keyMine;
+    CKey keyWatch;
+    CKey keyOther;
+    CScript scriptCoinbase;
+    CScript scriptMine;
+    CScript scriptWatch;
+    CScript scriptRedeem;
+    CScript scriptOther;
+    CBasicKeyStore keystore;
+    int nScriptCheckThreadsOld;
+    int nCoinbase;
+
+    WalletRescanTestingSetup() : nScriptCheckThreadsOld(nScriptCheckThreads), nCoinbase(0)
+    {
+        keyMine.MakeNewKey(true);
+        keyWatch.MakeNewKey(true);
+        keyOther.MakeNewKey(true);
+        scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+        scriptMine = GetScriptForDestination(keyMine.GetPubKey().GetID());
+        scriptWatch = GetScriptForDestination(keyWatch.GetPubKey().GetID());
+        scriptRedeem = CScript() << ToByteVector(keyMine.GetPubKey()) << OP_CHECKSIG;
+        scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+        keystore.AddKey(coinbaseKey);
+        keystore.AddKey(keyMine);
+
+        std::vector<CPubKey> vMultisig;
+        vMultisig.push_back(keyMine.GetPubKey());
+        vMultisig.push_back(keyOther.GetPubKey());
+
+        for (int i = 0; i < 4; i++) {
+            // Spent in the next block, which may be in the same rescan batch:
+            // only found through its input
+            CTransaction txMine = Mine(Pay(Coinbase(), scriptMine));
+            Mine(Pay(COutPoint(txMine.GetHash(), 0), scriptOther));
+
+            Mine(Pay(Coinbase(), scriptRedeem));
+            Mine(Pay(Coinbase(), scriptWatch));
+            Mine(Pay(Coinbase(), GetScriptForDestination(CScriptID(scriptRedeem))));
+            // The filter matches these, IsMine does not
+            Mine(Pay(Coinbase(), GetScriptForMultisig(1, vMultisig)));
+            Mine(Pay(Coinbase(), scriptOther));
+        }
+    }
+
+    ~WalletRescanTestingSetup()
+    {
+        nScriptCheckThreads = nScriptCheckThreadsOld;
+    }
+
+    //! The next mature coinbase, a new block matures another one
+    COutPoint Coinbase()
+    {
+        return COutPoint(coinbaseTxns[nCoinbase++].GetHash(), 0);
+    }
+
+    //! A transaction paying the whole of prevout, which is in the chain, to scriptPubKey
+    CMutableTransaction Pay(const COutPoint& prevout, const CScript& scriptPubKey)
+    {
+        CTransaction txPrev;
+        uint256 hashBlock;
+        BOOST_CHECK(GetTransaction(prevout.hash, txPrev, Params().GetConsensus(), hashBlock, true));
+
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(prevout));
+        tx.vout.push_back(CTxOut(txPrev.vout[prevout.n].nValue, scriptPubKey));
+        BOOST_CHECK(SignSignature(keystore, txPrev, tx, 0));
+        return tx;
+    }
+
+    CTransaction Mine(const CMutableTransaction& tx)
+    {
+        CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx), scriptCoinbase);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        return tx;
+    }
+
+    //! A new wallet with the keys and scripts of the chain, AddToWallet needs a file to return true
+    CWallet* CreateWallet(const std::string& strWalletFile)
+    {
+        CWallet* pwallet = new CWallet(strWalletFile);
+        bool fFirstRun;
+        pwallet->LoadWallet(fFirstRun);
+        AddScripts(*pwallet);
+        return pwallet;
+    }
+
+    void AddScripts(CWallet& wallet)
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(keyMine, keyMine.GetPubKey());
+        wallet.AddCScript(scriptRedeem);
+        wallet.AddWatchOnly(scriptWatch);
+        // scan from the genesis block
+        wallet.nTimeFirstKey = 0;
+    }
+};
+
+/** What the rescan used to do: every transaction of every block through AddToWalletIfInvolvingMe */
+static int RescanOneByOne(CWallet& wallet)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+
+    int ret = 0;
+    for (CBlockIndex* pindex = chainActive.Genesis(); pindex; pindex = chainActive.Next(pindex)) {
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+        BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+            if (wallet.AddToWalletIfInvolvingMe(tx, &block, true))
+                ret++;
+        }
+    }
+    return ret;
+}
+
+static void CheckSameTransactions(CWallet& wallet, CWallet& walletExpected)
+{
+    LOCK2(wallet.cs_wallet, walletExpected.cs_wallet);
+
+    BOOST_CHECK_EQUAL(wallet.mapWallet.size(), walletExpected.mapWallet.size());
+    for (std::map<uint256, CWalletTx>::const_iterator it = walletExpected.mapWallet.begin(); it != walletExpected.mapWallet.end(); ++it) {
+        std::map<uint256, CWalletTx>::const_iterator mi = wallet.mapWallet.find(it->first);
+        BOOST_CHECK(mi != wallet.mapWallet.end());
+        if (mi == wallet.mapWallet.end())
+            continue;
+        BOOST_CHECK(mi->second.hashBlock == it->second.hashBlock);
+        BOOST_CHECK_EQUAL(mi->second.nIndex, it->second.nIndex);
+        BOOST_CHECK_EQUAL(mi->second.nOrderPos, it->second.nOrderPos);
+    }
+}
+
+BOOST_FIXTURE_TEST_SUITE(wallet_rescan_tests, WalletRescanTestingSetup)
+
+BOOST_AUTO_TEST_CASE(wallet_rescan_parallel)
+{
+    boost::scoped_ptr<CWallet> pwalletExpected(CreateWallet("wallet_expected.dat"));
+    int nExpected = RescanOneByOne(*pwalletExpected);
+    // Per round: the payment to keyMine and its spend, the P2PK and P2SH
+    // payments and the watched one
+    BOOST_CHECK_EQUAL(nExpected, 4 * 5);
+
+    // Without threads, with several batches, and with a batch longer than
+    // the chain
+    int vThreads[] = {0, 2, 3, 16};
+    BOOST_FOREACH(int nThreads, vThreads) {
+        nScriptCheckThreads = nThreads;
+        boost::scoped_ptr<CWallet> pwallet(CreateWallet(strprintf("wallet_rescan_%d.dat", nThreads)));
+        BOOST_CHECK_EQUAL(pwallet->ScanForWalletTransactions(chainActive.Genesis(), true), nExpected);
+        CheckSameTransactions(*pwallet, *pwalletExpected);
+
+        // A second scan finds the same transactions again
+        BOOST_CHECK_EQUAL(pwallet->ScanForWalletTransactions(chainActive.Genesis(), true), nExpected);
+        CheckSameTransactions(*pwallet, *pwalletExpected);
+    }
+}
+
+static void AbortRescanOnStart(UniValue* presult, const std::string& strTitle, int nProgress)
+{
+    if (nProgress == 0)
+        *presult = CallRPC("abortrescan");
+}
+
+BOOST_AUTO_TEST_CASE(wallet_rescan_abort)
+{
+    nScriptCheckThreads = 2;
+    AddScripts(*pwalletMain);
+
+    // Nothing to abort
+    BOOST_CHECK(!pwalletMain->AbortRescan());
+    BOOST_CHECK_EQUAL(CallRPC("abortrescan").get_bool(), false);
+
+    // Aborted before the first batch
+    UniValue result;
+    boost::signals2::connection conn = pwalletMain->ShowProgress.connect(boost::bind(&AbortRescanOnStart, &result, _1, _2));
+    BOOST_CHECK_EQUAL(pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true), 0);
+    conn.disconnect();
+    BOOST_CHECK_EQUAL(result.get_bool(), true);
+    BOOST_CHECK(!pwalletMain->IsScanning());
+    {
+        LOCK(pwalletMain->cs_wallet);
+        BOOST_CHECK(pwalletMain->mapWallet.empty());
+    }
+
+    // The abort does not stick to the next scan
+    boost::scoped_ptr<CWallet> pwalletExpected(CreateWallet("wallet_expected.dat"));
+    BOOST_CHECK_EQUAL(pwalletMain->ScanForWalletTransactions(chainActive.Genesis(), true), RescanOneByOne(*pwalletExpected));
+    CheckSameTransactions(*pwalletMain, *pwalletExpected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
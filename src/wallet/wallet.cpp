@@ -8,10 +8,12 @@
 
 #include "base58.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "chain.h"
 #include "coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "init.h"
 #include "key.h"
 #include "keystore.h"
 #include "main.h"
@@ -379,6 +381,12 @@ void CWallet::SetBestChain(const CBlockLocator& loc)
 {
     CWalletDB walletdb(strWalletFile);
     walletdb.WriteBestBlock(loc);
+
+    LOCK(cs_wallet);
+    if (fOutpointRoundsDirty) {
+        walletdb.WritePrivateSendRounds(mapOutpointRounds, mapWallet.size());
+        fOutpointRoundsDirty = false;
+    }
 }
 
 bool CWallet::SetMinVersion(enum WalletFeature nVersion, CWalletDB* pwalletdbIn, bool fExplicit)
@@ -697,6 +705,9 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
+        fBalancesValid = false;
+        // e.g. after a key import
+        fSpendableCoinsValid = false;
     }
 
     fAnonymizableTallyCached = false;
@@ -782,6 +793,14 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+
+            // Transactions are not always added parent first, e.g. on
+            // rescans, so descendants may have cached rounds without it
+            InvalidatePrivateSendRounds(hash);
+            for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+                if (IsMine(wtx.vout[i]) && IsDenominatedAmount(wtx.vout[i].nValue))
+                    GetRealInputPrivateSendRounds(CTxIn(hash, i), 0);
+            }
         }
 
         bool fUpdated = false;
@@ -821,6 +840,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        MarkTxCachesDirty(wtx);
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -919,6 +939,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.setAbandoned();
             wtx.MarkDirty();
+            MarkTxCachesDirty(wtx);
             wtx.WriteToDisk(&walletdb);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
@@ -984,6 +1005,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
+            MarkTxCachesDirty(wtx);
             wtx.WriteToDisk(&walletdb);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -1062,7 +1084,7 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    AssertLockHeld(cs_wallet);
 
     if(nRounds >= 16) return 15; // 16 rounds max
 
@@ -1072,17 +1094,12 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        std::map<COutPoint, int>::const_iterator mi = mapOutpointRounds.find(txin.prevout);
+        if (mi != mapOutpointRounds.end()) {
+            // found, just return it
+            return mi->second;
         }
 
-
         // bounds check
         if (nout >= wtx->vout.size()) {
             // should never actually hit this
@@ -1090,52 +1107,86 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
             return -4;
         }
 
+        int nRoundsRet;
         if (IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+            nRoundsRet = -3;
+        } else if (!IsDenominatedAmount(wtx->vout[nout].nValue)) {
+            //make sure the final output is non-denominate
+            nRoundsRet = -2;
+        } else {
+            bool fAllDenoms = true;
+            BOOST_FOREACH(CTxOut out, wtx->vout) {
+                fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
+            }
 
-        //make sure the final output is non-denominate
-        if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            if (!fAllDenoms) {
+                // this one is denominated but there is another non-denominated output found in the same tx
+                nRoundsRet = 0;
+            } else {
+                int nShortest = -10; // an initial value, should be no way to get this by calculations
+                bool fDenomFound = false;
+                // only denoms here so let's look up
+                BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
+                    if (IsMine(txinNext)) {
+                        int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
+                        // denom found, find the shortest chain or initially assign nShortest with the first found value
+                        if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                            nShortest = n;
+                            fDenomFound = true;
+                        }
+                    }
+                }
+                nRoundsRet = fDenomFound
+                        ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                        : 0;            // too bad, we are the fist one in that chain
+            }
         }
 
-        bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout) {
-            fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
-        }
+        mapOutpointRounds[txin.prevout] = nRoundsRet;
+        fOutpointRoundsDirty = true;
+        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+        return nRoundsRet;
+    }
 
-        // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+    return nRounds - 1;
+}
 
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
-                }
+void CWallet::InvalidatePrivateSendRounds(const uint256& hashTx)
+{
+    AssertLockHeld(cs_wallet);
+
+    std::vector<uint256> vTodo(1, hashTx);
+    std::set<uint256> setDone;
+    while (!vTodo.empty()) {
+        uint256 hash = vTodo.back();
+        vTodo.pop_back();
+        if (!setDone.insert(hash).second)
+            continue;
+        std::map<uint256, CWalletTx>::iterator mi = mapWallet.find(hash);
+        if (mi == mapWallet.end())
+            continue;
+        // refile its denominated coins under the new rounds
+        setTxCoinsDirty.insert(hash);
+        for (unsigned int i = 0; i < mi->second.vout.size(); i++) {
+            COutPoint outpoint(hash, i);
+            if (mapOutpointRounds.erase(outpoint)) {
+                fOutpointRoundsDirty = true;
+                // anonymized credit depends on the rounds
+                mi->second.MarkDirty();
+                setTxBalancesDirty.insert(hash);
             }
+            std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(outpoint);
+            for (TxSpends::const_iterator it = range.first; it != range.second; ++it)
+                vTodo.push_back(it->second);
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
     }
+}
 
-    return nRounds - 1;
+void CWallet::LoadPrivateSendRounds(const std::map<COutPoint, int>& mapRounds, uint64_t nTxCount)
+{
+    LOCK(cs_wallet);
+    mapOutpointRounds = mapRounds;
+    nOutpointRoundsTxCount = nTxCount;
 }
 
 // respect current settings
@@ -1401,10 +1452,119 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+/** Scripts of a wallet, to match outputs against without taking its locks */
+class CRescanFilter
+{
+public:
+    std::set<CKeyID> setKeys;
+    std::set<CScriptID> setScripts;
+    WatchOnlySet setWatchOnly;
+
+    //! True for every script IsMine accepts, and a few more (partly owned multisig)
+    bool MaybeMine(const CScript& scriptPubKey) const
+    {
+        if (setWatchOnly.count(scriptPubKey))
+            return true;
+
+        std::vector<std::vector<unsigned char> > vSolutions;
+        txnouttype whichType;
+        if (!Solver(scriptPubKey, whichType, vSolutions))
+            return false;
+
+        switch (whichType)
+        {
+        case TX_PUBKEY:
+            return setKeys.count(CPubKey(vSolutions[0]).GetID()) > 0;
+        case TX_PUBKEYHASH:
+            return setKeys.count(CKeyID(uint160(vSolutions[0]))) > 0;
+        case TX_SCRIPTHASH:
+            return setScripts.count(CScriptID(uint160(vSolutions[0]))) > 0;
+        case TX_MULTISIG:
+            for (unsigned int i = 1; i + 1 < vSolutions.size(); i++)
+                if (setKeys.count(CPubKey(vSolutions[i]).GetID()))
+                    return true;
+            return false;
+        default:
+            return false;
+        }
+    }
+};
+
+/** A block read ahead by a rescan */
+struct CRescanBlock
+{
+    CBlock block;
+    //! Per transaction, whether one of its outputs may be ours
+    std::vector<bool> vMaybeMine;
+    bool fRead;
+
+    CRescanBlock() : fRead(false) {}
+};
+
+/** Reads a block for a rescan and matches its outputs, on a worker thread */
+class CRescanBlockCheck
+{
+private:
+    const CBlockIndex* pindex;
+    const CRescanFilter* pfilter;
+    CRescanBlock* presult;
+
+public:
+    CRescanBlockCheck() : pindex(NULL), pfilter(NULL), presult(NULL) {}
+    CRescanBlockCheck(const CBlockIndex* pindexIn, const CRescanFilter* pfilterIn, CRescanBlock* presultIn) :
+        pindex(pindexIn), pfilter(pfilterIn), presult(presultIn) {}
+
+    bool operator()()
+    {
+        if (!ReadBlockFromDisk(presult->block, pindex, Params().GetConsensus()))
+            return true; // read again by the caller
+        presult->vMaybeMine.resize(presult->block.vtx.size());
+        for (unsigned int i = 0; i < presult->block.vtx.size(); i++) {
+            bool fMaybeMine = false;
+            BOOST_FOREACH(const CTxOut& txout, presult->block.vtx[i].vout) {
+                if (pfilter->MaybeMine(txout.scriptPubKey)) {
+                    fMaybeMine = true;
+                    break;
+                }
+            }
+            presult->vMaybeMine[i] = fMaybeMine;
+        }
+        presult->fRead = true;
+        return true;
+    }
+
+    void swap(CRescanBlockCheck& check)
+    {
+        std::swap(pindex, check.pindex);
+        std::swap(pfilter, check.pfilter);
+        std::swap(presult, check.presult);
+    }
+};
+
+/** Blocks each rescan thread reads ahead per batch */
+static const int RESCAN_BLOCKS_PER_THREAD = 4;
+
+/** Worker threads of a rescan, stopped however the scan exits */
+struct CRescanThreads
+{
+    boost::thread_group threadGroup;
+
+    ~CRescanThreads()
+    {
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+};
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and their outputs matched against the wallet's scripts
+ * on -par threads, a batch at a time. Only the transactions that may be
+ * ours go through AddToWalletIfInvolvingMe. AbortRescan and shutdown stop
+ * the scan between batches.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
@@ -1416,6 +1576,32 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     {
         LOCK2(cs_main, cs_wallet);
 
+        // Rescans follow key imports, which change which inputs are ours
+        mapOutpointRounds.clear();
+        fOutpointRoundsDirty = true;
+        fBalancesValid = false;
+        // denominated coins are filed by their rounds
+        fSpendableCoinsValid = false;
+
+        CRescanFilter filter;
+        {
+            LOCK(cs_KeyStore);
+            GetKeys(filter.setKeys);
+            for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it)
+                filter.setScripts.insert(it->first);
+            filter.setWatchOnly = setWatchOnly;
+        }
+
+        // The read ahead threads only live as long as the scan
+        CCheckQueue<CRescanBlockCheck> queue(1);
+        CRescanThreads threads;
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            threads.threadGroup.create_thread(boost::bind(&CCheckQueue<CRescanBlockCheck>::Thread, &queue));
+        unsigned int nBatchSize = std::max(1, nScriptCheckThreads) * RESCAN_BLOCKS_PER_THREAD;
+
+        fAbortRescan = false;
+        fScanningWallet = true;
+
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
@@ -1426,23 +1612,60 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
         while (pindex)
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+            if (fAbortRescan || ShutdownRequested()) {
+                LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                break;
+            }
+
+            if (dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            std::vector<CBlockIndex*> vBatch;
+            for (CBlockIndex* pindexNext = pindex; pindexNext && vBatch.size() < nBatchSize; pindexNext = chainActive.Next(pindexNext))
+                vBatch.push_back(pindexNext);
+
+            std::vector<CRescanBlock> vBlocks(vBatch.size());
+            std::vector<CRescanBlockCheck> vChecks;
+            for (unsigned int i = 0; i < vBatch.size(); i++)
+                vChecks.push_back(CRescanBlockCheck(vBatch[i], &filter, &vBlocks[i]));
+            if (nScriptCheckThreads) {
+                CCheckQueueControl<CRescanBlockCheck> control(&queue);
+                control.Add(vChecks);
+                control.Wait();
+            } else {
+                BOOST_FOREACH(CRescanBlockCheck& check, vChecks)
+                    check();
+            }
+
+            for (unsigned int i = 0; i < vBatch.size(); i++)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+                CRescanBlock& rescanBlock = vBlocks[i];
+                if (!rescanBlock.fRead) {
+                    ReadBlockFromDisk(rescanBlock.block, vBatch[i], chainParams.GetConsensus());
+                    rescanBlock.vMaybeMine.assign(rescanBlock.block.vtx.size(), true);
+                }
+                for (unsigned int j = 0; j < rescanBlock.block.vtx.size(); j++)
+                {
+                    const CTransaction& tx = rescanBlock.block.vtx[j];
+                    // Outputs were matched above. Inputs are checked here,
+                    // as earlier blocks of the batch may have added their parents.
+                    bool fCandidate = rescanBlock.vMaybeMine[j] || mapWallet.count(tx.GetHash());
+                    for (unsigned int k = 0; !fCandidate && k < tx.vin.size(); k++)
+                        fCandidate = mapWallet.count(tx.vin[k].prevout.hash) || mapTxSpends.count(tx.vin[k].prevout);
+                    if (fCandidate && AddToWalletIfInvolvingMe(tx, &rescanBlock.block, fUpdate))
+                        ret++;
+                }
             }
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
+
+            pindex = chainActive.Next(vBatch.back());
+            if (pindex && GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
             }
         }
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+        fScanningWallet = false;
     }
     return ret;
 }
@@ -1856,20 +2079,98 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
  */
 
 
-CAmount CWallet::GetBalance() const
+void CWallet::MarkTxCachesDirty(const CWalletTx& wtx)
 {
-    CAmount nTotal = 0;
+    AssertLockHeld(cs_wallet);
+
+    setTxBalancesDirty.insert(wtx.GetHash());
+    setTxCoinsDirty.insert(wtx.GetHash());
+    // spending an output changes the available credit of its tx
+    BOOST_FOREACH(const CTxIn& txin, wtx.vin)
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+        if (mapWallet.count(txin.prevout.hash)) {
+            setTxBalancesDirty.insert(txin.prevout.hash);
+            setTxCoinsDirty.insert(txin.prevout.hash);
         }
     }
+}
 
-    return nTotal;
+void CWallet::UpdateTxBalances(const uint256& hashTx) const
+{
+    std::map<uint256, CWalletBalances>::iterator mi = mapTxBalances.find(hashTx);
+    if (mi != mapTxBalances.end()) {
+        balancesTotal -= mi->second;
+        mapTxBalances.erase(mi);
+    }
+    setTxBalancesVolatile.erase(hashTx);
+
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hashTx);
+    if (it == mapWallet.end())
+        return;
+    const CWalletTx& wtx = it->second;
+
+    CWalletBalances balances;
+    if (wtx.IsTrusted()) {
+        balances.nTrusted = wtx.GetAvailableCredit();
+        balances.nWatchTrusted = wtx.GetAvailableWatchOnlyCredit();
+        if (!fLiteMode)
+            balances.nAnonymized = wtx.GetAnonymizedCredit();
+    } else if (wtx.GetDepthInMainChain() == 0 && wtx.InMempool()) {
+        balances.nUnconfirmed = wtx.GetAvailableCredit();
+        balances.nWatchUnconfirmed = wtx.GetAvailableWatchOnlyCredit();
+    }
+    balances.nImmature = wtx.GetImmatureCredit();
+    balances.nWatchImmature = wtx.GetImmatureWatchOnlyCredit();
+    if (!fLiteMode) {
+        balances.nDenomConfirmed = wtx.GetDenominatedCredit(false);
+        balances.nDenomUnconfirmed = wtx.GetDenominatedCredit(true);
+    }
+
+    if (!balances.IsNull()) {
+        mapTxBalances[hashTx] = balances;
+        balancesTotal += balances;
+    }
+    if (wtx.GetDepthInMainChain(false) < 1 || wtx.GetBlocksToMaturity() > 0)
+        setTxBalancesVolatile.insert(hashTx);
+}
+
+const CWalletBalances& CWallet::GetBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+
+    // A reorg can take confirmations or maturity from any tx, start over
+    if (fBalancesValid && pindexBalances != NULL &&
+        (pindexTip == NULL || pindexTip->GetAncestor(pindexBalances->nHeight) != pindexBalances))
+        fBalancesValid = false;
+
+    if (!fBalancesValid) {
+        balancesTotal.SetNull();
+        mapTxBalances.clear();
+        setTxBalancesVolatile.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateTxBalances(it->first);
+        fBalancesValid = true;
+    } else {
+        if (pindexTip != pindexBalances || nMempoolUpdated != nBalancesMempoolUpdated)
+            setTxBalancesDirty.insert(setTxBalancesVolatile.begin(), setTxBalancesVolatile.end());
+        BOOST_FOREACH(const uint256& hash, setTxBalancesDirty)
+            UpdateTxBalances(hash);
+    }
+    setTxBalancesDirty.clear();
+    pindexBalances = pindexTip;
+    nBalancesMempoolUpdated = nMempoolUpdated;
+
+    return balancesTotal;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfirmed) const
@@ -1896,19 +2197,8 @@ CAmount CWallet::GetAnonymizedBalance() const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nAnonymized;
 }
 
 // Note: calculated including unconfirmed,
@@ -2006,125 +2296,219 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if(fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    const CWalletBalances& balances = GetBalances();
+    return unconfirmed ? balances.nDenomUnconfirmed : balances.nDenomConfirmed;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchTrusted;
+}
+
+CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchUnconfirmed;
+}
+
+CAmount CWallet::GetImmatureWatchOnlyBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nWatchImmature;
+}
+
+SpendableCoinKind CWallet::GetSpendableCoinKind(CAmount nValue) const
+{
+    // denominations carry a remainder, so these never overlap
+    if (IsDenominatedAmount(nValue))
+        return COIN_KIND_DENOMINATED;
+    if (IsCollateralAmount(nValue))
+        return COIN_KIND_COLLATERAL;
+    if (nValue == 1000*COIN)
+        return COIN_KIND_1000;
+    return COIN_KIND_OTHER;
+}
+
+void CWallet::UpdateTxSpendableCoins(const uint256& hashTx) const
+{
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hashTx);
+    if (it == mapWallet.end())
+        return;
+    const CWalletTx& wtx = it->second;
+
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        COutPoint outpoint(hashTx, i);
+        SpendableCoinKind nKind = GetSpendableCoinKind(wtx.vout[i].nValue);
+        bool fSpendable = !IsSpent(hashTx, i) && IsMine(wtx.vout[i]) != ISMINE_NO;
+        if (fSpendable)
+            setSpendableCoins[nKind].insert(outpoint);
+        else
+            setSpendableCoins[nKind].erase(outpoint);
+        if (nKind == COIN_KIND_DENOMINATED)
+            UpdateDenominatedCoin(outpoint, wtx.vout[i].nValue, fSpendable);
     }
+}
 
-    return nTotal;
+void CWallet::UpdateDenominatedCoin(const COutPoint& outpoint, CAmount nValue, bool fSpendable) const
+{
+    std::map<COutPoint, std::pair<CAmount, int> >::iterator it = mapDenominatedCoinsPos.find(outpoint);
+    if (it != mapDenominatedCoinsPos.end()) {
+        std::map<int, std::set<COutPoint> >& mapRounds = mapDenominatedCoins[it->second.first];
+        mapRounds[it->second.second].erase(outpoint);
+        if (mapRounds[it->second.second].empty())
+            mapRounds.erase(it->second.second);
+        mapDenominatedCoinsPos.erase(it);
+    }
+
+    if (!fSpendable)
+        return;
+
+    int nRounds = GetRealInputPrivateSendRounds(CTxIn(outpoint), 0);
+    mapDenominatedCoins[nValue][nRounds].insert(outpoint);
+    mapDenominatedCoinsPos[outpoint] = std::make_pair(nValue, nRounds);
 }
 
-CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
+void CWallet::GetDenominatedCoins(CAmount nValue, int nRoundsMin, int nRoundsMax, std::vector<COutPoint>& vOutpointsRet) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
+    AssertLockHeld(cs_wallet);
+
+    std::map<CAmount, std::map<int, std::set<COutPoint> > >::const_iterator it = mapDenominatedCoins.find(nValue);
+    if (it == mapDenominatedCoins.end())
+        return;
+
+    for (std::map<int, std::set<COutPoint> >::const_iterator itRounds = it->second.begin(); itRounds != it->second.end(); ++itRounds) {
+        // respect current settings, like GetInputPrivateSendRounds
+        int nRounds = std::min(itRounds->first, nPrivateSendRounds);
+        if (nRounds < nRoundsMin || nRounds >= nRoundsMax)
+            continue;
+        vOutpointsRet.insert(vOutpointsRet.end(), itRounds->second.begin(), itRounds->second.end());
     }
-    return nTotal;
 }
 
-CAmount CWallet::GetImmatureWatchOnlyBalance() const
+bool CWallet::IsMixableCoin(const COutPoint& outpoint, const CWalletTx*& pcoinRet, int& nDepthRet) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end())
+        return false;
+    const CWalletTx* pcoin = &it->second;
+
+    // same checks as AvailableCoins with fOnlyConfirmed
+    if (!CheckFinalTx(*pcoin) || !pcoin->IsTrusted())
+        return false;
+    if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+        return false;
+    int nDepth = pcoin->GetDepthInMainChain(false);
+    if (nDepth == 0 && !pcoin->InMempool())
+        return false;
+    if (IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n))
+        return false;
+    if (IsMine(pcoin->vout[outpoint.n]) != ISMINE_SPENDABLE)
+        return false;
+
+    pcoinRet = pcoin;
+    nDepthRet = nDepth;
+    return true;
+}
+
+void CWallet::UpdateSpendableCoins() const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (!fSpendableCoinsValid) {
+        for (int nKind = 0; nKind < COIN_KIND_COUNT; nKind++)
+            setSpendableCoins[nKind].clear();
+        mapDenominatedCoins.clear();
+        mapDenominatedCoinsPos.clear();
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
+            UpdateTxSpendableCoins(it->first);
+        fSpendableCoinsValid = true;
+    } else {
+        BOOST_FOREACH(const uint256& hash, setTxCoinsDirty)
+            UpdateTxSpendableCoins(hash);
     }
-    return nTotal;
+    setTxCoinsDirty.clear();
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
 {
     vCoins.clear();
 
+    // only look at the kinds of outputs the filter below can accept
+    std::vector<SpendableCoinKind> vKinds;
+    if (nCoinType == ONLY_DENOMINATED) {
+        vKinds.push_back(COIN_KIND_DENOMINATED);
+    } else if (nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
+        vKinds.push_back(COIN_KIND_OTHER);
+        if (!fMasterNode) vKinds.push_back(COIN_KIND_1000);
+    } else if (nCoinType == ONLY_1000) {
+        vKinds.push_back(COIN_KIND_1000);
+    } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+        vKinds.push_back(COIN_KIND_COLLATERAL);
+    } else {
+        for (int nKind = 0; nKind < COIN_KIND_COUNT; nKind++)
+            vKinds.push_back((SpendableCoinKind)nKind);
+    }
+
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        UpdateSpendableCoins();
+
+        BOOST_FOREACH(SpendableCoinKind nKind, vKinds)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            // outputs of a tx are next to each other, check the tx only once
+            const CWalletTx* pcoin = NULL;
+            bool fTxAvailable = false;
+            int nDepth = 0;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+            BOOST_FOREACH(const COutPoint& outpoint, setSpendableCoins[nKind])
+            {
+                const uint256& wtxid = outpoint.hash;
+                unsigned int i = outpoint.n;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (pcoin == NULL || pcoin->GetHash() != wtxid) {
+                    pcoin = &mapWallet.find(wtxid)->second;
+                    fTxAvailable = false;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                    if (!CheckFinalTx(*pcoin))
+                        continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-                continue;
+                    if (fOnlyConfirmed && !pcoin->IsTrusted())
+                        continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                    if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+                        continue;
+
+                    nDepth = pcoin->GetDepthInMainChain(false);
+                    // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+                    if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+                        continue;
+
+                    // We should not consider coins which aren't at least in our mempool
+                    // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                    if (nDepth == 0 && !pcoin->InMempool())
+                        continue;
+
+                    fTxAvailable = true;
+                }
+                if (!fTxAvailable) continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 bool found = false;
                 if(nCoinType == ONLY_DENOMINATED) {
                     found = IsDenominatedAmount(pcoin->vout[i].nValue);
@@ -2145,9 +2529,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
+                    (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_1000) &&
                     (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
+                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
                         vCoins.push_back(COutput(pcoin, i, nDepth,
                                                  ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                                                   (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
@@ -2504,11 +2888,6 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     vCoinsRet.clear();
     nValueRet = 0;
 
-    vector<COutput> vCoins;
-    AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
-
-    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
-
     // ( bit on if present )
     // bit 0 - 100SIB+1
     // bit 1 - 10SIB+1
@@ -2520,28 +2899,38 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
         return false;
     }
 
+    LOCK2(cs_main, cs_wallet);
+    UpdateSpendableCoins();
+
+    // only the coins of the requested denominations and rounds are candidates
+    std::vector<COutPoint> vCandidates;
+    BOOST_FOREACH(int nBit, vecBits)
+        GetDenominatedCoins(vecPrivateSendDenominations[nBit], nPrivateSendRoundsMin, nPrivateSendRoundsMax, vCandidates);
+
     int nDenomResult = 0;
 
     InsecureRand insecureRand;
-    BOOST_FOREACH(const COutput& out, vCoins)
+    for (unsigned int n = 0; n < vCandidates.size(); n++)
     {
-        // masternode-like input should not be selected by AvailableCoins now anyway
-        //if(out.tx->vout[out.i].nValue == 1000*COIN) continue;
+        // shuffle as we go, so that only the coins we look at get shuffled
+        std::swap(vCandidates[n], vCandidates[n + insecureRand(vCandidates.size() - n)]);
+
+        const CWalletTx* pcoin = NULL;
+        int nDepth = 0;
+        if (!IsMixableCoin(vCandidates[n], pcoin, nDepth)) continue;
+        COutput out(pcoin, vCandidates[n].n, nDepth, true);
+
         if(nValueRet + out.tx->vout[out.i].nValue <= nValueMax){
 
             CTxIn txin = CTxIn(out.tx->GetHash(), out.i);
 
-            int nRounds = GetInputPrivateSendRounds(txin);
-            if(nRounds >= nPrivateSendRoundsMax) continue;
-            if(nRounds < nPrivateSendRoundsMin) continue;
-
             BOOST_FOREACH(int nBit, vecBits) {
                 if(out.tx->vout[out.i].nValue == vecPrivateSendDenominations[nBit]) {
                     if(nValueRet >= nValueMin) {
                         //randomly reduce the max amount we'll submit (for anonymity)
                         nValueMax -= insecureRand(nValueMax/5);
                         //on average use 50% of the inputs or less
-                        int r = insecureRand(vCoins.size());
+                        int r = insecureRand(vCandidates.size());
                         if((int)vecTxInRet.size() > r) return true;
                     }
                     txin.prevPubKey = out.tx->vout[out.i].scriptPubKey; // the inputs PubKey
@@ -2586,41 +2975,63 @@ bool CWallet::SelectCoinsGrouppedByAddresses(std::vector<CompactTallyItem>& vecT
         }
     }
 
+    // Only our unspent outputs can be tallied, and anonymizable denominated ones
+    // are those not mixed enough yet
+    UpdateSpendableCoins();
+    std::vector<COutPoint> vOutpoints;
+    for (int nKind = 0; nKind < COIN_KIND_COUNT; nKind++) {
+        if (nKind == COIN_KIND_DENOMINATED) {
+            if (fSkipDenominated) continue;
+            if (fAnonymizable) {
+                std::map<CAmount, std::map<int, std::set<COutPoint> > >::const_iterator it;
+                for (it = mapDenominatedCoins.begin(); it != mapDenominatedCoins.end(); ++it)
+                    GetDenominatedCoins(it->first, std::numeric_limits<int>::min(), nPrivateSendRounds, vOutpoints);
+                continue;
+            }
+        }
+        if (nKind == COIN_KIND_COLLATERAL && fAnonymizable) continue;
+        vOutpoints.insert(vOutpoints.end(), setSpendableCoins[nKind].begin(), setSpendableCoins[nKind].end());
+    }
+    // keep the outputs of a tx next to each other
+    std::sort(vOutpoints.begin(), vOutpoints.end());
+
     // Tally
     map<CBitcoinAddress, CompactTallyItem> mapTally;
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-        const CWalletTx& wtx = (*it).second;
+    const CWalletTx* pwtx = NULL;
+    BOOST_FOREACH(const COutPoint& outpoint, vOutpoints) {
+        if (pwtx == NULL || pwtx->GetHash() != outpoint.hash)
+            pwtx = &mapWallet.find(outpoint.hash)->second;
+        const CWalletTx& wtx = *pwtx;
 
         if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
         if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
 
-        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
-            CTxDestination address;
-            if (!ExtractDestination(wtx.vout[i].scriptPubKey, address)) continue;
-
-            isminefilter mine = ::IsMine(*this, address);
-            if(!(mine & filter)) continue;
+        unsigned int i = outpoint.n;
+        CTxDestination address;
+        if (!ExtractDestination(wtx.vout[i].scriptPubKey, address)) continue;
 
-            if(IsSpent(wtx.GetHash(), i) || IsLockedCoin(wtx.GetHash(), i)) continue;
+        isminefilter mine = ::IsMine(*this, address);
+        if(!(mine & filter)) continue;
 
-            if(fSkipDenominated && IsDenominatedAmount(wtx.vout[i].nValue)) continue;
+        if(IsSpent(wtx.GetHash(), i) || IsLockedCoin(wtx.GetHash(), i)) continue;
 
-            if(fAnonymizable) {
-                // ignore collaterals
-                if(IsCollateralAmount(wtx.vout[i].nValue)) continue;
-                if(fMasterNode && wtx.vout[i].nValue == 1000*COIN) continue;
-                // ignore outputs that are 10 times smaller then the smallest denomination
-                // otherwise they will just lead to higher fee / lower priority
-                if(wtx.vout[i].nValue <= vecPrivateSendDenominations.back()/10) continue;
-                // ignore anonymized
-                if(GetInputPrivateSendRounds(CTxIn(wtx.GetHash(), i)) >= nPrivateSendRounds) continue;
-            }
+        if(fSkipDenominated && IsDenominatedAmount(wtx.vout[i].nValue)) continue;
 
-            CompactTallyItem& item = mapTally[address];
-            item.address = address;
-            item.nAmount += wtx.vout[i].nValue;
-            item.vecTxIn.push_back(CTxIn(wtx.GetHash(), i));
+        if(fAnonymizable) {
+            // ignore collaterals
+            if(IsCollateralAmount(wtx.vout[i].nValue)) continue;
+            if(fMasterNode && wtx.vout[i].nValue == 1000*COIN) continue;
+            // ignore outputs that are 10 times smaller then the smallest denomination
+            // otherwise they will just lead to higher fee / lower priority
+            if(wtx.vout[i].nValue <= vecPrivateSendDenominations.back()/10) continue;
+            // ignore anonymized
+            if(GetInputPrivateSendRounds(CTxIn(wtx.GetHash(), i)) >= nPrivateSendRounds) continue;
         }
+
+        CompactTallyItem& item = mapTally[address];
+        item.address = address;
+        item.nAmount += wtx.vout[i].nValue;
+        item.vecTxIn.push_back(CTxIn(wtx.GetHash(), i));
     }
 
     // construct resulting vector
@@ -2769,26 +3180,22 @@ bool CWallet::GetVinAndKeysFromOutput(COutput out, CTxIn& txinRet, CPubKey& pubK
 
 int CWallet::CountInputsWithAmount(CAmount nInputAmount)
 {
+    if (!IsDenominatedAmount(nInputAmount))
+        return 0;
+
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted()){
-                int nDepth = pcoin->GetDepthInMainChain(false);
-
-                for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                    COutput out = COutput(pcoin, i, nDepth, true);
-                    CTxIn txin = CTxIn(out.tx->GetHash(), out.i);
+        UpdateSpendableCoins();
 
-                    if(out.tx->vout[out.i].nValue != nInputAmount) continue;
-                    if(!IsDenominatedAmount(pcoin->vout[i].nValue)) continue;
-                    if(IsSpent(out.tx->GetHash(), i) || IsMine(pcoin->vout[i]) != ISMINE_SPENDABLE || !IsDenominated(txin)) continue;
+        std::vector<COutPoint> vOutpoints;
+        GetDenominatedCoins(nInputAmount, std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), vOutpoints);
+        BOOST_FOREACH(const COutPoint& outpoint, vOutpoints) {
+            const CWalletTx* pcoin = &mapWallet.find(outpoint.hash)->second;
+            if (!pcoin->IsTrusted()) continue;
+            if (IsSpent(outpoint.hash, outpoint.n) || IsMine(pcoin->vout[outpoint.n]) != ISMINE_SPENDABLE) continue;
 
-                    nTotal++;
-                }
-            }
+            nTotal++;
         }
     }
 
@@ -3364,6 +3771,15 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         return nLoadWalletRet;
     fFirstRunRet = !vchDefaultKey.IsValid();
 
+    {
+        LOCK(cs_wallet);
+        // Transactions may have been added by a version without the cache
+        if (nOutpointRoundsTxCount != mapWallet.size()) {
+            mapOutpointRounds.clear();
+            fOutpointRoundsDirty = true;
+        }
+    }
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
@@ -3801,6 +4217,8 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()){
+            // e.g. an InstantSend lock, which makes it trusted
+            setTxBalancesDirty.insert(hashTx);
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
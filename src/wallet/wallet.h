@@ -20,6 +20,7 @@
 #include "wallet/walletdb.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -100,6 +101,16 @@ enum AvailableCoinsType
     ONLY_PRIVATESEND_COLLATERAL = 6
 };
 
+/** Kinds of outputs the spendable coin index of CWallet is split by */
+enum SpendableCoinKind
+{
+    COIN_KIND_DENOMINATED,
+    COIN_KIND_COLLATERAL,
+    COIN_KIND_1000,
+    COIN_KIND_OTHER,
+    COIN_KIND_COUNT
+};
+
 struct CompactTallyItem
 {
     CBitcoinAddress address;
@@ -111,6 +122,67 @@ struct CompactTallyItem
     }
 };
 
+/** Wallet balances, or the part of them a single wallet transaction makes up */
+struct CWalletBalances
+{
+    CAmount nTrusted;
+    CAmount nUnconfirmed;
+    CAmount nImmature;
+    CAmount nWatchTrusted;
+    CAmount nWatchUnconfirmed;
+    CAmount nWatchImmature;
+    CAmount nAnonymized;
+    CAmount nDenomConfirmed;
+    CAmount nDenomUnconfirmed;
+
+    CWalletBalances()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nTrusted = nUnconfirmed = nImmature = 0;
+        nWatchTrusted = nWatchUnconfirmed = nWatchImmature = 0;
+        nAnonymized = nDenomConfirmed = nDenomUnconfirmed = 0;
+    }
+
+    bool IsNull() const
+    {
+        return nTrusted == 0 && nUnconfirmed == 0 && nImmature == 0 &&
+               nWatchTrusted == 0 && nWatchUnconfirmed == 0 && nWatchImmature == 0 &&
+               nAnonymized == 0 && nDenomConfirmed == 0 && nDenomUnconfirmed == 0;
+    }
+
+    CWalletBalances& operator+=(const CWalletBalances& b)
+    {
+        nTrusted += b.nTrusted;
+        nUnconfirmed += b.nUnconfirmed;
+        nImmature += b.nImmature;
+        nWatchTrusted += b.nWatchTrusted;
+        nWatchUnconfirmed += b.nWatchUnconfirmed;
+        nWatchImmature += b.nWatchImmature;
+        nAnonymized += b.nAnonymized;
+        nDenomConfirmed += b.nDenomConfirmed;
+        nDenomUnconfirmed += b.nDenomUnconfirmed;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUnconfirmed -= b.nUnconfirmed;
+        nImmature -= b.nImmature;
+        nWatchTrusted -= b.nWatchTrusted;
+        nWatchUnconfirmed -= b.nWatchUnconfirmed;
+        nWatchImmature -= b.nWatchImmature;
+        nAnonymized -= b.nAnonymized;
+        nDenomConfirmed -= b.nDenomConfirmed;
+        nDenomUnconfirmed -= b.nDenomUnconfirmed;
+        return *this;
+    }
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -613,11 +685,79 @@ private:
     int64_t nLastResend;
     bool fBroadcastTransactions;
 
+    //! Set by AbortRescan, polled by ScanForWalletTransactions
+    std::atomic<bool> fAbortRescan;
+    std::atomic<bool> fScanningWallet;
+
     mutable bool fAnonymizableTallyCached;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /**
+     * PrivateSend rounds of wallet outpoints, as found by
+     * GetRealInputPrivateSendRounds. They only depend on the wallet
+     * transactions an outpoint descends from, so entries are dropped when
+     * an ancestor is added, and kept across reorgs.
+     */
+    mutable std::map<COutPoint, int> mapOutpointRounds;
+    //! Whether mapOutpointRounds changed since it was written to the wallet file
+    mutable bool fOutpointRoundsDirty;
+    //! Number of wallet transactions mapOutpointRounds was written with
+    uint64_t nOutpointRoundsTxCount;
+
+    /* Drop the cached PrivateSend rounds of a transaction and its in-wallet descendants */
+    void InvalidatePrivateSendRounds(const uint256& hashTx);
+
+    /**
+     * Running totals behind GetBalance and friends. Only transactions whose
+     * part changed are looked at again: the dirty ones, and on a new tip or
+     * mempool change the volatile ones (unconfirmed txes and immature
+     * coinbases). Reorgs and CWallet::MarkDirty rebuild the totals.
+     */
+    mutable CWalletBalances balancesTotal;
+    //! Non-null parts of balancesTotal per wallet transaction
+    mutable std::map<uint256, CWalletBalances> mapTxBalances;
+    mutable std::set<uint256> setTxBalancesVolatile;
+    mutable std::set<uint256> setTxBalancesDirty;
+    mutable bool fBalancesValid;
+    //! Chain tip and mempool update counter the volatile parts were computed at
+    mutable const CBlockIndex* pindexBalances;
+    mutable unsigned int nBalancesMempoolUpdated;
+
+    /**
+     * Unspent outputs of ours, split by kind, so that AvailableCoins only
+     * looks at candidates. Entries of the dirty txes are redone on the next
+     * call. Outputs can only get spent behind our back (a conflicted spender
+     * coming back on a reorg), so AvailableCoins still checks IsSpent.
+     */
+    mutable std::set<COutPoint> setSpendableCoins[COIN_KIND_COUNT];
+    mutable std::set<uint256> setTxCoinsDirty;
+    mutable bool fSpendableCoinsValid;
+    /**
+     * The denominated outputs of setSpendableCoins again, by denomination and
+     * real PrivateSend rounds, so that mixing only visits the coins it can use.
+     * Entries are refiled when the rounds of their transaction are invalidated.
+     */
+    mutable std::map<CAmount, std::map<int, std::set<COutPoint> > > mapDenominatedCoins;
+    //! Denomination and rounds every entry of mapDenominatedCoins is filed under
+    mutable std::map<COutPoint, std::pair<CAmount, int> > mapDenominatedCoinsPos;
+
+    /* Recompute the balances and indexed coins of a transaction and the wallet transactions it spends from */
+    void MarkTxCachesDirty(const CWalletTx& wtx);
+    SpendableCoinKind GetSpendableCoinKind(CAmount nValue) const;
+    void UpdateTxSpendableCoins(const uint256& hashTx) const;
+    void UpdateDenominatedCoin(const COutPoint& outpoint, CAmount nValue, bool fSpendable) const;
+    //! Append the indexed denominated coins of nValue whose rounds are in [nRoundsMin, nRoundsMax), requires cs_wallet
+    void GetDenominatedCoins(CAmount nValue, int nRoundsMin, int nRoundsMax, std::vector<COutPoint>& vOutpointsRet) const;
+    //! Whether an indexed coin can be used for mixing right now, requires cs_main and cs_wallet
+    bool IsMixableCoin(const COutPoint& outpoint, const CWalletTx*& pcoinRet, int& nDepthRet) const;
+    //! Bring setSpendableCoins up to date, requires cs_wallet
+    void UpdateSpendableCoins() const;
+    void UpdateTxBalances(const uint256& hashTx) const;
+    //! Bring the running totals up to date, requires cs_main and cs_wallet
+    const CWalletBalances& GetBalances() const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -688,6 +828,14 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        fOutpointRoundsDirty = false;
+        nOutpointRoundsTxCount = 0;
+        fBalancesValid = false;
+        fSpendableCoinsValid = false;
+        fAbortRescan = false;
+        fScanningWallet = false;
+        pindexBalances = NULL;
+        nBalancesMempoolUpdated = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -743,6 +891,8 @@ public:
 
     // get the PrivateSend chain depth for a given input
     int GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const;
+    // load the PrivateSend rounds cache from the wallet file
+    void LoadPrivateSendRounds(const std::map<COutPoint, int>& mapRounds, uint64_t nTxCount);
     // respect current settings
     int GetInputPrivateSendRounds(CTxIn txin) const;
 
@@ -810,6 +960,9 @@ public:
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    //! Stop a running ScanForWalletTransactions at the next batch of blocks, returns false if none is running
+    bool AbortRescan() { if (!fScanningWallet) return false; fAbortRescan = true; return true; }
+    bool IsScanning() const { return fScanningWallet; }
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
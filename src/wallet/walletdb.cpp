@@ -148,6 +148,12 @@ bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
     return Write(std::string("orderposnext"), nOrderPosNext);
 }
 
+bool CWalletDB::WritePrivateSendRounds(const std::map<COutPoint, int>& mapRounds, uint64_t nTxCount)
+{
+    nWalletDBUpdated++;
+    return Write(std::string("psrounds"), std::make_pair(std::make_pair(CLIENT_VERSION, nTxCount), mapRounds));
+}
+
 bool CWalletDB::WriteDefaultKey(const CPubKey& vchPubKey)
 {
     nWalletDBUpdated++;
@@ -587,6 +593,18 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         {
             ssValue >> pwallet->nOrderPosNext;
         }
+        else if (strType == "psrounds")
+        {
+            // Only trust rounds computed by this version, the rules may differ
+            int nVersion;
+            uint64_t nTxCount;
+            ssValue >> nVersion >> nTxCount;
+            if (nVersion == CLIENT_VERSION) {
+                std::map<COutPoint, int> mapRounds;
+                ssValue >> mapRounds;
+                pwallet->LoadPrivateSendRounds(mapRounds, nTxCount);
+            }
+        }
         else if (strType == "destdata")
         {
             std::string strAddress, strKey, strValue;
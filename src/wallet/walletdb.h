@@ -11,6 +11,7 @@
 #include "key.h"
 
 #include <list>
+#include <map>
 #include <stdint.h>
 #include <string>
 #include <utility>
@@ -23,6 +24,7 @@ class CAccountingEntry;
 struct CBlockLocator;
 class CKeyPool;
 class CMasterKey;
+class COutPoint;
 class CScript;
 class CWallet;
 class CWalletTx;
@@ -104,6 +106,8 @@ public:
 
     bool WriteOrderPosNext(int64_t nOrderPosNext);
 
+    bool WritePrivateSendRounds(const std::map<COutPoint, int>& mapRounds, uint64_t nTxCount);
+
     bool WriteDefaultKey(const CPubKey& vchPubKey);
 
     bool ReadPool(int64_t nPool, CKeyPool& keypool);
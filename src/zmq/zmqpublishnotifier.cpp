@@ -4,8 +4,10 @@
 
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
+#include "instantx.h"
 #include "main.h"
 #include "util.h"
+#include "crypto/common.h"
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -15,6 +17,7 @@ static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_TXLOCKLATENCY = "txlocklatency";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -180,14 +183,14 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     {
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        boost::shared_ptr<const CBlock> pblock;
+        if(!ReadBlockFromDisk(pblock, pindex, consensusParams))
         {
             zmqError("Can't read block from disk");
             return false;
         }
 
-        ss << block;
+        ss << *pblock;
     }
 
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
@@ -210,3 +213,19 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishTransactionLockLatencyNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    std::vector<int64_t> vLatencies;
+    if (!instantsend.GetTxLockLatencies(hash, vLatencies))
+        return true;
+    LogPrint("zmq", "zmq: Publish txlocklatency %s\n", hash.GetHex());
+    // tx hash followed by the microseconds to each InstantSendLatencyStage, -1 if not reached
+    unsigned char data[32 + 8 * INSTANTSEND_STAGE_COUNT];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    for (unsigned int i = 0; i < vLatencies.size() && i < INSTANTSEND_STAGE_COUNT; i++)
+        WriteLE64(data + 32 + 8 * i, (uint64_t)vLatencies[i]);
+    return SendMessage(MSG_TXLOCKLATENCY, data, sizeof(data));
+}